@@ -0,0 +1,430 @@
+(*
+ * Copyright (C) BlueRock Security Inc. 2024
+ *
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ *)
+
+(* See [rocq-bluerock-cpp2v/include/Binary.hpp] for the encoding. *)
+
+let magic = "CPP2VBIN"
+let version = 2
+
+exception Malformed
+
+type input = {data : string; mutable pos : int}
+
+let byte : input -> int = fun i ->
+  if i.pos >= String.length i.data then raise Malformed;
+  let b = Char.code i.data.[i.pos] in
+  i.pos <- i.pos + 1; b
+
+let varint : input -> int = fun i ->
+  let rec loop shift acc =
+    let b = byte i in
+    let acc = acc lor ((b land 0x7f) lsl shift) in
+    if b land 0x80 = 0 then acc else loop (shift + 7) acc
+  in
+  loop 0 0
+
+let bytes : input -> int -> string = fun i n ->
+  if n < 0 || i.pos + n > String.length i.data then raise Malformed;
+  let s = String.sub i.data i.pos n in
+  i.pos <- i.pos + n; s
+
+(** [table i f] reads a count [n], and then [n] elements with [f]. Function
+    [f] receives the index of the element. *)
+let table : input -> (int -> 'a) -> 'a array = fun i f ->
+  let n = varint i in
+  let elems = Array.make n None in
+  for k = 0 to n - 1 do elems.(k) <- Some(f k) done;
+  Array.map Option.get elems
+
+(** [get n k] checks that index [n] refers to one of [k] elements. *)
+let get : int -> int -> int = fun n k ->
+  if n < 0 || n >= k then raise Malformed; n
+
+type node =
+  | Ref of string
+  | Explicit of string
+  | App of int * int array
+  | Str of string
+  | Num of string
+  | Scope of string * int
+  | Tuple of int array
+  | Cons of int * int
+
+let node : input -> string array -> int -> node = fun i strings k ->
+  let string () = strings.(get (varint i) (Array.length strings)) in
+  let child () = get (varint i) k in
+  let children n = Array.init n (fun _ -> child ()) in
+  match byte i with
+  | 0 -> Ref(string ())
+  | 1 -> let head = child () in App(head, children (varint i))
+  | 2 -> Str(string ())
+  | 3 -> Num(string ())
+  | 4 -> let scope = string () in Scope(scope, child ())
+  | 5 -> Explicit(string ())
+  | 6 -> Tuple(children (varint i))
+  | 7 -> let head = child () in Cons(head, child ())
+  | _ -> raise Malformed
+
+(** [decode ~file data] decodes [data] (read from [file]) into its nodes and
+    the index of its root. Nodes only refer to earlier nodes. *)
+let decode : file:string -> string -> node array * int = fun ~file data ->
+  let i = {data; pos = 0} in
+  try
+    if bytes i (String.length magic) <> magic then raise Malformed;
+    if varint i <> version then
+      CErrors.user_err Pp.(str "Unsupported version of " ++ qstring file ++
+        str " (rerun cpp2v).");
+    let strings = table i (fun _ -> bytes i (varint i)) in
+    let nodes = table i (node i strings) in
+    let root = get (varint i) (Array.length nodes) in
+    if i.pos <> String.length data then raise Malformed;
+    (nodes, root)
+  with Malformed | Invalid_argument(_) ->
+    CErrors.user_err Pp.(qstring file ++ str " is not a cpp2v binary file.")
+
+(* Building the term, guided by the types of the heads of applications. *)
+
+type state = {
+  env : Environ.env;
+  mutable sigma : Evd.evar_map;
+  nodes : node array;
+  (* The references of identifiers *)
+  globals : (string, Globnames.extended_global_reference) Hashtbl.t;
+  (* The evars created so far *)
+  mutable evars : Evar.t list;
+  (* The terms of nodes built at closed expected types, with no evars left
+     to solve *)
+  memo : (int, EConstr.types * EConstr.t) Hashtbl.t;
+  (* [BS.t], if bytestrings are loaded *)
+  bs : Names.inductive option Lazy.t;
+}
+
+let fail : string -> 'a = fun msg -> CErrors.user_err Pp.(str msg)
+
+let global : state -> Names.GlobRef.t -> EConstr.t = fun st gr ->
+  let (sigma, c) = Evd.fresh_global st.env st.sigma gr in
+  st.sigma <- sigma; c
+
+let lib : state -> string -> EConstr.t = fun st name ->
+  global st (Coqlib.lib_ref name)
+
+let new_evar : state -> EConstr.types -> EConstr.t = fun st ty ->
+  let (sigma, ev) = Evarutil.new_evar st.env st.sigma ty in
+  st.sigma <- sigma;
+  st.evars <- fst (EConstr.destEvar sigma ev) :: st.evars;
+  ev
+
+let new_type : state -> EConstr.types = fun st ->
+  let (sigma, ty) = Evarutil.new_Type st.env st.sigma in
+  st.sigma <- sigma;
+  st.evars <- fst (EConstr.destEvar sigma ty) :: st.evars;
+  ty
+
+let unify : state -> EConstr.types -> EConstr.types -> unit = fun st ty ety ->
+  if not (EConstr.eq_constr_nounivs st.sigma ty ety) then
+    st.sigma <- Evarconv.unify_leq_delay st.env st.sigma ty ety
+
+(** [inductive st ty] is the inductive type [ty] reduces to, with its
+    arguments. *)
+let inductive : state -> EConstr.types option ->
+    (Names.inductive * EConstr.t array) option = fun st ty ->
+  match ty with
+  | None -> None
+  | Some(ty) ->
+  let ty = Reductionops.whd_all st.env st.sigma ty in
+  let (head, args) = EConstr.decompose_app st.sigma ty in
+  match EConstr.kind st.sigma head with
+  | Constr.Ind((ind, _)) -> Some(ind, args)
+  | _ -> None
+
+let is_ind : string -> Names.inductive -> bool = fun name ind ->
+  match Coqlib.lib_ref name with
+  | Names.GlobRef.IndRef(ind') -> Names.Ind.CanOrd.equal ind ind'
+  | _ -> false
+
+(** [typed st ety name] are the arguments of inductive [name] when [ety]
+    is (or can be) an application of it to [arity] arguments. *)
+let typed : state -> EConstr.types option -> string -> int ->
+    EConstr.t array = fun st ety name arity ->
+  match inductive st ety with
+  | Some(ind, args) when is_ind name ind && Array.length args = arity -> args
+  | _ ->
+      let args = Array.init arity (fun _ -> new_type st) in
+      Option.iter (unify st (EConstr.mkApp(lib st name, args))) ety;
+      args
+
+let product : state -> EConstr.types -> EConstr.types * EConstr.types =
+    fun st ty ->
+  match EConstr.kind st.sigma (Reductionops.whd_all st.env st.sigma ty) with
+  | Constr.Prod(_, dom, codom) -> (dom, codom)
+  | _ -> fail "Too many arguments in cpp2v binary file."
+
+(** [halve ds] is the quotient and the remainder of the decimal [ds] by 2. *)
+let halve : string -> string * bool = fun ds ->
+  let q = Buffer.create (String.length ds) in
+  let r = ref 0 in
+  let digit c =
+    let d = 10 * !r + Char.code c - Char.code '0' in
+    if Buffer.length q > 0 || d >= 2 then
+      Buffer.add_char q (Char.chr (Char.code '0' + d / 2));
+    r := d mod 2
+  in
+  String.iter digit ds; (Buffer.contents q, !r = 1)
+
+let rec positive : state -> string -> EConstr.t = fun st ds ->
+  match halve ds with
+  | ("", _) -> lib st "num.pos.xH"
+  | (q, odd) ->
+      let bit = lib st (if odd then "num.pos.xI" else "num.pos.xO") in
+      EConstr.mkApp(bit, [|positive st q|])
+
+let number : state -> [`Z | `N] -> string -> EConstr.t = fun st kind ds ->
+  let (neg, ds) =
+    if String.starts_with ~prefix:"-" ds then
+      (true, String.sub ds 1 (String.length ds - 1))
+    else (false, ds)
+  in
+  let zero = String.for_all (fun c -> c = '0') ds in
+  match (kind, zero, neg) with
+  | (`Z, true , _    ) -> lib st "num.Z.Z0"
+  | (`Z, false, false) -> EConstr.mkApp(lib st "num.Z.Zpos", [|positive st ds|])
+  | (`Z, false, true ) -> EConstr.mkApp(lib st "num.Z.Zneg", [|positive st ds|])
+  | (`N, true , false) -> lib st "num.N.N0"
+  | (`N, false, false) -> EConstr.mkApp(lib st "num.N.Npos", [|positive st ds|])
+  | (`N, _    , true ) -> fail "Negative number of type N."
+
+let pstring : string -> EConstr.t = fun s ->
+  match Pstring.of_string s with
+  | Some(s) -> EConstr.mkString s
+  | None    -> fail "String literal too long."
+
+let bs : unit -> Names.inductive option = fun () ->
+  let path = "bedrock.prelude.bytestring_core.BS.t" in
+  let qualid = Libnames.qualid_of_string path in
+  match Nametab.locate qualid with
+  | Names.GlobRef.IndRef(ind) -> Some(ind)
+  | _ | exception Not_found -> None
+
+(** [bytestring st ind s] builds [s] with the constructors of [BS.t]. *)
+let bytestring : state -> Names.inductive -> string -> EConstr.t =
+    fun st ind s ->
+  let empty = EConstr.mkConstructU ((ind, 1), EConstr.EInstance.empty) in
+  let cons = EConstr.mkConstructU ((ind, 2), EConstr.EInstance.empty) in
+  let byte =
+    let ty = Retyping.get_type_of st.env st.sigma cons in
+    match inductive st (Some(fst (product st ty))) with
+    | Some(byte, _) -> byte
+    | None -> fail "Unexpected definition of BS.t."
+  in
+  let char c =
+    EConstr.mkConstructU ((byte, Char.code c + 1), EConstr.EInstance.empty)
+  in
+  let rec build i =
+    if i = String.length s then empty
+    else EConstr.mkApp(cons, [|char s.[i]; build (i + 1)|])
+  in
+  build 0
+
+let literal : state -> EConstr.types option -> string option -> node ->
+    EConstr.t = fun st ety scope n ->
+  let ind = Option.map fst (inductive st ety) in
+  let is name = Option.fold ~none:false ~some:(is_ind name) ind in
+  let is_bs =
+    match (ind, Lazy.force st.bs) with
+    | (Some(ind), Some(bs)) -> Names.Ind.CanOrd.equal ind bs
+    | _ -> ind = None && scope = Some("bs")
+  in
+  let t =
+    match n with
+    | Num(ds) when is "num.Z.type" -> number st `Z ds
+    | Num(ds) when is "num.N.type" -> number st `N ds
+    | Num(ds) when ind = None && scope = Some("Z") -> number st `Z ds
+    | Num(ds) when ind = None && scope = Some("N") -> number st `N ds
+    | Num(ds) -> fail ("Number " ^ ds ^ " of unexpected type.")
+    | Str(s) when is_bs ->
+        begin
+          match Lazy.force st.bs with
+          | Some(bs) -> bytestring st bs s
+          | None -> fail "Bytestring literals need bedrock.prelude.bytestring."
+        end
+    | Str(s) -> pstring s
+    | _ -> assert false
+  in
+  Option.iter (unify st (Retyping.get_type_of st.env st.sigma t)) ety; t
+
+let rec elab : state -> EConstr.types option -> int -> EConstr.t =
+    fun st ety k ->
+  let closed =
+    match ety with
+    | Some(ety) -> not (Evarutil.has_undefined_evars st.sigma ety)
+    | None -> false
+  in
+  let found =
+    if not closed then None else
+    let ety = Option.get ety in
+    let same (ty, _) = EConstr.eq_constr_nounivs st.sigma ty ety in
+    List.find_opt same (Hashtbl.find_all st.memo k)
+  in
+  match found with
+  | Some(_, t) -> t
+  | None ->
+  let evars = st.evars in
+  let t =
+    match st.nodes.(k) with
+    | Ref(id) -> app st ety ~explicit:false id [||]
+    | Explicit(id) -> app st ety ~explicit:true id [||]
+    | App(head, args) ->
+        begin
+          match st.nodes.(head) with
+          | Ref(id) -> app st ety ~explicit:false id args
+          | Explicit(id) -> app st ety ~explicit:true id args
+          | _ -> fail "Unexpected application in cpp2v binary file."
+        end
+    | Str(_) | Num(_) as n -> literal st ety None n
+    | Scope(scope, n) ->
+        begin
+          match st.nodes.(n) with
+          | Str(_) | Num(_) as n -> literal st ety (Some(scope)) n
+          | _ -> elab st ety n
+        end
+    | Tuple(elems) -> tuple st ety elems
+    | Cons(_) -> list st ety k
+  in
+  (* The evars created for [t] are solved *)
+  let rec solved evs =
+    evs == evars ||
+    match evs with
+    | ev :: evs -> Evd.is_defined st.sigma ev && solved evs
+    | [] -> true
+  in
+  if closed && solved st.evars then
+    Hashtbl.add st.memo k (Option.get ety, t);
+  t
+
+(** [app st ety ~explicit id args] applies [id] to [args], inserting evars
+    for its implicit arguments unless [explicit]. Arguments whose types are
+    not known before the type of the application is unified with [ety] are
+    built afterwards. *)
+and app : state -> EConstr.types option -> explicit:bool -> string ->
+    int array -> EConstr.t = fun st ety ~explicit id args ->
+  let (f, imps) =
+    let r =
+      match Hashtbl.find_opt st.globals id with
+      | Some(r) -> r
+      | None ->
+          let qualid = Libnames.qualid_of_string id in
+          let r =
+            try Nametab.locate_extended qualid
+            with Not_found -> fail ("Unknown reference " ^ id ^ ".")
+          in
+          Hashtbl.add st.globals id r; r
+    in
+    match r with
+    | Globnames.TrueGlobal(gr) ->
+        let imps =
+          if explicit then [] else
+          Impargs.select_impargs_size (Array.length args)
+            (Impargs.implicits_of_global gr)
+        in
+        (global st gr, imps)
+    | Globnames.Abbrev(_) ->
+        let qualid = Libnames.qualid_of_string id in
+        let c = CAst.make (Constrexpr.CRef(qualid, None)) in
+        let (sigma, f) = Constrintern.interp_open_constr st.env st.sigma c in
+        st.sigma <- sigma; (f, [])
+  in
+  let later = ref [] in
+  let rec apply f fty imps i =
+    match imps with
+    | imp :: imps when Impargs.is_status_implicit imp &&
+        (i < Array.length args || Impargs.maximal_insertion_of imp) ->
+        let (dom, codom) = product st fty in
+        let ev = new_evar st dom in
+        apply (EConstr.mkApp(f, [|ev|])) (EConstr.Vars.subst1 ev codom) imps i
+    | _ when i < Array.length args ->
+        let (dom, codom) = product st fty in
+        let a =
+          if Evarutil.has_undefined_evars st.sigma dom then begin
+            let ev = new_evar st dom in
+            later := (ev, dom, args.(i)) :: !later; ev
+          end else elab st (Some(dom)) args.(i)
+        in
+        let imps = match imps with _ :: imps -> imps | [] -> [] in
+        let codom = EConstr.Vars.subst1 a codom in
+        apply (EConstr.mkApp(f, [|a|])) codom imps (i + 1)
+    | _ -> (f, fty)
+  in
+  let (t, ty) = apply f (Retyping.get_type_of st.env st.sigma f) imps 0 in
+  Option.iter (unify st ty) ety;
+  let build (ev, dom, arg) =
+    let a = elab st (Some(Evarutil.nf_evar st.sigma dom)) arg in
+    unify st ev a
+  in
+  List.iter build (List.rev !later);
+  t
+
+(** [(a, b, c)] is [pair (pair a b) c]. *)
+and tuple : state -> EConstr.types option -> int array -> EConstr.t =
+    fun st ety elems ->
+  let rec build ety k =
+    if k = 0 then elab st ety elems.(0) else
+    let types = typed st ety "core.prod.type" 2 in
+    let l = build (Some(types.(0))) (k - 1) in
+    let r = elab st (Some(types.(1))) elems.(k) in
+    EConstr.mkApp(lib st "core.prod.intro", Array.append types [|l; r|])
+  in
+  build ety (Array.length elems - 1)
+
+(** Lists of declarations are long, so we do not recur on their tails. *)
+and list : state -> EConstr.types option -> int -> EConstr.t =
+    fun st ety k ->
+  let rec chain heads k =
+    match st.nodes.(k) with
+    | Cons(head, tail) -> chain (head :: heads) tail
+    | _ -> (heads, k)
+  in
+  let (rev_heads, tail) = chain [] k in
+  let a = (typed st ety "core.list.type" 1).(0) in
+  let heads = List.rev_map (elab st (Some(a))) rev_heads in
+  let list = EConstr.mkApp(lib st "core.list.type", [|a|]) in
+  let cons = lib st "core.list.cons" in
+  let add l h = EConstr.mkApp(cons, [|a; h; l|]) in
+  List.fold_left add (elab st (Some(list)) tail) (List.rev heads)
+
+let define : file:string -> string -> Names.Id.t -> unit =
+    fun ~file data name ->
+  let (nodes, root) = decode ~file data in
+  let env = Global.env () in
+  let st =
+    let sigma = Evd.from_env env in
+    let globals = Hashtbl.create 1024 in
+    let memo = Hashtbl.create 1024 in
+    {env; sigma; nodes; globals; evars = []; memo; bs = lazy (bs ())}
+  in
+  let typ =
+    let tu = Libnames.qualid_of_string "translation_unit" in
+    match Nametab.locate tu with
+    | gr -> global st gr
+    | exception Not_found -> fail "translation_unit is not defined."
+  in
+  let body = elab st (Some(typ)) root in
+  let sigma = Evarconv.solve_unif_constraints_with_heuristics env st.sigma in
+  Pretyping.check_evars_are_solved ~program_mode:false env sigma;
+  let body = Evarutil.nf_evar sigma body in
+  let cinfo = Declare.CInfo.make ~name ~typ:(Some(typ)) () in
+  let info = Declare.Info.make ~kind:Decls.(IsDefinition(Definition)) () in
+  let _ : Names.GlobRef.t =
+    Declare.declare_definition ~info ~cinfo ~opaque:false ~body sigma
+  in
+  ()
+
+let load : file:string -> Names.Id.t -> unit = fun ~file name ->
+  let data =
+    try In_channel.with_open_bin file In_channel.input_all
+    with Sys_error(msg) -> CErrors.user_err Pp.(str msg)
+  in
+  define ~file data name
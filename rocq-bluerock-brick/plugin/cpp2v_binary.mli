@@ -0,0 +1,19 @@
+(*
+ * Copyright (C) BlueRock Security Inc. 2024
+ *
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ *)
+
+(** Translation units in the binary form written by [cpp2v -binary]. *)
+
+(** [load ~file id] defines [id : translation_unit] from [file]. The term
+    is built directly, the types of the heads of its applications giving
+    the implicit arguments to insert and the types of its literals, so
+    identifiers are resolved where [bedrock.lang.cpp.parser] is imported.
+    Shared nodes of [file] built at the same type are shared in the term. *)
+val load : file:string -> Names.Id.t -> unit
+
+(** [define ~file data id] is [load ~file id], for a [file] whose contents
+    [data] are already read. *)
+val define : file:string -> string -> Names.Id.t -> unit
@@ -0,0 +1,132 @@
+(*
+ * Copyright (C) BlueRock Security Inc. 2024
+ *
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ *)
+
+(** [translate_file file flags] is [(ok, binary, depfile, log)]: the
+    translation of [file] by the [tocoq] library linked into the plugin, as
+    [cpp2v -binary] and [cpp2v -MD] would write it, and its log. *)
+external translate_file :
+  string -> string list -> bool * string * string * string =
+  "cpp2v_translate_file"
+
+(** The version of the [tocoq] library, as [cpp2v -cpp2v-version] prints. *)
+external version : unit -> string = "cpp2v_version"
+
+let getenv : string -> string option = fun var ->
+  match Sys.getenv_opt var with
+  | Some("") | None -> None
+  | Some(v)         -> Some(v)
+
+let cache_dir : unit -> string = fun _ ->
+  match getenv "CPP2V_CACHE" with
+  | Some(dir) -> dir
+  | None      ->
+  let base =
+    match (getenv "XDG_CACHE_HOME", getenv "HOME") with
+    | (Some(dir), _   ) -> dir
+    | (None, Some(dir)) -> Filename.concat dir ".cache"
+    | (None, None     ) -> Filename.get_temp_dir_name ()
+  in
+  Filename.concat base "cpp2v"
+
+let mtime : string -> float option = fun file ->
+  try Some((Unix.stat file).Unix.st_mtime) with Unix.Unix_error(_) -> None
+
+let key : file:string -> flags:string list -> string = fun ~file ~flags ->
+  let source =
+    try Digest.to_hex (Digest.file file)
+    with Sys_error(msg) -> CErrors.user_err Pp.(str msg)
+  in
+  let path =
+    if Filename.is_relative file then Filename.concat (Sys.getcwd ()) file
+    else file
+  in
+  let parts = version () :: source :: path :: flags in
+  Digest.to_hex (Digest.string (String.concat "\000" parts))
+
+(** [deps data] lists the prerequisites of the Make-style rule [data], as
+    written by [cpp2v -MD]. *)
+let deps : string -> string list = fun data ->
+  let deps = ref [] in
+  let dep = Buffer.create 64 in
+  let flush () =
+    if Buffer.length dep > 0 then deps := Buffer.contents dep :: !deps;
+    Buffer.clear dep
+  in
+  let n = String.length data in
+  let rec loop i =
+    if i < n then
+    match (data.[i], if i + 1 < n then Some(data.[i + 1]) else None) with
+    | ('\\', Some('\n')) -> flush (); loop (i + 2)
+    | ('\\', Some(c)   ) -> Buffer.add_char dep c; loop (i + 2)
+    | ('$' , Some('$') ) -> Buffer.add_char dep '$'; loop (i + 2)
+    | ((' ' | '\t' | '\n'), _) -> flush (); loop (i + 1)
+    | (c, _)             -> Buffer.add_char dep c; loop (i + 1)
+  in
+  (* Skip the targets *)
+  loop (String.index data ':' + 1);
+  flush ();
+  !deps
+
+let up_to_date : bin:string -> depfile:string -> bool = fun ~bin ~depfile ->
+  match mtime bin with
+  | None        -> false
+  | Some(built) ->
+  let fresh dep =
+    match mtime dep with
+    | Some(t) -> t <= built
+    | None    -> false
+  in
+  try
+    let data = In_channel.with_open_bin depfile In_channel.input_all in
+    List.for_all fresh (deps data)
+  with Sys_error(_) | Not_found -> false
+
+let rec mkdir_p : string -> unit = fun dir ->
+  if not (Sys.file_exists dir) then begin
+    mkdir_p (Filename.dirname dir);
+    try Sys.mkdir dir 0o755 with Sys_error(_) when Sys.file_exists dir -> ()
+  end
+
+(** [save ~file data] writes [data] to a temporary file first, so that
+    concurrent imports of the same file see complete files. *)
+let save : file:string -> string -> unit = fun ~file data ->
+  let tmp =
+    Filename.temp_file ~temp_dir:(Filename.dirname file) "import"
+      (Filename.extension file)
+  in
+  Out_channel.with_open_bin tmp (fun oc -> Out_channel.output_string oc data);
+  Sys.rename tmp file
+
+(** [run ~file ~flags ~bin ~depfile] translates [file], saves the binary
+    form of the translation to [bin] and its dependencies to [depfile], and
+    returns the binary form. *)
+let run : file:string -> flags:string list -> bin:string -> depfile:string
+    -> string = fun ~file ~flags ~bin ~depfile ->
+  let (ok, binary, dependencies, log) = translate_file file flags in
+  if not ok then
+    CErrors.user_err Pp.(str "cpp2v failed on " ++ qstring file ++ str "." ++
+      (if log = "" then mt () else fnl () ++ str log));
+  if log <> "" then Feedback.msg_warning Pp.(str log);
+  begin
+    try
+      save ~file:depfile dependencies;
+      save ~file:bin binary
+    with Sys_error(msg) -> Feedback.msg_warning Pp.(str msg)
+  end;
+  binary
+
+let import : file:string -> flags:string list -> Names.Id.t -> unit =
+    fun ~file ~flags name ->
+  let dir = cache_dir () in
+  let key = key ~file ~flags in
+  let bin = Filename.concat dir (key ^ ".bin") in
+  let depfile = Filename.concat dir (key ^ ".d") in
+  if up_to_date ~bin ~depfile then Cpp2v_binary.load ~file:bin name else begin
+    (try mkdir_p dir with Sys_error(msg) -> CErrors.user_err Pp.(str msg));
+    let binary = run ~file ~flags ~bin ~depfile in
+    Cpp2v_binary.define ~file binary name
+  end
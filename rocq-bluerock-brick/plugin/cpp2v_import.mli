@@ -0,0 +1,18 @@
+(*
+ * Copyright (C) BlueRock Security Inc. 2024
+ *
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ *)
+
+(** Translating C++ files from Coq. *)
+
+(** [import ~file ~flags id] defines [id : translation_unit] as the
+    translation of C++ file [file], compiled with Clang flags [flags].
+
+    The translation is produced in-process, by the [tocoq] library of
+    [cpp2v] linked into the plugin, as [cpp2v -binary] would. It is saved in
+    the directory named by [CPP2V_CACHE] (by default, [cpp2v] in the user's
+    cache directory), and reused as long as [file], [flags], the version of
+    [tocoq] and the files included by [file] do not change. *)
+val import : file:string -> flags:string list -> Names.Id.t -> unit
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) BlueRock Security Inc. 2024
+ *
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+
+// The `tocoq` library of cpp2v, for `Cpp2v_import`.
+
+#include "Translate.hpp"
+#include "Version.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <caml/alloc.h>
+#include <caml/memory.h>
+#include <caml/mlvalues.h>
+}
+
+namespace {
+value
+ocaml_string(const std::string& s) {
+	return caml_alloc_initialized_string(s.size(), s.data());
+}
+}
+
+/*
+`translate_file file flags` is `(ok, binary, dependencies, log)`: the
+translation unit of `file` in binary form, as `cpp2v -binary` writes it,
+and the dependencies and log of the translation.
+*/
+extern "C" value
+cpp2v_translate_file(value file, value flags) {
+	CAMLparam2(file, flags);
+	CAMLlocal2(result, field);
+	std::string path{String_val(file), caml_string_length(file)};
+	std::vector<std::string> args;
+	for (auto l = flags; l != Val_emptylist; l = Field(l, 1))
+		args.emplace_back(String_val(Field(l, 0)),
+						  caml_string_length(Field(l, 0)));
+
+	cpp2v::Options options;
+	options.module = false;
+	options.binary = true;
+	options.dependencies = true;
+	auto translated = cpp2v::translate_file(path, args, options);
+
+	result = caml_alloc_tuple(4);
+	Store_field(result, 0, Val_bool(translated.ok));
+	field = ocaml_string(translated.binary);
+	Store_field(result, 1, field);
+	field = ocaml_string(translated.dependencies);
+	Store_field(result, 2, field);
+	field = ocaml_string(translated.log);
+	Store_field(result, 3, field);
+	CAMLreturn(result);
+}
+
+extern "C" value
+cpp2v_version(value unit) {
+	CAMLparam1(unit);
+	CAMLreturn(caml_copy_string(cpp2v::VERSION));
+}
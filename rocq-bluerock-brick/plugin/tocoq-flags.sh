@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+#
+# Copyright (C) BlueRock Security Inc. 2024
+#
+# This software is distributed under the terms of the BedRock Open-Source
+# License. See the LICENSE-BedRock file in the repository root for details.
+#
+# Usage: tocoq-flags.sh CPP2V_DIR CXX_FLAGS C_LIBRARY_FLAGS
+#
+# Writes the flags to compile the stubs against the `tocoq` library of
+# cpp2v (built in CPP2V_DIR/build-dune), and to link them with it, as dune
+# s-expressions.
+
+set -euo pipefail
+
+cpp2v="$(cd "$1" && pwd)"
+
+sexp() {
+    printf '('
+    for arg in "$@"; do
+        printf ' "%s"' "${arg//\"/\\\"}"
+    done
+    printf ' )\n'
+}
+
+# shellcheck disable=SC2046
+sexp "-I${cpp2v}/include" $(llvm-config --cxxflags) > "$2"
+# shellcheck disable=SC2046
+sexp "${cpp2v}/build-dune/libtocoq.a" \
+    "-Wl,-rpath,$(llvm-config --libdir)" -lclang-cpp \
+    $(llvm-config --link-shared --ldflags --libs --system-libs) \
+    -lstdc++ > "$3"
@@ -1,6 +1,36 @@
 open Extra
 open Panic
 
+(** [read_depfile file] returns the prerequisites listed in the Make-style
+    dependency file [file] (as written by [cpp2v -MD]), ignoring its targets.
+    Escaped spaces and ['#'], as well as ["$$"], are unescaped. *)
+let read_depfile : string -> string list = fun file ->
+  let contents = Buffer.contents (Buffer.from_file file) in
+  let len = String.length contents in
+  let word = Buffer.create 80 in
+  let words = ref [] in
+  let add c = Buffer.add_char word c in
+  let flush () =
+    if Buffer.length word > 0 then begin
+      words := Buffer.contents word :: !words;
+      Buffer.clear word
+    end
+  in
+  let targets () = Buffer.clear word; words := [] in
+  let rec scan i =
+    if i < len then
+      let next = if i + 1 < len then Some(contents.[i + 1]) else None in
+      match (contents.[i], next) with
+      | ('\\'             , Some('\n')          ) -> flush (); scan (i + 2)
+      | ('\\'             , Some(' ' | '#' as c)) -> add c; scan (i + 2)
+      | ('$'              , Some('$')           ) -> add '$'; scan (i + 2)
+      | (':'              , _                   ) -> targets (); scan (i + 1)
+      | (' ' | '\t' | '\n', _                   ) -> flush (); scan (i + 1)
+      | (c                , _                   ) -> add c; scan (i + 1)
+  in
+  scan 0; flush ();
+  List.rev !words
+
 let command : bool -> unit = fun debug ->
   let path_to_initial_cwd = Project.move_to_root () in
   if debug then begin
@@ -54,18 +84,38 @@ let command : bool -> unit = fun debug ->
     out " (theories";
     List.iter (out "\n  %s") theories;
     out "))\n";
+    (* [cpp2v -MD] lists the files that went into [code.v] in [code.d], which
+       is promoted next to this [dune] file. We always depend on all headers
+       of the include directories, so that headers included after the last
+       [br gen] are tracked, and add the files of [code.d] that these globs
+       miss (e.g., headers next to the source file). *)
+    let input = Printf.sprintf "../../%s.%s" base ext in
+    let depfile = Filename.concat gen_dir "code.d" in
     out "(rule\n";
-    out " (targets code.v names.v)\n";
+    out " (targets code.v names.v code.d)\n";
+    out " (mode (promote (only code.d)))\n";
     out " (deps\n";
-    out "  (:input ../../%s.%s)" base ext;
-    let dep_include dir =
-      if Filename.is_relative dir then
-        out "\n  (glob_files_rec ../../%s/*.hpp)" dir
+    out "  (:input %s)" input;
+    let include_dirs =
+      List.filter Filename.is_relative clang_includes
+      |> List.map (Printf.sprintf "../../%s")
+    in
+    let dep_include dir = out "\n  (glob_files_rec %s/*.hpp)" dir in
+    List.iter dep_include include_dirs;
+    let globbed file =
+      let in_dir dir = String.starts_with ~prefix:(dir ^ "/") file in
+      Filename.check_suffix file ".hpp" && List.exists in_dir include_dirs
+    in
+    let dep file =
+      if Filename.is_relative file && file <> input && not (globbed file)
+         && Sys.file_exists (Filename.concat gen_dir file) then
+        if String.contains file ' ' then out "\n  %S" file
+        else out "\n  %s" file
     in
-    List.iter dep_include clang_includes;
+    if Sys.file_exists depfile then List.iter dep (read_depfile depfile);
     out ")\n";
     out " (action\n";
-    out "  (run cpp2v -v %%{input} -o code.v -names names.v --";
+    out "  (run cpp2v -v %%{input} -o code.v -names names.v -MD --";
     let out_include dir =
       if Filename.is_relative dir then
         out "\n   -I../../%s" dir
@@ -113,12 +113,53 @@
     bedrock.lang
     Equations))
   (rule
-   (targets code.v names.v)
+   (targets code.v names.v code.d)
+   (mode (promote (only code.d)))
    (deps
     (:input ../../client.cpp)
     (glob_files_rec ../../../../include/*.hpp)
     (glob_files_rec ../../include/*.hpp))
    (action
-    (run cpp2v -v %{input} -o code.v -names names.v --
+    (run cpp2v -v %{input} -o code.v -names names.v -MD --
+     -I../../../../include
+     -I../../include)))
+
+The dependencies of a translation are the headers of its include directories
+and the other files of its depfile (written by `cpp2v -MD`), as of the last
+build.
+  $ cat > src/server/proof/server_cpp/code.d <<'EOF'
+  > code.v names.v: ../../server.cpp ../../../../include/util.hpp \
+  >   ../../include/server.hpp ../../attic/todo\ list.h \
+  >   ../../attic/gone.h /usr/include/stdlib.h
+  > EOF
+  $ touch "src/server/attic/todo list.h"
+  $ br gen
+  $ cat src/server/proof/server_cpp/dune
+  (include_subdirs qualified)
+  (coq.theory
+   (name my.project.src.server.server_cpp)
+   (package dummy)
+   (flags (:standard -w -notation-incompatible-prefix))
+   (theories
+    stdpp
+    iris
+    elpi
+    elpi_elpi
+    Lens
+    Ltac2
+    bedrock.upoly
+    bedrock.prelude
+    bedrock.lang
+    Equations))
+  (rule
+   (targets code.v names.v code.d)
+   (mode (promote (only code.d)))
+   (deps
+    (:input ../../server.cpp)
+    (glob_files_rec ../../../../include/*.hpp)
+    (glob_files_rec ../../include/*.hpp)
+    "../../attic/todo list.h")
+   (action
+    (run cpp2v -v %{input} -o code.v -names names.v -MD --
      -I../../../../include
      -I../../include)))
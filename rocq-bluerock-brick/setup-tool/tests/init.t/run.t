@@ -92,14 +92,15 @@
     bedrock.prelude
     bedrock.lang))
   (rule
-   (targets code.v names.v)
+   (targets code.v names.v code.d)
+   (mode (promote (only code.d)))
    (deps
     (:input ../../client.cpp)
     (glob_files_rec ../../../../include/*.hpp)
     (glob_files_rec ../../../../src/client/include/*.hpp)
     (glob_files_rec ../../../../src/server/include/*.hpp))
    (action
-    (run cpp2v -v %{input} -o code.v -names names.v --
+    (run cpp2v -v %{input} -o code.v -names names.v -MD --
      -I../../../../include
      -I../../../../src/client/include
      -I../../../../src/server/include
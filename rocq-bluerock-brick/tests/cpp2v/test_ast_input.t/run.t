@@ -0,0 +1,12 @@
+  $ . ../../setup-cpp2v.sh
+
+An AST file from `clang -emit-ast` translates as its source does, including
+the members and instantiations `cpp2v` elaborates.
+
+  $ $(llvm-config --bindir)/clang++ -std=c++17 -emit-ast -o test.ast test.cpp
+  $ cpp2v -names test_cpp_names.v -o test_cpp.v test.cpp -- -std=c++17
+  $ mkdir ast
+  $ cpp2v -names ast/test_cpp_names.v -o ast/test_cpp.v test.ast --
+  $ cmp test_cpp.v ast/test_cpp.v
+  $ cmp test_cpp_names.v ast/test_cpp_names.v
+  $ coqc ${COQC_ARGS} test_cpp.v
@@ -0,0 +1,17 @@
+struct Point {
+	int x, y;
+};
+
+template<typename T>
+T
+twice(T t) {
+	return t + t;
+}
+
+int
+use() {
+	Point p{1, 2};
+	Point q = p;
+	q = p;
+	return twice(q.x) + twice<long>(p.y);
+}
@@ -0,0 +1,38 @@
+  $ . ../../setup-cpp2v.sh
+  $ cpp2v -q -batch-dir out -batch-jobs 2 -batch-history history.json \
+  >   a.cpp b.cpp -- -std=c++17
+  $ ls out
+  a_cpp.v
+  b_cpp.v
+  $ coqc ${COQC_ARGS} out/a_cpp.v
+  $ grep -c '"micros"' history.json
+  2
+
+Files the history does not know about start first, and then the ones that
+took longest.
+
+  $ cat > history.json <<EOF
+  > { "a.cpp": { "micros": 1, "bytes": 1 },
+  >   "b.cpp": { "micros": 1000000, "bytes": 1 } }
+  > EOF
+  $ cpp2v -batch-dir out -batch-jobs 1 -batch-history history.json \
+  >   a.cpp b.cpp c.cpp -- -std=c++17 2>&1 |
+  >   sed -n 's/ ([0-9.]*s)//gp' | grep "critical path"
+  cpp2v: critical path: c.cpp b.cpp a.cpp
+  $ grep -c '"micros"' history.json
+  3
+
+Files that would be printed to the same file are rejected.
+
+  $ cpp2v -batch-dir out a.cpp sub/a.cpp -- -std=c++17
+  cpp2v: a.cpp and sub/a.cpp would both be printed to out/a_cpp.v
+  [1]
+
+A file that fails does not stop the others, but fails the batch.
+
+  $ echo 'int broken(' > broken.cpp
+  $ rm -r out
+  $ cpp2v -q -batch-dir out a.cpp broken.cpp -- -std=c++17 2> /dev/null
+  [1]
+  $ ls out
+  a_cpp.v
@@ -0,0 +1 @@
+int a2() { return 4; }
@@ -0,0 +1,17 @@
+  $ . ../../setup-cpp2v.sh
+  $ cpp2v -o test_cpp.v -binary test_cpp.bin test.cpp -- -std=c++17
+
+The binary file does not depend on whether the module file is printed as well.
+
+  $ cpp2v -binary alone.bin test.cpp -- -std=c++17
+  $ cmp test_cpp.bin alone.bin
+
+  $ cat > test_binary.v <<EOF
+  > Require Import bedrock.lang.cpp.binary.
+  > Require Test.test_cpp.
+  > Cpp2v Load "test_cpp.bin" as module.
+  > Goal module = Test.test_cpp.module.
+  > Proof. reflexivity. Qed.
+  > EOF
+  $ coqc ${COQC_ARGS} -Q . Test test_cpp.v
+  $ coqc ${COQC_ARGS} -Q . Test test_binary.v
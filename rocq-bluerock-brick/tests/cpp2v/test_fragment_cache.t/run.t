@@ -0,0 +1,22 @@
+  $ . ../../setup-cpp2v.sh
+  $ translate() { cpp2v -no-sharing "$@" -o test_cpp.v test.cpp -- -std=c++17; }
+
+Reused declarations print the values of the constants they fold, even when
+only the constants change.
+
+  $ echo 'constexpr int K = 1;' > consts.hpp
+  $ translate -fragment-cache cache && mv test_cpp.v first.v
+  $ echo 'constexpr int K = 2;' > consts.hpp
+  $ translate -fragment-cache cache && mv test_cpp.v cached.v
+  $ translate && mv test_cpp.v fresh.v
+  $ cmp cached.v fresh.v
+  $ cmp -s first.v fresh.v
+  [1]
+
+The same goes for the lines `__builtin_LINE` folds, when the lines above a
+declaration change.
+
+  $ { echo; cat test.cpp; } > moved.cpp && mv moved.cpp test.cpp
+  $ translate -fragment-cache cache && mv test_cpp.v cached.v
+  $ translate && mv test_cpp.v fresh.v
+  $ cmp cached.v fresh.v
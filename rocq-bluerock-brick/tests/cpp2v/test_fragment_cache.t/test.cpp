@@ -0,0 +1,16 @@
+#include "consts.hpp"
+
+int
+pick(int x) {
+	switch (x) {
+	case K:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+unsigned
+line() {
+	return __builtin_LINE();
+}
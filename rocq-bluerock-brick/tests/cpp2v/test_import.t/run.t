@@ -0,0 +1,23 @@
+  $ . ../../setup-cpp2v.sh
+  $ export CPP2V_CACHE=$PWD/cache
+  $ cpp2v -o test_cpp.v test.cpp -- -std=c++17
+  $ cat > test_import.v <<EOF
+  > Require Import bedrock.lang.cpp.binary.
+  > Require Test.test_cpp.
+  > #[local] Open Scope pstring_scope.
+  > Cpp2v Import "test.cpp" with "-std=c++17" as module.
+  > Goal module = Test.test_cpp.module.
+  > Proof. reflexivity. Qed.
+  > EOF
+  $ coqc ${COQC_ARGS} -Q . Test test_cpp.v
+  $ coqc ${COQC_ARGS} -Q . Test test_import.v
+  $ ls cache | sed 's/^[0-9a-f]*\./KEY./'
+  KEY.bin
+  KEY.d
+
+The second import reuses the cached translation rather than replacing it.
+
+  $ touch -d 2100-01-01 cache/*.bin
+  $ coqc ${COQC_ARGS} -Q . Test test_import.v
+  $ date -r cache/*.bin +%Y
+  2100
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) BlueRock Security Inc. 2024
+ *
+ * SPDX-License-Identifier:MIT-0
+ */
+
+struct point {
+    int x;
+    int y;
+};
+
+int manhattan(const point& p) {
+    return (p.x < 0 ? -p.x : p.x) + (p.y < 0 ? -p.y : p.y);
+}
+
+const char* greeting() {
+    return "say \"hi\"";
+}
@@ -0,0 +1,23 @@
+  $ . ../../setup-cpp2v.sh
+  $ translate() {
+  >   cpp2v -import-dir mods "$@" -o test_cpp.v test.cpp -- -std=c++17 \
+  >     -fmodules -fmodules-cache-path=$PWD/mcache \
+  >     -fmodule-map-file=module.modulemap
+  > }
+  $ translate
+  $ ls mods
+  m_cppm.v
+
+Translating again leaves the module's file alone.
+
+  $ touch -d 2100-01-01 mods/m_cppm.v
+  $ translate
+  $ date -r mods/m_cppm.v +%Y
+  2100
+
+Options changing how the module prints replace it.
+
+  $ translate -mangled-keys
+  $ date -r mods/m_cppm.v +%Y | grep -c 2100
+  0
+  [1]
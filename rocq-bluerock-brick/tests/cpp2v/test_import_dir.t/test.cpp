@@ -0,0 +1,6 @@
+#include "m.hpp"
+
+int
+use() {
+	return twice(1);
+}
@@ -0,0 +1,18 @@
+  $ . ../../setup-cpp2v.sh
+  $ cpp2v -index test_cpp.json -o test_cpp.v test.cpp -- -std=c++17
+  $ coqc ${COQC_ARGS} test_cpp.v
+
+Extracting one declaration gives a module file of its own, with the
+sharing definitions it needs.
+
+  $ cpp2v -index test_cpp.json -extract ns::f -o f_cpp.v
+  $ grep -c "Definition module" f_cpp.v
+  1
+  $ coqc ${COQC_ARGS} f_cpp.v
+  $ test $(wc -c < f_cpp.v) -lt $(wc -c < test_cpp.v)
+
+Names the index does not have are errors.
+
+  $ cpp2v -index test_cpp.json -extract ns::h
+  test_cpp.json: no declaration named ns::h
+  [1]
@@ -0,0 +1,14 @@
+namespace ns {
+struct P {
+  int x;
+  int y;
+};
+
+int f(P p) {
+  return p.x + p.y;
+}
+
+long g(long a, long b) {
+  return a * b;
+}
+} // namespace ns
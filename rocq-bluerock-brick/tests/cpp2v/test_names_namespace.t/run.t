@@ -0,0 +1,41 @@
+  $ . ../../setup-cpp2v.sh
+
+The names file has one module per namespace, leaving out inline namespaces.
+
+  $ cpp2v -names all_names.v -names-main-file test.cpp -- -std=c++17
+  $ grep -o "Notation \"'[^']*'\"" all_names.v | LC_ALL=C sort
+  Notation "'::T'"
+  Notation "'::T::t'"
+  Notation "'::a::U'"
+  Notation "'::a::U::u'"
+  Notation "'::a::v1::b::I'"
+  Notation "'::a::v1::b::S'"
+  Notation "'::a::v1::b::S::x'"
+  Notation "'::a::v1::b::S::y'"
+  $ grep -E "^ *(Module|End|Export) " all_names.v
+  Module _'.
+    Module a.
+      Module b.
+      End b.
+      Export b.
+    End a.
+    Export a.
+  End _'.
+  Export _'.
+  $ coqc ${COQC_ARGS} all_names.v
+
+`-names-namespace` matches namespaces as users spell them, without inline
+namespaces.
+
+  $ cpp2v -names b_names.v -names-namespace a::b test.cpp -- -std=c++17
+  $ grep -o "Notation \"'[^']*'\"" b_names.v | LC_ALL=C sort
+  Notation "'::a::v1::b::I'"
+  Notation "'::a::v1::b::S'"
+  Notation "'::a::v1::b::S::x'"
+  Notation "'::a::v1::b::S::y'"
+  $ coqc ${COQC_ARGS} b_names.v
+  $ cat > client.v <<EOF
+  > Require b_names.
+  > Import b_names._'.a.b.
+  > EOF
+  $ coqc ${COQC_ARGS} client.v
@@ -0,0 +1,19 @@
+struct T {
+  int t;
+};
+
+namespace a {
+struct U {
+  int u;
+};
+
+inline namespace v1 {
+namespace b {
+struct S {
+  int x;
+  int y;
+};
+using I = int;
+} // namespace b
+} // namespace v1
+} // namespace a
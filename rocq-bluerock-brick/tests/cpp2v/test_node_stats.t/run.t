@@ -0,0 +1,29 @@
+  $ . ../../setup-cpp2v.sh
+  $ cpp2v -node-stats stats.json -o test_cpp.v test.cpp -- -std=c++17
+
+The counters are kept per printer and per Clang node class. Expressions
+and statements are never replayed from the sharing cache.
+
+  $ grep -A4 '"BinaryOperator"' stats.json | grep -v '"bytes"\|"ns"'
+      "BinaryOperator": {
+        "count": 1,
+        "hits": 0
+  $ grep -A4 '"ReturnStmt"' stats.json | grep -v '"bytes"\|"ns"'
+      "ReturnStmt": {
+        "count": 1,
+        "hits": 0
+
+Every printer has an object, even when it printed nothing.
+
+  $ grep '^  "' stats.json
+    "expr": {
+    "stmt": {
+    "type": {
+    "decl": {
+    "name": {
+
+An unwritable file is an error.
+
+  $ cpp2v -node-stats nodir/stats.json -o test_cpp.v test.cpp -- -std=c++17
+  nodir/stats.json: No such file or directory
+  [1]
@@ -0,0 +1,47 @@
+  $ . ../../setup-cpp2v.sh
+  $ cpp2v -specs test_spec.v test.cpp -- -std=c++17
+
+Each function definition with a doc comment gets a specification, and
+`/*!coq` comments are copied.
+
+  $ grep -c "BEGIN_SOURCE" test_spec.v
+  5
+  $ grep -c "plain_spec" test_spec.v
+  0
+  [1]
+  $ grep -F "Definition extra := 1." test_spec.v
+  Definition extra := 1.
+
+The `\pre` and `\post` paragraphs fill in the skeleton, after the
+arguments.
+
+  $ grep -F "Definition incr_spec :=" test_spec.v
+  Definition incr_spec :=
+  $ grep -F -A4 "\arg{x}" test_spec.v | head -3 | sed 's/^ *//'
+  \arg{x} "x" x
+  \pre [| 0 <= x |]
+  \post[Vint (x + 1)] emp.
+
+Overloads are numbered, and specifications without `\post` end with
+`\post emp`.
+
+  $ grep -F -A4 "Definition incr_2_spec :=" test_spec.v | sed 's/^ *//' | tail -3
+  \arg{x} "x" x
+  \arg{y} "y" y
+  \post emp.
+
+Methods take `this`, and unnamed arguments are named after their position.
+
+  $ grep -F "Definition C__set_spec (this : ptr) :=" test_spec.v
+  Definition C__set_spec (this : ptr) :=
+  $ grep -F -A5 "Definition C__set_spec" test_spec.v | sed 's/^ *//' | tail -4
+  \with (n : Z)
+  \arg{arg0} "arg0" arg0
+  \pre this |-> intR 1$m n
+  \post emp.
+
+A `\spec` paragraph is the whole specification.
+
+  $ grep -F -A1 "Definition raw_spec :=" test_spec.v | sed 's/^ *//'
+  Definition raw_spec :=
+  fun this => True.
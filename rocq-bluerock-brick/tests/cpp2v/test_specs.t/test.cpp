@@ -0,0 +1,22 @@
+/// \pre [| 0 <= x |]
+/// \post[Vint (x + 1)] emp
+int incr(int x) { return x + 1; }
+
+/// Overloads are numbered.
+int incr(int x, int y) { return x + y; }
+
+struct C {
+	/// \with (n : Z)
+	/// \pre this |-> intR 1$m n
+	void set(int) {}
+};
+
+/// \spec fun this => True
+void raw() {}
+
+/*!coq
+Definition extra := 1.
+*/
+
+// not a doc comment
+void plain() {}
@@ -0,0 +1,13 @@
+namespace std {
+struct destroying_delete_t {
+  explicit destroying_delete_t() = default;
+};
+} // namespace std
+
+struct S {
+  void operator delete(S *, std::destroying_delete_t);
+};
+
+void drop(S *s) { delete s; }
+
+int after() { return 1; }
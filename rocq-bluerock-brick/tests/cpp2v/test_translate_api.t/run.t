@@ -0,0 +1,23 @@
+  $ . ../../setup-cpp2v.sh
+
+`cpp2v::translate` prints a translation unit without a `CompilerInstance`,
+as `cpp2v` itself does when it does not elaborate.
+
+  $ cpp2v -no-elaborate -names test_cpp_names.v -o test_cpp.v test.cpp -- -std=c++17
+  $ mkdir api
+  $ cpp2v -via-translate -names api/test_cpp_names.v -o api/test_cpp.v test.cpp -- -std=c++17
+  $ cmp test_cpp.v api/test_cpp.v
+  $ cmp test_cpp_names.v api/test_cpp_names.v
+  $ coqc ${COQC_ARGS} test_cpp_names.v
+  $ coqc ${COQC_ARGS} test_cpp.v
+
+Errors in the input fail the translation without stopping it: `cpp2v`
+still prints the rest of the translation unit, and exits with an error.
+
+  $ cpp2v -no-elaborate -o destroying_cpp.v destroying.cpp -- -std=c++20 2> /dev/null
+  [1]
+  $ grep -q after destroying_cpp.v
+  $ cpp2v -via-translate -o api/destroying_cpp.v destroying.cpp -- -std=c++20 2> /dev/null
+  [1]
+  $ test -e api/destroying_cpp.v
+  [1]
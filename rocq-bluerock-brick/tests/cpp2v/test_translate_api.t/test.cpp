@@ -0,0 +1,19 @@
+namespace ns {
+struct point {
+  int x;
+  int y;
+};
+
+int norm1(point p) { return (p.x < 0 ? -p.x : p.x) + (p.y < 0 ? -p.y : p.y); }
+
+enum class color { red, green };
+
+color flip(color c) { return c == color::red ? color::green : color::red; }
+} // namespace ns
+
+int sum(int n) {
+  int s = 0;
+  for (int i = 0; i < n; ++i)
+    s += i;
+  return s;
+}
@@ -1,5 +1,6 @@
 export COQPATH="$DUNE_SOURCEROOT/_build/install/default/lib/coq/user-contrib"
 export COQLIB="$DUNE_SOURCEROOT/_build/install/default/lib/coq"
+export OCAMLPATH="$DUNE_SOURCEROOT/_build/install/default/lib${OCAMLPATH:+:$OCAMLPATH}"
 
 COQC_ARGS="-w -notation-overridden -w -notation-incompatible-prefix"
 
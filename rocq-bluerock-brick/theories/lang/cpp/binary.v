@@ -0,0 +1,28 @@
+(*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ *)
+Require Export bedrock.lang.cpp.parser.
+
+(**
+[Cpp2v Load "file.bin" as module.] defines [module : translation_unit]
+from the output of [cpp2v -binary file.bin], the binary counterpart of
+[cpp2v -o]. This saves lexing, parsing and elaborating the textual
+translation unit: the command builds the term directly, inserting the
+implicit arguments of the definitions of [bedrock.lang.cpp.parser] and
+typing literals from where they appear, so no scope needs to be open.
+Like the files printed by [cpp2v -o], it resolves identifiers where
+[bedrock.lang.cpp.parser] is imported:
+<<
+Require Import bedrock.lang.cpp.binary.
+Cpp2v Load "test_cpp.bin" as module.
+>>
+
+[Cpp2v Import "file.cpp" with "-std=c++17" as module.] translates
+[file.cpp] (with the given Clang flags, if any) as [cpp2v -binary] does,
+within Coq, and loads the result in the same way. The binary files are
+saved in [$CPP2V_CACHE] (by default, [~/.cache/cpp2v]) and reused until
+[file.cpp], the files it includes, the flags or the plugin change.
+*)
+Declare ML Module "rocq-bluerock-brick.plugin".
@@ -37,9 +37,17 @@ Module Import translation_unit.
 
   #[global] Instance raw_structured_insert : forall {T}, Insert globname T (NM.Raw.t T) := _.
 
+  (**
+  The tables accumulate their entries in [NM.acc]s, which build the raw
+  trees in linear time from the entries cpp2v emits sorted by name.
+  *)
+  Definition symbol_acc : Type := NM.acc ObjValue.
+  Definition type_acc : Type := NM.acc GlobDecl.
+  Definition alias_acc : Type := NM.acc type.
+
   Definition t : Type :=
-    raw_symbol_table -> raw_type_table -> raw_alias_table -> list name ->
-    (raw_symbol_table -> raw_type_table -> raw_alias_table -> list name -> translation_unit * list name) ->
+    symbol_acc -> type_acc -> alias_acc -> list name ->
+    (symbol_acc -> type_acc -> alias_acc -> list name -> translation_unit * list name) ->
     translation_unit * list name.
 
   Definition merge_obj_value (a b : ObjValue) : option ObjValue :=
@@ -50,12 +58,9 @@ Module Import translation_unit.
 
   Definition _symbols (n : name) (v : ObjValue) : t :=
     fun s t a dups k =>
-      match s !! n with
-      | None => k (<[n := v]> s) t a dups
-      | Some v' => match merge_obj_value v v' with
-                  | Some v => k (<[n:=v]> s) t a dups
-                  | None => k s t a (n :: dups)
-                  end
+      match NM.acc_add merge_obj_value n v s with
+      | Some s => k s t a dups
+      | None => k s t a (n :: dups)
       end.
   Definition merge_glob_decl (a b : GlobDecl) : option GlobDecl :=
     if sub_module.GlobDecl_le a b then
@@ -65,18 +70,17 @@ Module Import translation_unit.
 
   Definition _types (n : name) (v : GlobDecl) : t :=
     fun s t a dups k =>
-      match t !! n with
-      | None => k s (<[n := v]> t) a dups
-      | Some v' => match merge_glob_decl v v' with
-                   | Some v => k s (<[n:=v]> t) a dups
-                   | None => k s t a (n :: dups)
-                   end
+      match NM.acc_add merge_glob_decl n v t with
+      | Some t => k s t a dups
+      | None => k s t a (n :: dups)
       end.
+  Definition merge_alias (a b : type) : option type := None.
+
   Definition _aliases (n : name) (v : type) : t :=
     fun s t a dups k =>
-      match a !! n with
-      | None => k s t (<[n:=v]> a) dups
-      | _ => k s t a (n :: dups)
+      match NM.acc_add merge_alias n v a with
+      | Some a => k s t a dups
+      | None => k s t a (n :: dups)
       end.
   Definition _skip : t :=
     fun s t a dups k => k s t a dups.
@@ -87,14 +91,25 @@ Module Import translation_unit.
     | d :: ds => fun s t a dups k => d s t a dups (fun s t a dups' => decls' ds s t a dups' k)
     end.
 
+  (** [_include tu] adds the entries of [tu] (e.g., the translation of an
+      imported Clang module, see cpp2v's [-import-dir]). *)
+  Definition _include (tu : translation_unit) : t :=
+    decls' ((fun '(n, v) => _symbols n v) <$> NM.elements tu.(symbols) ++
+            (fun '(n, v) => _types n v) <$> NM.elements tu.(types) ++
+            (fun '(n, v) => _aliases n v) <$> NM.elements tu.(aliases)).
+
   Definition decls (ds : list t) (e : endian) : translation_unit * list name :=
-    decls' ds ∅ ∅ ∅ [] $ fun s t a => pair {|
-      symbols := NM.from_raw s;
-      types := NM.from_raw t;
-      aliases := NM.from_raw a;
-      initializer := nil;	(** TODO *)
-      byte_order := e;
-    |}.
+    decls' ds NM.acc_empty NM.acc_empty NM.acc_empty [] $ fun s t a dups =>
+      let '(s, sdups) := NM.of_acc merge_obj_value s in
+      let '(t, tdups) := NM.of_acc merge_glob_decl t in
+      let '(a, adups) := NM.of_acc merge_alias a in
+      ({|
+        symbols := NM.from_raw s;
+        types := NM.from_raw t;
+        aliases := NM.from_raw a;
+        initializer := nil;	(** TODO *)
+        byte_order := e;
+      |}, sdups ++ tdups ++ adups ++ dups).
 
   (*
   Definition the_tu (result : translation_unit * list name)
@@ -39,6 +39,59 @@ Module Import internal.
     Include FMapAVL.Make Key.
     Include FMapExtra.MIXIN Key.
     Include FMapExtra.MIXIN_LEIBNIZ Key.
+
+    (** *** Building maps from (mostly) sorted entries *)
+    (**
+    [acc V] accumulates the entries of a map. Entries arriving in
+    increasing order (as cpp2v emits them) cost one comparison each and
+    go to [acc_run] (last first), from which [of_acc] builds a balanced
+    tree in linear time. The other entries go to [acc_rest] (last first),
+    and cost a map insertion each.
+    *)
+    Record acc {V : Type} : Type := Acc {
+      acc_run : list (Compare.t * V);
+      acc_rest : list (Compare.t * V);
+    }.
+    #[global] Arguments acc : clear implicits.
+
+    Definition acc_empty {V} : acc V := Acc [] [].
+
+    (**
+    [acc_add merge k v a] adds entry [k, v] to [a], with [merge v v']
+    combining [v] with the value [v'] of an equal key (if any). Fails when
+    [merge] does.
+    *)
+    Definition acc_add {V} (merge : V -> V -> option V)
+        (k : Compare.t) (v : V) (a : acc V) : option (acc V) :=
+      match a.(acc_run) with
+      | [] => Some (Acc [(k, v)] a.(acc_rest))
+      | (k', v') :: run =>
+        match compareN k k' with
+        | Gt => Some (Acc ((k, v) :: a.(acc_run)) a.(acc_rest))
+        | Eq =>
+          match merge v v' with
+          | Some v => Some (Acc ((k', v) :: run) a.(acc_rest))
+          | None => None
+          end
+        | Lt => Some (Acc a.(acc_run) ((k, v) :: a.(acc_rest)))
+        end
+      end.
+
+    (**
+    [of_acc merge a] is the tree holding the entries of [a], with the
+    keys of the entries [merge] failed on.
+    *)
+    Definition of_acc {V} (merge : V -> V -> option V) (a : acc V)
+        : Raw.t V * list Compare.t :=
+      foldr (fun '(k, v) '(m, dups) =>
+        match m !! k with
+        | None => (<[k := v]> m, dups)
+        | Some v' =>
+          match merge v v' with
+          | Some v => (<[k := v]> m, dups)
+          | None => (m, k :: dups)
+          end
+        end) (raw_of_sorted (reverse a.(acc_run)), []) a.(acc_rest).
   End NameMap.
 
 End internal.
@@ -570,7 +570,7 @@ Module decltype.
         | Estring chars t =>
             mret $ Tref $ Tarray (Tconst t) (1 + list_numbers.lengthN chars)
         | Eint _ t =>
-            let* _ := guard (t ∈ [Tchar;Tuchar;Tschar;Tshort;Tushort;Tint;Tuint;Tlong;Tulong;Tlonglong;Tulonglong]) in
+            let* _ := guard (t ∈ [Tchar;Tuchar;Tschar;Tshort;Tushort;Tint;Tuint;Tlong;Tulong;Tlonglong;Tulonglong;Tint128_t;Tuint128_t]) in
             mret t
         | Ebool _ => mret Tbool
         | Eunop op e t =>
@@ -1079,6 +1079,15 @@ Module decltype.
     in
     let* _ := readerT.run (traverse (T:=eta list) fn $ NM.elements tu.(symbols)) $ tu_to_ext tu in
     mret tt.
+
+  (** Check a single symbol of [tu], so that checks of large translation
+      units can be split (and localized). Each check computes the symbol
+      and type tables of [tu] again. *)
+  Definition check_symbol (tu : translation_unit) (nm : name) : trace.M Error.t unit :=
+    match tu.(symbols) !! nm with
+    | Some v => readerT.run (trace (breadcrumb nm) $ internal.check_obj_value v) $ tu_to_ext tu
+    | None => mret tt
+    end.
 End decltype.
 
 Module exprtype.
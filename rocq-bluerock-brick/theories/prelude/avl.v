@@ -139,6 +139,49 @@ Module FMapExtra.
       #[global] Instance raw_singleton : SingletonM K A M := fun k a =>
         <[ k := a ]> ∅.
     End raw.
+    (** *** Building trees from sorted lists *)
+    Section of_sorted.
+      Context {A : Type}.
+      #[local] Notation M := (Map.Raw.t A).
+      #[local] Notation L := (list (K * A)).
+
+      Definition sorted_node (l : M * L) (r : L -> M * L) : M * L :=
+        match l.2 with
+        | [] => l
+        | (k, v) :: kvs => let r := r kvs in (Map.Raw.create l.1 k v r.1, r.2)
+        end.
+
+      (**
+      [sorted_tree p kvs] is a balanced tree holding the first [p] entries
+      of [kvs] (in order), paired with the other entries;
+      [sorted_tree_pred p kvs] does the same with the first [p - 1]
+      entries.
+      *)
+      Fixpoint sorted_tree (p : positive) (kvs : L) {struct p} : M * L :=
+        match p with
+        | xH => sorted_node (Map.Raw.empty, kvs) (pair Map.Raw.empty)
+        | xI p => sorted_node (sorted_tree p kvs) (sorted_tree p)
+        | xO p => sorted_node (sorted_tree p kvs) (sorted_tree_pred p)
+        end
+      with sorted_tree_pred (p : positive) (kvs : L) {struct p} : M * L :=
+        match p with
+        | xH => (Map.Raw.empty, kvs)
+        | xI p => sorted_node (sorted_tree p kvs) (sorted_tree_pred p)
+        | xO p => sorted_node (sorted_tree_pred p kvs) (sorted_tree_pred p)
+        end.
+
+      (**
+      [raw_of_sorted kvs] is a balanced tree holding the entries [kvs],
+      built in linear time. It is a binary search tree when the keys of
+      [kvs] are strictly increasing (which [from_raw] checks).
+      *)
+      Definition raw_of_sorted (kvs : L) : M :=
+        match N.of_nat (length kvs) with
+        | N0 => Map.Raw.empty
+        | Npos p => (sorted_tree p kvs).1
+        end.
+    End of_sorted.
+
     #[global] Instance raw_map : FMap Map.Raw.t := @Map.Raw.map.
     #[global] Instance raw_merge : Merge Map.Raw.t := @Map.Raw.map2.
     #[global] Instance raw_omap : OMap Map.Raw.t := fun _ _ f =>
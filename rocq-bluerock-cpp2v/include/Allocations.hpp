@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include <cstddef>
+
+/*
+Heap allocation counts for benchmarking the printers.
+
+Configuring with `-DCPP2V_COUNT_ALLOCATIONS=ON` replaces the global
+`operator new` with a counting version. Otherwise, `enabled()` is false
+and `count()` is always 0.
+*/
+namespace allocations {
+bool enabled();
+
+/// The number of calls to `operator new` so far
+std::size_t count();
+
+/*
+Whether `n` allocations are few enough for printing `decls` top-level
+declarations: at most `CPP2V_ALLOCATIONS_PER_DECL` (a CMake setting)
+per declaration, plus a fixed allowance for the output's own buffers
+and tables. Names, sharing definitions and scratch buffers are reused
+across declarations, so the count should grow linearly with `decls`.
+*/
+bool within_budget(std::size_t n, std::size_t decls);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "llvm/Support/Allocator.h"
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+/*
+A list that is only appended to, kept in chunks taken from an arena (see
+`push_back`), which frees them all at once. Appending thus takes no heap
+allocation of its own, and, unlike a vector in an arena, never leaves an
+outgrown buffer behind. Chunks double in size, so a list of `n` elements
+is kept in `O(log n)` of them.
+*/
+template<typename T>
+class ArenaList {
+	static_assert(std::is_trivially_destructible_v<T>,
+				  "the arena does not run destructors");
+
+	struct Chunk {
+		Chunk* next;
+		T* items;
+		std::size_t size;
+		std::size_t capacity;
+	};
+
+	// Every chunk holds at least one element
+	Chunk* first_{nullptr};
+	Chunk* last_{nullptr};
+	std::size_t size_{0};
+
+	static constexpr std::size_t FIRST_CHUNK = 16;
+
+public:
+	class iterator {
+		const Chunk* chunk_{nullptr};
+		std::size_t i_{0};
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		iterator() = default;
+		explicit iterator(const Chunk* chunk) : chunk_{chunk} {}
+
+		reference operator*() const {
+			return chunk_->items[i_];
+		}
+		pointer operator->() const {
+			return &chunk_->items[i_];
+		}
+		iterator& operator++() {
+			if (++i_ == chunk_->size) {
+				chunk_ = chunk_->next;
+				i_ = 0;
+			}
+			return *this;
+		}
+		iterator operator++(int) {
+			auto old = *this;
+			++*this;
+			return old;
+		}
+		bool operator==(const iterator& other) const {
+			return chunk_ == other.chunk_ && i_ == other.i_;
+		}
+		bool operator!=(const iterator& other) const {
+			return !(*this == other);
+		}
+	};
+	using const_iterator = iterator;
+
+	ArenaList() = default;
+	// Copies would append to the same chunks
+	ArenaList(const ArenaList&) = delete;
+	ArenaList& operator=(const ArenaList&) = delete;
+	ArenaList(ArenaList&&) = default;
+	ArenaList& operator=(ArenaList&&) = default;
+
+	/// Append `item`, in a chunk from `arena`, which must outlive the list
+	void push_back(const T& item, llvm::BumpPtrAllocator& arena) {
+		if (!last_ || last_->size == last_->capacity) {
+			auto capacity = last_ ? 2 * last_->capacity : FIRST_CHUNK;
+			auto chunk = new (arena.Allocate<Chunk>())
+				Chunk{nullptr, arena.Allocate<T>(capacity), 0, capacity};
+			(last_ ? last_->next : first_) = chunk;
+			last_ = chunk;
+		}
+		new (&last_->items[last_->size++]) T(item);
+		++size_;
+	}
+
+	iterator begin() const {
+		return iterator{first_};
+	}
+	iterator end() const {
+		return iterator{};
+	}
+	std::size_t size() const {
+		return size_;
+	}
+	bool empty() const {
+		return size_ == 0;
+	}
+};
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "Formatter.hpp"
+#include "Logging.hpp"
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <optional>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+/*
+A compact binary encoding of the terms `CoqPrinter` prints, read by
+the `Cpp2v Load` command (see `bedrock.lang.cpp.binary`).
+
+Rather than duplicating every printer, a `Reader` receives the structure
+of what they print from the `Formatter` (see `fmt::Structure`): the
+atoms (global references, `@`-references and numbers, as text, and the
+contents of string literals), their `%scope`s and how parentheses, `,`
+and `::` group them. Identical subterms are hash-consed, and identifiers
+and strings are stored once in a string table.
+
+The encoding (integers are unsigned LEB128):
+```
+"CPP2VBIN" version
+#strings (length bytes)*
+#nodes node*
+root
+```
+where each node refers to strings and earlier nodes by index:
+```
+REF ident | APP head #args arg* | STR string | NUM digits
+| SCOPE scope node | EXPLICIT ident | TUPLE #elems elem* | CONS head tail
+```
+*/
+namespace binary {
+static constexpr llvm::StringLiteral MAGIC = "CPP2VBIN";
+static constexpr unsigned VERSION = 2;
+
+enum Tag : unsigned char {
+	REF = 0,
+	APP = 1,
+	STR = 2,
+	NUM = 3,
+	SCOPE = 4,
+	/// `@ident`, without implicit arguments
+	EXPLICIT = 5,
+	/// `(a, b, c)`, that is `pair (pair a b) c`
+	TUPLE = 6,
+	/// `a :: l`
+	CONS = 7,
+};
+
+/// Receives the subterms of a term, bottom-up, from a `Reader`. Each
+/// method returns the index of the subterm it was given.
+class Builder {
+public:
+	virtual ~Builder() = default;
+	virtual unsigned ref(llvm::StringRef ident) = 0;
+	virtual unsigned explicit_ref(llvm::StringRef ident) = 0;
+	virtual unsigned str(llvm::StringRef s) = 0;
+	virtual unsigned num(llvm::StringRef digits) = 0;
+	virtual unsigned scope(llvm::StringRef scope, unsigned n) = 0;
+	virtual unsigned app(unsigned head, llvm::ArrayRef<unsigned> args) = 0;
+	virtual unsigned tuple(llvm::ArrayRef<unsigned> elems) = 0;
+	virtual unsigned cons(unsigned head, unsigned tail) = 0;
+};
+
+/*
+Builds the term a `Formatter` prints (while this is its structure) in a
+`Builder`. Logs the first thing it cannot read at `level`.
+*/
+class Reader : public fmt::Structure {
+	/// What is read of a parenthesized term
+	struct Group {
+		/// The head and arguments read so far
+		llvm::SmallVector<unsigned, 8> app;
+		/// The list elements before `::`
+		llvm::SmallVector<unsigned, 4> elems;
+		/// The tuple components before `,`
+		llvm::SmallVector<unsigned, 2> tuple;
+	};
+
+	Builder& build_;
+	const logging::Level level_;
+	llvm::SmallVector<Group, 16> groups_{1};
+	/// The text of the atom being read
+	llvm::SmallString<64> atom_;
+	bool failed_{false};
+
+	void fail(llvm::StringRef what);
+	unsigned term(llvm::StringRef atom);
+	void atom();
+	unsigned finish_app(Group&);
+	unsigned finish_list(Group&);
+	unsigned finish(Group&);
+
+public:
+	Reader(Builder& build, logging::Level level)
+		: build_{build}, level_{level} {}
+
+	void text(llvm::StringRef) override;
+	void string(llvm::StringRef) override;
+	void scope(llvm::StringRef) override;
+	void space() override;
+	void open() override;
+	void close() override;
+	void comma() override;
+	void cons() override;
+
+	/// The root of the term read, or `nullopt` if it could not be read
+	std::optional<unsigned> finish();
+};
+
+/// The string and node tables of a binary file
+class Encoder : public Builder {
+	llvm::StringMap<unsigned> strings_;
+	std::vector<llvm::StringRef> string_list_;
+
+	// A node's index, by its encoding
+	llvm::StringMap<unsigned> nodes_;
+	llvm::SmallString<0> node_bytes_;
+
+	unsigned string(llvm::StringRef s);
+	unsigned node(llvm::StringRef bytes);
+	unsigned node(Tag tag, llvm::ArrayRef<std::uint64_t> ns);
+
+public:
+	unsigned ref(llvm::StringRef ident) override;
+	unsigned explicit_ref(llvm::StringRef ident) override;
+	unsigned str(llvm::StringRef s) override;
+	unsigned num(llvm::StringRef digits) override;
+	unsigned scope(llvm::StringRef scope, unsigned n) override;
+	unsigned app(unsigned head, llvm::ArrayRef<unsigned> args) override;
+	unsigned tuple(llvm::ArrayRef<unsigned> elems) override;
+	unsigned cons(unsigned head, unsigned tail) override;
+
+	/// Write the file with root `root`
+	void emit(llvm::raw_ostream& out, unsigned root) const;
+};
+}
@@ -9,6 +9,7 @@
 #include "Trace.hpp"
 #include <clang/Basic/Diagnostic.h>
 #include <llvm/ADT/ArrayRef.h>
+#include <mutex>
 
 namespace clang {
 class Decl;
@@ -24,10 +25,8 @@ class Type;
 class BuiltinType;
 class DecltypeType;
 class ASTContext;
-class MangleContext;
 class ValueDecl;
 class SourceRange;
-class CompilerInstance;
 class Sema;
 class TypeDecl;
 class FieldDecl;
@@ -94,18 +93,17 @@ bool is_dependent(const clang::Expr*);
 
 class ClangPrinter {
 private:
-	clang::CompilerInstance* compiler_;
 	clang::ASTContext* context_;
-	clang::MangleContext* mangleContext_;
+	std::mutex* context_lock_;
 	const Trace::Mask trace_;
 	const clang::DeclContext* decl_{nullptr};
 	const bool comment_{false};
 	const bool typedefs_;
 
 	ClangPrinter(const ClangPrinter& from, const clang::DeclContext* decl)
-		: compiler_(from.compiler_), context_(from.context_),
-		  mangleContext_(from.mangleContext_), trace_(from.trace_), decl_{decl},
-		  comment_{from.comment_}, typedefs_{from.typedefs_} {}
+		: context_(from.context_), context_lock_(from.context_lock_),
+		  trace_(from.trace_), decl_{decl}, comment_{from.comment_},
+		  typedefs_{from.typedefs_} {}
 
 public:
 	// Silence some warnings until we can improve our diagnostics
@@ -114,7 +112,8 @@ public:
 	// Make `--trace` output more verbose
 	static inline constexpr bool debug = false;
 
-	ClangPrinter(clang::CompilerInstance* compiler, clang::ASTContext* context,
+	/// `context_lock` guards `context` (see `lock_context`)
+	ClangPrinter(clang::ASTContext* context, std::mutex& context_lock,
 				 Trace::Mask trace, bool comment, bool typdefs = false);
 
 	/*
@@ -138,12 +137,17 @@ public:
 		return *context_;
 	}
 
-	clang::CompilerInstance& getCompiler() {
-		return *compiler_;
-	}
-
-	clang::MangleContext& getMangleContext() {
-		return *mangleContext_;
+	/*
+	Some `ASTContext` queries compute their results on demand and cache
+	them in the context (constant evaluation, type sizes, record layouts,
+	destructor lookups, and the line tables of the `SourceManager` that
+	diagnostics use). Printers on different threads (see `printDecls`)
+	make them under this lock, which is that of the context (e.g., of the
+	`ToCoqConsumer` printing it), so unrelated translations do not wait for
+	each other.
+	*/
+	std::unique_lock<std::mutex> lock_context() const {
+		return std::unique_lock{*context_lock_};
 	}
 
 	bool printTypedefs() const {
@@ -153,9 +157,11 @@ public:
 	std::optional<std::pair<const clang::CXXRecordDecl*, clang::Qualifiers>>
 	getLambdaClass() const;
 
-	// Helpers for diagnostics
+	// Helpers for diagnostics (these format nothing at disabled levels)
 	llvm::raw_ostream& debug_dump(loc::loc);
-	llvm::raw_ostream& error_prefix(llvm::raw_ostream&, loc::loc);
+	llvm::raw_ostream& error_prefix(logging::Level, loc::loc);
+	/// Print `loc::describe(loc, getContext())` to `os`
+	llvm::raw_ostream& describe(llvm::raw_ostream& os, loc::loc);
 
 	std::string sourceLocation(const clang::SourceLocation) const;
 	std::string sourceRange(const clang::SourceRange sr) const;
@@ -48,6 +48,9 @@ public:
 	bool structured_keys() const {
 		return structured_keys_;
 	}
+	Cache& cache() const {
+		return name_cache_;
+	}
 
 	[[noreturn]] void die() {
 		output().flush();
@@ -59,10 +62,10 @@ public:
 	}
 
 	fmt::Formatter& begin_tuple() {
-		return this->output_ << "(";
+		return this->output_ << fmt::lgroup;
 	}
 	fmt::Formatter& end_tuple() {
-		return this->output_ << ")";
+		return this->output_ << fmt::rgroup;
 	}
 	fmt::Formatter& next_tuple() {
 		return this->output_ << fmt::tuple_sep;
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "FragmentCache.hpp"
+#include "Logging.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace clang {
+class Decl;
+}
+class ClangPrinter;
+
+/*
+Prints declarations on a thread of its own while Clang parses the rest
+of the translation unit (`cpp2v -stream`), so that printing overlaps
+parsing.
+
+The thread prints declarations in the order they are pushed. Their
+printed forms are only a cache, however: the `-o` file still prints the
+declarations the module builder selects, in its usual order, and takes
+the printed form of a declaration from the stream when it is up to date.
+The output thus does not depend on the stream.
+
+Pushing a declaration again (e.g., after Clang defined its implicit
+members) makes the stream print it again, and the form printed last
+counts. Changes Clang makes without telling are caught by `validate`:
+a printed form is only up to date if the declaration's key (see
+`FragmentCache::keys`) is the same as when it was printed. Declarations
+without a key are not printed.
+
+Clang does not expect its AST to be read while it parses. The stream
+holds the context lock (see `ClangPrinter::lock_context`) while it
+prints a declaration, and the consumer holds it while it elaborates
+declarations, but Clang's own changes to the AST and to the caches of
+its `ASTContext` are not synchronized with the stream.
+
+Declarations are printed without sharing definitions, and outside
+templates. What printing a declaration logs is kept with its printed
+form, and logged again by `lookup`.
+*/
+class DeclStream {
+public:
+	/// Makes a printer that locks the given mutex for the lazy queries of
+	/// `ClangPrinter::lock_context`
+	using MakePrinter = std::function<ClangPrinter(std::mutex&)>;
+
+	DeclStream(MakePrinter mk_cprint, std::mutex& context_lock,
+			   bool structured_keys);
+	~DeclStream();
+	DeclStream(const DeclStream&) = delete;
+	DeclStream& operator=(const DeclStream&) = delete;
+
+	/// Print `decl` (again)
+	void push(const clang::Decl* decl);
+	/// Print `decl` and its enclosing declarations again, if they were
+	/// pushed before
+	void invalidate(const clang::Decl* decl);
+	/// Wait for the stream to print what was pushed
+	void finish();
+
+	/*
+	After `finish`, forget the printed forms of those of `decls` whose
+	keys changed since they were printed. `cprint` must lock the context
+	lock.
+	*/
+	void validate(llvm::ArrayRef<const clang::Decl*> decls,
+				  ClangPrinter& cprint);
+
+	/*
+	After `finish`, read the printed form of `decl` (if any, and up to
+	date) into `bytes` and `cons`, and log what printing it logged.
+	*/
+	bool lookup(const clang::Decl* decl, std::string& bytes,
+				bool& cons) const;
+
+	/// The number of declarations printed
+	std::size_t printed() const {
+		return printed_;
+	}
+
+private:
+	struct Printed {
+		// The form printed last is up to date when `printed == version`
+		unsigned version{0};
+		unsigned printed{0};
+		FragmentCache::Key key{FragmentCache::NONE};
+		std::string bytes;
+		bool cons{false};
+		std::string log;
+		bool failed{false};
+	};
+
+	const MakePrinter mk_cprint_;
+	std::mutex& context_lock_;
+	/*
+	The lock of the stream's printers, which only take it under
+	`context_lock_` (so that their lazy queries do not lock it again).
+	*/
+	std::mutex printer_lock_;
+	const bool structured_keys_;
+	/// Only for its keys
+	const FragmentCache keys_{/*dir*/ "", /*options*/ ""};
+
+	std::mutex mutex_;
+	std::condition_variable ready_;
+	std::deque<std::pair<const clang::Decl*, unsigned>> queue_;
+	std::map<const clang::Decl*, Printed> printed_decls_;
+	std::size_t printed_{0};
+	bool done_{false};
+	logging::Thread thread_;
+
+	void run();
+};
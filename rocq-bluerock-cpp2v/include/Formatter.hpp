@@ -6,21 +6,114 @@
 #pragma once
 
 #include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cstdint>
 #include <string.h>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace fmt {
 
+/*
+Receives what a `Formatter` prints as a tree rather than as text (see
+`binary::Reader`): the text of identifiers and numbers, the contents of
+string literals, `%scope`s, and the parentheses, tuple separators, list
+conses and spaces between them. Comments are not passed on.
+*/
+class Structure {
+public:
+	virtual ~Structure() = default;
+	/// (Part of) an identifier or a number
+	virtual void text(llvm::StringRef) = 0;
+	/// A string literal, unquoted
+	virtual void string(llvm::StringRef) = 0;
+	/// `%scope`, after an atom or a group
+	virtual void scope(llvm::StringRef) = 0;
+	virtual void space() = 0;
+	virtual void open() = 0;
+	virtual void close() = 0;
+	virtual void comma() = 0;
+	virtual void cons() = 0;
+};
+
+/*
+A `Structure` keeping what it receives, to pass it on to another one
+later (e.g., with the bytes of a memoised name, see `Formatter::replay`).
+*/
+class Recording : public Structure {
+	enum class Event : unsigned char {
+		TEXT,
+		STRING,
+		SCOPE,
+		SPACE,
+		OPEN,
+		CLOSE,
+		COMMA,
+		CONS
+	};
+	struct Entry {
+		Event event;
+		/// The span of the text of `TEXT`, `STRING` and `SCOPE` in `text_`
+		std::uint32_t begin;
+		std::uint32_t size;
+	};
+	std::string text_;
+	std::vector<Entry> entries_;
+
+	void add(Event e) {
+		entries_.push_back({e, 0, 0});
+	}
+	void add(Event e, llvm::StringRef text) {
+		entries_.push_back(
+			{e, std::uint32_t(text_.size()), std::uint32_t(text.size())});
+		text_.append(text.data(), text.size());
+	}
+
+public:
+	void text(llvm::StringRef text) override {
+		add(Event::TEXT, text);
+	}
+	void string(llvm::StringRef s) override {
+		add(Event::STRING, s);
+	}
+	void scope(llvm::StringRef scope) override {
+		add(Event::SCOPE, scope);
+	}
+	void space() override {
+		add(Event::SPACE);
+	}
+	void open() override {
+		add(Event::OPEN);
+	}
+	void close() override {
+		add(Event::CLOSE);
+	}
+	void comma() override {
+		add(Event::COMMA);
+	}
+	void cons() override {
+		add(Event::CONS);
+	}
+
+	bool empty() const {
+		return entries_.empty();
+	}
+	/// Pass what was received on to `s`
+	void replay(Structure& s) const;
+};
+
 class Formatter {
 private:
 	llvm::raw_ostream& out;
 	unsigned int depth;
 	unsigned int spaces;
 	bool blank;
+	Structure* structure_{nullptr};
 
 public:
-	explicit Formatter();
 	explicit Formatter(llvm::raw_ostream&);
 
 	llvm::raw_ostream& line();
@@ -40,11 +133,49 @@ public:
 
 	void ascii(int c);
 
+	/// Emit `text`, as rendered by a fresh `Formatter`, re-indenting each
+	/// of its lines relative to the current depth. While passing the
+	/// structure on, `structure` must be what `text` was printed with.
+	void replay(llvm::StringRef text, const Recording* structure = nullptr);
+
+	/// Also pass the structure of what is printed to `s` (until it is
+	/// reset to `nullptr`)
+	void set_structure(Structure* s) {
+		structure_ = s;
+	}
+	Structure* structure() const {
+		return structure_;
+	}
+
+	/// Print `text` as (part of) an atom
+	Formatter& write(llvm::StringRef text);
+
+	/// Print `s` as a Coq string literal (doubling any `"`)
+	Formatter& quoted(llvm::StringRef s);
+
+	/// Print `%scope`, after an atom or a group
+	Formatter& scope(llvm::StringRef scope);
+
 	template<typename T>
 	Formatter& operator<<(T val) {
-		nobreak() << val;
-		blank = false;
-		return *this;
+		if constexpr (std::is_convertible_v<T, llvm::StringRef>)
+			return write(val);
+		else {
+			if (structure_) {
+				llvm::SmallString<32> text;
+				llvm::raw_svector_ostream os{text};
+				os << val;
+				return write(text);
+			}
+			nobreak() << val;
+			blank = false;
+			return *this;
+		}
+	}
+
+	/// The number of bytes written so far
+	std::uint64_t tell() const {
+		return out.tell();
 	}
 
 public:
@@ -52,9 +183,6 @@ public:
 	unsigned int get_depth() const {
 		return depth;
 	}
-
-public:
-	static Formatter default_output;
 };
 
 struct NBSP;
@@ -125,6 +253,16 @@ struct RPAREN;
 extern const RPAREN* rparen;
 Formatter& operator<<(Formatter& out, const RPAREN* _);
 
+/// `(` and `)` that leave the indentation alone, around tuples and short
+/// applications
+struct LGROUP;
+extern const LGROUP* lgroup;
+Formatter& operator<<(Formatter& out, const LGROUP* _);
+
+struct RGROUP;
+extern const RGROUP* rgroup;
+Formatter& operator<<(Formatter& out, const RGROUP* _);
+
 struct LINE;
 extern const LINE* line;
 Formatter& operator<<(Formatter& out, const LINE* _);
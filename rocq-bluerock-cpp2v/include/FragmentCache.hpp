@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "PrePrint.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clang {
+class Decl;
+}
+class ClangPrinter;
+
+/*
+An on-disk cache of the printed forms ("fragments") of top-level
+declarations, so that reprinting a translation unit after a small edit
+only prints the declarations that changed.
+
+A fragment's key combines:
+- the declaration's `ODRHash` (which covers its body, the types it
+  mentions and the names of the declarations it refers to),
+- the bytes of its source range,
+- the structured names of the declarations and types it refers to (which
+  can change without the `ODRHash` changing, e.g., for anonymous types),
+- the layout of a record,
+- the values the printer folds into the declaration (e.g., of `case`
+  labels, which may be constants declared elsewhere, and of
+  `__builtin_LINE`, which depends on where the declaration is), and
+- `options`, which must identify everything else the printer depends on.
+
+Declarations `ODRHash` does not fully cover (e.g., members of template
+specializations) get no key and are always printed.
+
+A fragment records the sharing names it mentions, and must only be
+reused where those stand for the same thing (see `Cache::stable`).
+*/
+class FragmentCache {
+public:
+	using Key = std::uint64_t;
+	/// The key of declarations that are not cached
+	static constexpr Key NONE = 0;
+
+	FragmentCache(llvm::StringRef dir, llvm::StringRef options)
+		: dir_{dir.str()}, options_{options.str()} {}
+
+	/// The keys of `decls`, in order. The structured names of the
+	/// declarations they refer to are printed with `cache` (without
+	/// sharing definitions), so as to reuse (and fill) its memo.
+	std::vector<Key> keys(llvm::ArrayRef<const clang::Decl*> decls,
+						  ClangPrinter& cprint, Cache& cache) const;
+
+	/// Read the fragment of `key` (if any) into `bytes`, `cons` and the
+	/// sharing names it mentions, `refs`.
+	bool lookup(Key key, std::string& bytes, bool& cons,
+				Cache::Refs& refs) const;
+	/// Save the fragment of `key`. Failures are only logged.
+	void store(Key key, llvm::StringRef bytes, bool cons,
+			   llvm::ArrayRef<Cache::Ref> refs) const;
+
+private:
+	const std::string dir_;
+	const std::string options_;
+
+	std::string path(Key key) const;
+};
@@ -4,11 +4,20 @@
  * See the LICENSE-BedRock file in the repository root for details.
  */
 #pragma once
+#include <memory>
+#include <thread>
 
 namespace llvm {
 class raw_ostream;
 };
 
+/*
+Each thread has its own log level and log stream, so that translation
+units translated on different threads (see `cpp2v::translate`) log
+independently. Threads started to translate one translation unit take
+them over with `logging::Thread`.
+*/
+
 namespace logging {
 enum Level : int {
 	FATAL = -1,
@@ -19,6 +28,28 @@ enum Level : int {
 	ALL = 1000,
 };
 
+namespace detail {
+extern thread_local Level log_level;
+extern thread_local llvm::raw_ostream* log_stream;
+extern thread_local bool failed;
+}
+
+/// Whether messages at `level` are printed.
+inline bool
+enabled(Level level) {
+	return level <= detail::log_level;
+}
+
+/// The log stream of the current thread (by default, `llvm::errs()`)
+llvm::raw_ostream& stream();
+
+/*
+The stream for `level` (`llvm::nulls()` when `level` is disabled).
+
+NOTE: Writing to `llvm::nulls()` still formats the message. Callers
+that format anything expensive (AST dumps, source locations, names)
+should test `enabled` first or use `LOG`.
+*/
 llvm::raw_ostream& log(Level level = VERBOSE);
 
 static inline llvm::raw_ostream&
@@ -38,7 +69,127 @@ debug() {
 	return log(VERBOSER);
 }
 
+/// Run `k(os)` with the stream for `level`, provided `level` is enabled.
+template<typename K>
+inline void
+with(Level level, K k) {
+	if (enabled(level))
+		k(log(level));
+}
+
 void set_level(Level level);
 
+inline Level
+level() {
+	return detail::log_level;
+}
+
+/// The logging settings of a thread
+struct Settings {
+	Level level;
+	llvm::raw_ostream* stream;
+};
+
+inline Settings
+settings() {
+	return {detail::log_level, detail::log_stream};
+}
+
+/*
+Record that the current computation failed (after logging why), and keep
+going: errors in the input (e.g., constructs `cpp2v` does not support)
+fail the translation unit, which still prints the rest of it.
+*/
+inline void
+fail() {
+	detail::failed = true;
+}
+
+/// Whether `fail` was called since the innermost `Scope` began
+inline bool
+failed() {
+	return detail::failed;
+}
+
+/*
+Use `settings` on the current thread until the end of the scope, and
+track failures separately from the enclosing scope.
+*/
+class Scope {
+	const Settings saved_{settings()};
+	const bool failed_{detail::failed};
+
+public:
+	explicit Scope(Settings settings) {
+		detail::log_level = settings.level;
+		detail::log_stream = settings.stream;
+		detail::failed = false;
+	}
+	Scope(const Scope&) = delete;
+	~Scope() {
+		detail::log_level = saved_.level;
+		detail::log_stream = saved_.stream;
+		detail::failed = failed_;
+	}
+};
+
+/*
+Stop after a broken invariant of `cpp2v` itself: flush the logs and exit
+the process. Errors in the input should `fail` instead.
+*/
 [[noreturn]] void die();
+
+/*
+A thread running `k()` with the logging settings of the thread that
+started it.
+*/
+class Thread {
+	std::unique_ptr<bool> failed_{std::make_unique<bool>(false)};
+	std::thread thread_;
+
+public:
+	template<typename K>
+	explicit Thread(K k)
+		: thread_{[k = std::move(k), failed = failed_.get(),
+				   settings = settings()]() mutable {
+			  Scope scope{settings};
+			  k();
+			  *failed = logging::failed();
+		  }} {}
+
+	bool joinable() const {
+		return thread_.joinable();
+	}
+
+	/// Wait for `k`, and return `false` if it failed.
+	[[nodiscard]] bool join() {
+		thread_.join();
+		return !*failed_;
+	}
+};
+
+/*
+Join all `threads`, and return `false` (failing the current thread too)
+if any of them failed.
+*/
+template<typename THREADS>
+bool
+join(THREADS& threads) {
+	bool ok = true;
+	for (auto& thread : threads)
+		ok &= thread.join();
+	if (!ok)
+		fail();
+	return ok;
+}
 }
+
+/*
+`LOG(VERBOSE) << a << b;` evaluates and formats `a` and `b` only when
+`logging::VERBOSE` is enabled.
+*/
+#define LOG(level)                                                             \
+	if (!::logging::enabled(::logging::level))                                 \
+		;                                                                      \
+	else                                                                       \
+		::logging::log(::logging::level)
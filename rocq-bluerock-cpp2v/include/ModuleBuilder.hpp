@@ -4,16 +4,18 @@
  * See the LICENSE-BedRock file in the repository root for details.
  */
 #pragma once
+#include "ArenaList.hpp"
 #include "Trace.hpp"
 #include <clang/AST/Decl.h>
 #include <clang/AST/DeclCXX.h>
-#include <list>
+#include <llvm/Support/Allocator.h>
 #include <map>
-#include <set>
+#include <string>
 #include <utility>
 
 namespace clang {
 class CompilerInstance;
+class Module;
 };
 
 class Module {
@@ -39,8 +41,9 @@ public:
 	void add_declaration(const clang::NamedDecl&, Flags);
 	void add_assert(const clang::StaticAssertDecl&);
 
-	using AssertList = std::list<const clang::StaticAssertDecl*>;
-	using DeclList = std::list<const clang::NamedDecl*>;
+	// In the arena of the module, as the module only ever appends to them
+	using AssertList = ArenaList<const clang::StaticAssertDecl*>;
+	using DeclList = ArenaList<const clang::NamedDecl*>;
 
 	const AssertList& asserts() const {
 		return asserts_;
@@ -62,11 +65,34 @@ public:
 		return template_definitions_;
 	}
 
+	/// The declarations owned by one imported (top-level) Clang module
+	struct Import {
+		const clang::Module* module{nullptr};
+		DeclList declarations;
+		DeclList definitions;
+	};
+	using ImportMap = std::map<std::string, Import>;
+
+	/*
+	With `split_imports`, the (non-template) declarations owned by
+	imported Clang modules or header units, by the full name of their
+	top-level module. They are not in `declarations()`/`definitions()`.
+	*/
+	const ImportMap& imports() const {
+		return imports_;
+	}
+
 	Module() = delete;
-	Module(Trace::Mask trace) : trace_(trace & Trace::ModuleBuilder) {}
+	Module(Trace::Mask trace, bool split_imports = false)
+		: trace_(trace & Trace::ModuleBuilder), split_imports_{split_imports} {
+	}
 
 private:
 	const bool trace_;
+	const bool split_imports_;
+
+	/// The chunks of the lists below (and of `imports_`)
+	llvm::BumpPtrAllocator arena_;
 
 	DeclList declarations_;
 	DeclList definitions_;
@@ -76,6 +102,8 @@ private:
 
 	AssertList asserts_;
 
+	ImportMap imports_;
+
 	void add_decl(llvm::StringRef, DeclList&, DeclList&,
 				  const clang::NamedDecl&, Flags);
 };
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "PrePrint.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace clang {
+class Decl;
+}
+namespace llvm {
+class raw_ostream;
+}
+
+/*
+An index of a module file (`cpp2v -o`), so that tools can read the
+entries of a few declarations without reading (or Coq checking) the
+whole file.
+
+The index is a JSON object recording the byte ranges of the file's
+header (its `Require`s and scopes), of each sharing definition (`tN`,
+`nN`) and of each entry of the translation unit, together with the
+sharing names each of them mentions. `extract` puts the pieces back
+together.
+
+With the instructions that printing each entry took, the index also
+gives the per-command costs of the `rocq-tools` performance reports.
+*/
+class ModuleIndex {
+public:
+	/// Prints the structured name key of a declaration
+	using KeyPrinter = std::function<std::string(const clang::Decl*)>;
+
+	explicit ModuleIndex(KeyPrinter key) : key_{std::move(key)} {}
+
+	/// The header ends at byte `end`
+	void header(std::uint64_t end) {
+		header_ = end;
+	}
+	/// Sharing definition `name` (e.g., `t5`), mentioning `refs`
+	void shared(std::string name, std::uint64_t begin, std::uint64_t end,
+				llvm::ArrayRef<Cache::Ref> refs);
+	/// The entry of `decl`, mentioning `refs`, printed in `instructions`
+	void decl(const clang::Decl* decl, std::uint64_t begin, std::uint64_t end,
+			  llvm::ArrayRef<Cache::Ref> refs, std::uint64_t instructions = 0);
+
+	/// Write the index of `module_file` to `path`
+	void write(llvm::StringRef path, llvm::StringRef module_file,
+			   bool big_endian) const;
+
+	/// The cost of the whole translation unit
+	struct Totals {
+		std::uint64_t instructions;
+		std::uint64_t micros;
+		std::uint64_t peak_rss;
+		std::uint64_t bytes;
+	};
+	/*
+	Write the costs of the entries of `module_file` (which must be
+	complete) to `path`, in the data format of `rocq-tools`
+	(`lib/data.ml`), with the peak resident set and the size of
+	`module_file` in its `rss` and `sz` fields, in bytes.
+	*/
+	void write_costs(llvm::StringRef path, llvm::StringRef module_file,
+					 const Totals&) const;
+
+private:
+	struct Entry {
+		std::string name;
+		std::string key;
+		std::uint64_t begin;
+		std::uint64_t end;
+		std::vector<std::string> deps;
+		std::uint64_t instructions;
+	};
+
+	const KeyPrinter key_;
+	std::uint64_t header_{0};
+	std::vector<Entry> shared_;
+	std::vector<Entry> decls_;
+};
+
+/*
+Print a module file holding just the entries of the declarations named
+`names` (qualified C++ names, such as `ns::f`, or structured name keys),
+and the sharing definitions they need, from the module file that
+`index` describes. Return false (after logging why) if a file cannot be
+read or a name is not in the index.
+*/
+bool extract(llvm::StringRef index, llvm::ArrayRef<std::string> names,
+			 llvm::raw_ostream& out);
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "ModuleBuilder.hpp"
+#include <vector>
+
+class ClangPrinter;
+class Cache;
+
+namespace name_order {
+/*
+The declarations `declarations` and `definitions` of a module, without
+redundant redeclarations and sorted by structured name (printed with
+`templates` as in the templates file when that is set).
+
+`translation_unit.check` and `Mtranslation_unit.decls` build their name
+maps in linear time from entries sorted by increasing name (see
+`bedrock.lang.cpp.parser` and `bedrock.lang.cpp.mparser.tu`). We compute
+`compareN` (see `bedrock.lang.cpp.syntax.compare`) on the names printed
+by `cprint`, after unfolding the notations and parser definitions they
+use. The only terms we cannot evaluate are those whose types `mparser`
+infers, and placeholders without definitions; entries Coq finds out of
+order because of them cost a map insertion each.
+
+A definition subsumes the declarations of the same entity, so we drop
+those (and any redeclaration of a declared entity) rather than let Coq
+merge them.
+
+The names are printed with `cache`, which memoises them for the output
+that uses it. With `quiet`, printing them reports nothing, for outputs
+that print the names again (e.g., with sharing definitions).
+*/
+std::vector<const clang::NamedDecl*>
+sort(const ::Module::DeclList& declarations,
+	 const ::Module::DeclList& definitions, ClangPrinter& cprint, Cache& cache,
+	 bool templates = false, bool quiet = false);
+}
@@ -5,6 +5,7 @@
  */
 #pragma once
 #include <clang/Basic/Diagnostic.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/SmallVector.h>
 
 namespace clang {
@@ -12,47 +13,49 @@ class ValueDecl;
 class OpaqueValueExpr;
 }
 
+/*
+Indices of opaque values and anonymous locals in scope.
+
+Both maps keep their first few entries inline, so printing an ordinary
+expression allocates nothing.
+*/
 struct OpaqueNames {
 	OpaqueNames() {}
-	llvm::SmallVector<const clang::OpaqueValueExpr*, 3> indexes;
+	llvm::SmallDenseMap<const clang::OpaqueValueExpr*, int, 4> indexes;
+	int _next_index{0};
 	llvm::SmallVector<const clang::ValueDecl*, 3> anonymous;
+	llvm::SmallDenseMap<const clang::ValueDecl*, int, 4> anonymous_index;
 	int _index_count{-1};
 	int fresh(const clang::OpaqueValueExpr* e) {
-		int index = indexes.size();
-		indexes.push_back(e);
+		int index = _next_index++;
+		indexes.try_emplace(e, index);
 		return index;
 	}
 	// We don't need to reuse names (it would be an optimization), so we don't
-	// bother removing them from the `SmallVector`
+	// bother removing them from `indexes`
 	void free(const clang::OpaqueValueExpr* e) {}
-	int find(const clang::OpaqueValueExpr* e) {
-		int result = 0;
-		for (auto i : indexes) {
-			if (i == e)
-				return result;
-			++result;
-		}
-		return -1;
+	int find(const clang::OpaqueValueExpr* e) const {
+		auto it = indexes.find(e);
+		return it == indexes.end() ? -1 : it->second;
 	}
 
 	int push_anon(const clang::ValueDecl* e) {
 		int index = anonymous.size();
 		anonymous.push_back(e);
+		anonymous_index.try_emplace(e, index);
 		return index;
 	}
 	int find_anon(const clang::ValueDecl* e) const {
-		int result = 0;
-		for (auto i : anonymous) {
-			if (i == e)
-				return result;
-			++result;
-		}
-		return -1;
+		auto it = anonymous_index.find(e);
+		return it == anonymous_index.end() ? -1 : it->second;
 	}
 	void pop_anon(const clang::ValueDecl* e) {
 		assert(0 < anonymous.size() && "popping from empty vector");
 		assert(e == anonymous.back() && "popping wrong entry");
 		anonymous.pop_back();
+		auto it = anonymous_index.find(e);
+		if (it != anonymous_index.end() && it->second == int(anonymous.size()))
+			anonymous_index.erase(it);
 	}
 
 	int index_count() const {
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <string>
+
+namespace llvm {
+class raw_ostream;
+}
+
+/*
+The cost of translating, for the performance reports of `rocq-tools`
+(`cpp2v -perf`, `-perf-log`): instructions (which is what `coqc -profile`
+counts for Coq files), time and memory.
+
+Instructions are counted by the hardware counters that Linux offers
+through `perf_event_open`. Counting is off unless `enable` is called,
+which fails on other systems and when the kernel does not allow it.
+*/
+namespace perf {
+namespace detail {
+extern bool enabled;
+}
+
+/// Start counting, or explain in `why` why not
+bool enable(std::string& why);
+
+inline bool
+enabled() {
+	return detail::enabled;
+}
+
+/// The instructions the process has executed since `enable`, including
+/// those of the threads it joined
+std::uint64_t instructions();
+
+/// The instructions the calling thread has executed so far
+std::uint64_t thread_instructions();
+
+/// The microseconds since `enable`
+std::uint64_t micros();
+
+/// The peak resident set size of the process, in bytes
+std::uint64_t peak_rss();
+
+struct Node;
+
+/*
+A phase of the run, from construction to destruction, for `write_log`.
+Phases nest in the ones that are live, and only the main thread opens
+them.
+*/
+class Phase {
+	Node* node_{nullptr};
+
+public:
+	explicit Phase(llvm::StringRef name);
+	Phase(const Phase&) = delete;
+	~Phase();
+
+	/// Record `value` for `key` in the phase's metadata
+	void meta(llvm::StringRef key, std::uint64_t value);
+	void meta(llvm::StringRef key, llvm::StringRef value);
+};
+
+/// Write the phases as a log in the format of `rocq-tools` (`lib/log.ml`),
+/// with the instruction counts `c0` and `c1` that `lib/spandata.ml` wants
+void write_log(llvm::raw_ostream&);
+}
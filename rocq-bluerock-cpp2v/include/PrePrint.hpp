@@ -1,7 +1,25 @@
 #pragma once
 #include "Formatter.hpp"
 #include <Assert.hpp>
+#include <cstdint>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/xxhash.h>
+#include <array>
+#include <cstring>
+#include <deque>
 #include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace clang {
 class Decl;
@@ -11,19 +29,90 @@ class NamedDecl;
 
 class Cache {
 public:
-	using name_t = unsigned int;
+	using name_t = std::uint64_t;
 	static constexpr char TYPE_PREFIX = 't';
 	static constexpr char NAME_PREFIX = 'n';
 
+	/// A sharing name, e.g., `{TYPE_PREFIX, 5}` for `t5`
+	struct Ref {
+		char prefix;
+		name_t n;
+	};
+	using Refs = std::vector<Ref>;
+
 private:
-	template<typename T, char PREFIX>
+	/// What a stable name stands for, short of a copy of it
+	using Fingerprint = std::array<std::uint8_t, 16>;
+
+	template<typename T>
 	class NameCache {
 		std::map<T*, name_t> entries_{};
 		name_t next_{1};
+		// With stable names, the names handed out so far and what they
+		// stand for
+		std::map<name_t, Fingerprint> used_{};
+		// The contents that claimed a name somebody else had, by name
+		std::map<name_t, std::set<Fingerprint>> claims_{};
+		// How many collisions a content has lost
+		std::map<Fingerprint, unsigned> losses_{};
+
+		/*
+		The name of a content after `losses` collisions: its hash at
+		first, then hashes of its fingerprint. It only depends on the
+		content.
+		*/
+		static name_t candidate(llvm::StringRef content, const Fingerprint& fp,
+								unsigned losses) {
+			if (!losses)
+				return llvm::xxHash64(content);
+			char buf[sizeof(fp) + sizeof(losses)];
+			std::memcpy(buf, fp.data(), sizeof(fp));
+			std::memcpy(buf + sizeof(fp), &losses, sizeof(losses));
+			return llvm::xxHash64(llvm::StringRef(buf, sizeof(buf)));
+		}
 
 	public:
-		name_t fresh(T*) {
-			return ++next_;
+		/*
+		After a collision, the second component is false and the name is
+		only good for finishing the run (see `Cache::resolve_collisions`).
+		*/
+		std::pair<name_t, bool> fresh(T*, llvm::StringRef content,
+									  bool stable) {
+			if (!stable)
+				return {++next_, true};
+			Fingerprint fp =
+				llvm::MD5::hash(llvm::arrayRefFromStringRef(content));
+			auto lost = losses_.find(fp);
+			auto n = candidate(content, fp,
+							   lost == losses_.end() ? 0 : lost->second);
+			if (!n)
+				n = 1;
+			auto [it, fresh] = used_.try_emplace(n, fp);
+			if (!fresh && it->second != fp) {
+				auto& claims = claims_[n];
+				claims.insert(it->second);
+				claims.insert(fp);
+			}
+			return {n, fresh};
+		}
+		bool collided() const {
+			return !claims_.empty();
+		}
+		/*
+		Of the contents that claimed the same name, all but the least (by
+		fingerprint) lose, whatever order they came in. Then forget the
+		names handed out.
+		*/
+		void resolve() {
+			for (auto& [n, claims] : claims_)
+				for (auto& fp : llvm::drop_begin(claims))
+					++losses_[fp];
+			claims_.clear();
+			used_.clear();
+			entries_.clear();
+		}
+		bool defines(name_t n) const {
+			return used_.count(n);
 		}
 		void store(T* p, name_t n) {
 			always_assert(entries_.find(p) == entries_.end());
@@ -33,41 +122,242 @@ private:
 			auto nm = entries_.find(p);
 			return nm == entries_.end() ? 0 : nm->second;
 		}
-		bool reference(T* p, fmt::Formatter& output) {
-			auto x = lookup(p);
-			if (x) {
-				output << PREFIX << x;
+	};
+
+	NameCache<const clang::Type> types_{};
+	NameCache<const clang::NamedDecl> names_{};
+
+	/// Where `reference` records the names it prints, if anywhere
+	Refs* refs_{nullptr};
+
+	void note(const Ref& ref) {
+		if (refs_)
+			refs_->push_back(ref);
+	}
+
+	/*
+	Whether sharing names are derived from the terms they stand for
+	(rather than counted), so that they do not depend on the rest of the
+	translation unit.
+	*/
+	bool stable_{false};
+
+public:
+	/// A memoised rendering of a structured name
+	struct PrintedName {
+		llvm::StringRef bytes;
+		/// The structure `bytes` was printed with, if it was printed with one
+		const fmt::Recording* structure;
+		/// The sharing names `bytes` mentions
+		llvm::ArrayRef<Ref> refs;
+	};
+
+private:
+	/*
+	Structured names printed so far, indexed by `CoqPrinter::templates()`.
+	Their renderings are saved in `arena` (which `forget_names` resets
+	without freeing its first slab), sparing a heap allocation per name,
+	and stay where they are until then.
+
+	A name's rendering mentions the sharing definitions above (e.g., `n5`
+	for its enclosing scope), so any `store` invalidates the memo.
+	*/
+	struct PrintedNames {
+		llvm::BumpPtrAllocator arena;
+		std::deque<fmt::Recording> structures;
+		llvm::DenseMap<const clang::Decl*, PrintedName> names;
+
+		PrintedNames() = default;
+		PrintedNames(PrintedNames&&) = default;
+		PrintedNames& operator=(PrintedNames&&) = default;
+		/// A copy with renderings of its own
+		PrintedNames(const PrintedNames& other) {
+			for (auto& [decl, name] : other.names)
+				add(decl, name.bytes, name.structure, name.refs);
+		}
+		PrintedNames& operator=(const PrintedNames& other) {
+			return *this = PrintedNames(other);
+		}
+
+		PrintedName add(const clang::Decl* decl, llvm::StringRef bytes,
+						const fmt::Recording* structure,
+						llvm::ArrayRef<Ref> refs) {
+			PrintedName name{llvm::StringSaver{arena}.save(bytes), nullptr,
+							 {}};
+			if (!refs.empty()) {
+				auto copy = arena.Allocate<Ref>(refs.size());
+				std::uninitialized_copy(refs.begin(), refs.end(), copy);
+				name.refs = llvm::ArrayRef(copy, refs.size());
 			}
-			return (bool)x;
+			if (structure)
+				name.structure = &structures.emplace_back(*structure);
+			return names[decl] = name;
+		}
+		void clear() {
+			names.clear();
+			structures.clear();
+			arena.Reset();
 		}
 	};
+	PrintedNames printed_names_[2];
+	unsigned name_hits_{0};
+	unsigned name_misses_{0};
 
-	NameCache<const clang::Type, TYPE_PREFIX> types_{};
-	NameCache<const clang::NamedDecl, NAME_PREFIX> names_{};
+	void forget_names() {
+		for (auto& names : printed_names_)
+			names.clear();
+	}
 
 public:
-#define PASSTHRU(TY, MP)                                                       \
-	name_t fresh(TY* t) {                                                      \
-		return MP.fresh(t);                                                    \
+	explicit Cache(bool stable = false) : stable_{stable} {}
+
+	bool stable() const {
+		return stable_;
+	}
+
+	/*
+	`fresh(t, content)` is a name for `t`, printed as `content`. With
+	stable names, equal contents get the same name, and the second
+	component is false when the name was handed out before (so that its
+	definition must not be repeated).
+
+	`reference(p, output)` prints the name of `p`, if it has one.
+	*/
+#define PASSTHRU(TY, MP, PREFIX)                                               \
+	std::pair<name_t, bool> fresh(TY* t, llvm::StringRef content) {            \
+		return MP.fresh(t, content, stable_);                                  \
 	}                                                                          \
-	void store(TY* p, unsigned int n) {                                        \
+	void store(TY* p, name_t n) {                                              \
+		forget_names();                                                        \
 		return MP.store(p, n);                                                 \
 	}                                                                          \
 	name_t lookup(TY* t) {                                                     \
 		return MP.lookup(t);                                                   \
 	}                                                                          \
 	bool reference(TY* p, fmt::Formatter& output) {                            \
-		return MP.reference(p, output);                                        \
+		auto n = MP.lookup(p);                                                 \
+		if (n) {                                                               \
+			output << PREFIX << n;                                             \
+			note({PREFIX, n});                                                 \
+		}                                                                      \
+		return (bool)n;                                                        \
+	}
+	PASSTHRU(const clang::Type, types_, TYPE_PREFIX)
+	PASSTHRU(const clang::NamedDecl, names_, NAME_PREFIX)
+#undef PASSTHRU
+
+	/*
+	Two contents may hash to the same stable name. `fresh` then hands
+	out a name that is only good for finishing the run, and this
+	decides, from the colliding contents alone, which of them keeps the
+	name. If there were collisions, it forgets the names handed out and
+	returns true: the run must be repeated (and may find more).
+	*/
+	bool resolve_collisions() {
+		if (!types_.collided() && !names_.collided())
+			return false;
+		types_.resolve();
+		names_.resolve();
+		forget_names();
+		return true;
+	}
+
+	/*
+	While a `Recorder` lives, `reference` records the names it prints in
+	`refs` (rather than where it recorded them before), so that users of
+	the printed text need not scan it for names.
+	*/
+	class Recorder {
+		Cache& cache_;
+		Refs* outer_;
+
+	public:
+		Recorder(Cache& cache, Refs& refs)
+			: cache_{cache}, outer_{cache.refs_} {
+			cache.refs_ = &refs;
+		}
+		~Recorder() {
+			cache_.refs_ = outer_;
+		}
+		Recorder(const Recorder&) = delete;
+		Recorder& operator=(const Recorder&) = delete;
+	};
+
+	/*
+	The memoised rendering of `decl`'s structured name, if any, and if it
+	has a structure when `structured`. Like the result of
+	`remember_name`, it is valid until the next `store`.
+	*/
+	std::optional<PrintedName> printed_name(const clang::Decl* decl,
+											bool templates, bool structured) {
+		auto& names = printed_names_[templates].names;
+		auto it = names.find(decl);
+		if (it == names.end() || (structured && !it->second.structure)) {
+			++name_misses_;
+			return std::nullopt;
+		}
+		++name_hits_;
+		return it->second;
+	}
+
+	/// Memoise `bytes` (printed with `structure`, if any, and mentioning
+	/// `refs`) as the rendering of `decl`'s structured name
+	PrintedName remember_name(const clang::Decl* decl, bool templates,
+							  llvm::StringRef bytes,
+							  const fmt::Recording* structure = nullptr,
+							  llvm::ArrayRef<Ref> refs = {}) {
+		return printed_names_[templates].add(decl, bytes, structure, refs);
+	}
+
+	/// Print a memoised rendering to `output`, as `reference` would
+	void replay(const PrintedName& name, fmt::Formatter& output) {
+		output.replay(name.bytes, name.structure);
+		for (auto& ref : name.refs)
+			note(ref);
+	}
+
+	/*
+	Whether every sharing name in `refs` is defined. Only meaningful
+	with stable names.
+	*/
+	bool defines_all(llvm::ArrayRef<Ref> refs) const {
+		return llvm::all_of(refs, [&](const Ref& ref) {
+			return ref.prefix == TYPE_PREFIX ? types_.defines(ref.n)
+											 : names_.defines(ref.n);
+		});
+	}
+
+	/// A copy of this cache, with fresh statistics, for another thread.
+	/// Sharing definitions must not be added to either copy afterwards.
+	Cache fork() const {
+		Cache c(*this);
+		c.name_hits_ = c.name_misses_ = 0;
+		c.refs_ = nullptr;
+		return c;
+	}
+	/// Account for the names printed through a `fork()`
+	void join(const Cache& c) {
+		name_hits_ += c.name_hits_;
+		name_misses_ += c.name_misses_;
+	}
+
+	unsigned name_hits() const {
+		return name_hits_;
+	}
+	unsigned name_misses() const {
+		return name_misses_;
 	}
-	PASSTHRU(const clang::Type, types_)
-	PASSTHRU(const clang::NamedDecl, names_)
 };
 
 class ClangPrinter;
 class CoqPrinter;
 
+/*
+A `PRINTER<T>` prints the definition of a sharing name for a `T` (with
+the given prefix), and returns the name.
+*/
 template<typename T>
-using PRINTER = std::function<void(char, Cache::name_t, const T*)>;
+using PRINTER = std::function<Cache::name_t(char, const T*)>;
 
 void prePrintDecl(const clang::Decl*, Cache&, const PRINTER<clang::Type>&,
 				  const PRINTER<clang::NamedDecl>&);
\ No newline at end of file
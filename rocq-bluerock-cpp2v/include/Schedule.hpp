@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+/*
+Scheduling a batch of translation units (`cpp2v -batch-dir`) on a few
+threads.
+
+A few template-heavy translation units can take much longer than the
+rest, and a batch that starts them last ends with one thread busy and
+the others idle. So the batch starts the jobs that took longest in
+earlier runs first, as recorded in a small history file, and idle
+threads keep taking the next longest job.
+*/
+namespace schedule {
+/// What a job took in an earlier run
+struct Cost {
+	/// Wall time
+	std::uint64_t micros{0};
+	/// Output size
+	std::uint64_t bytes{0};
+};
+
+/// The costs of the jobs of earlier runs, by job name
+class History {
+	llvm::StringMap<Cost> costs_;
+
+public:
+	/// Read the history at `path`, if there is one, and return false
+	/// (after logging why) if it cannot be read
+	bool read(llvm::StringRef path);
+	/// Write the history to `path`, and return false (after logging why)
+	/// if that fails
+	bool write(llvm::StringRef path) const;
+
+	const Cost* find(llvm::StringRef job) const {
+		auto it = costs_.find(job);
+		return it == costs_.end() ? nullptr : &it->second;
+	}
+	void record(llvm::StringRef job, Cost cost) {
+		costs_[job] = cost;
+	}
+};
+
+/// A job of a batch, as it ran
+struct Run {
+	std::string job;
+	unsigned worker{0};
+	/// The microseconds since the start of the batch
+	std::uint64_t start{0};
+	std::uint64_t end{0};
+	std::uint64_t bytes{0};
+	bool ok{false};
+};
+
+/// Runs a job, setting the size of its output, and returns whether it succeeded
+using Job = llvm::function_ref<bool(llvm::StringRef job, std::uint64_t& bytes)>;
+
+/*
+Run `job` for each of `jobs` on `workers` threads, the ones that took
+longest in `history` first. Jobs the history does not know about start
+before all others, as they could be long. Return the runs in the order
+they started.
+*/
+std::vector<Run> run(llvm::ArrayRef<std::string> jobs, const History& history,
+					 unsigned workers, Job job);
+
+/*
+Print the wall time of the batch, its critical path (the jobs of the
+thread that finished last), and how long the other threads were left
+idle at the end.
+*/
+void summarize(llvm::raw_ostream&, llvm::ArrayRef<Run> runs);
+}
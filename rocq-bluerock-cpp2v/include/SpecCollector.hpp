@@ -4,12 +4,15 @@
  * See the LICENSE-BedRock file in the repository root for details.
  */
 #pragma once
-#include <map>
+#include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "Formatter.hpp"
 #include "ModuleBuilder.hpp"
 #include "clang/AST/Decl.h"
+#include "llvm/ADT/DenseMap.h"
 
 namespace clang {
 class CompilerInstance;
@@ -18,29 +21,32 @@ class CompilerInstance;
 class CoqPrinter;
 class ClangPrinter;
 
+/*
+Collects the doc comments of the function definitions of a translation
+unit, for `write_spec`.
+
+Collecting is opt-in: a collector that is not `enabled` ignores comments,
+so that translation units are not searched for comments nobody reads.
+Clang parses a comment the first time `comment` (or `parse`) needs it.
+*/
 class SpecCollector {
 public:
-	SpecCollector() {}
+	explicit SpecCollector(bool enabled = false) : enabled_{enabled} {}
 
-	void add_specification(const clang::NamedDecl* decl, RawComment* ref,
-						   ASTContext& context) {
-		ref->setAttached();
-		this->comment_decl_.insert(std::make_pair(ref, decl));
-		if (auto comment = context.getCommentForDecl(decl, nullptr)) {
-			this->specifications_.push_back(std::make_pair(decl, comment));
-		}
+	bool enabled() const {
+		return enabled_;
 	}
 
-	std::list<std::pair<const clang::NamedDecl*,
-						comments::FullComment*>>::const_iterator
-	begin() const {
-		return this->specifications_.begin();
+	void add_specification(const clang::NamedDecl* decl, RawComment* ref) {
+		if (!enabled_)
+			return;
+		ref->setAttached();
+		this->comment_decl_.try_emplace(ref, decl);
 	}
 
-	std::list<std::pair<const clang::NamedDecl*,
-						comments::FullComment*>>::const_iterator
-	end() const {
-		return this->specifications_.end();
+	/// The number of declarations with comments
+	std::size_t size() const {
+		return comment_decl_.size();
 	}
 
 	std::optional<const NamedDecl*> decl_for_comment(RawComment* cmt) const {
@@ -51,15 +57,53 @@ public:
 		return result->second;
 	}
 
+	/// The parsed doc comment of `decl`
+	comments::FullComment* comment(const NamedDecl* decl,
+								   ASTContext& context) {
+		auto result = parsed_.find(decl);
+		if (result == parsed_.end())
+			result =
+				parsed_
+					.try_emplace(decl, context.getCommentForDecl(decl, nullptr))
+					.first;
+		return result->second;
+	}
+
+	/// Parse all the comments collected, so that `comment` reads the AST only
+	void parse(ASTContext& context) {
+		for (auto& [_, decl] : comment_decl_)
+			comment(decl, context);
+	}
+
 private:
-	std::list<std::pair<const clang::NamedDecl*, comments::FullComment*>>
-		specifications_;
-	std::map<RawComment*, const NamedDecl*> comment_decl_;
+	const bool enabled_;
+	llvm::DenseMap<RawComment*, const NamedDecl*> comment_decl_;
+	llvm::DenseMap<const NamedDecl*, comments::FullComment*> parsed_;
 };
 
-void write_spec(clang::CompilerInstance* compiler, ::Module* mod,
-				const SpecCollector& specs,
-				const clang::TranslationUnitDecl* tu, Filter& filter,
-				fmt::Formatter& output);
+/*
+Print skeletons of the specifications of the function definitions in the
+main file that have doc comments, filled in from their `\with`, `\pre`,
+`\post` and `\spec` paragraphs. `!coq` comments (block comments whose text
+starts with `!coq`) are copied as they are.
+*/
+void write_spec(SpecCollector& specs, CoqPrinter& print, ClangPrinter& cprint,
+				ASTContext& context);
 
-void write_globals(::Module& mod, CoqPrinter& print, ClangPrinter& cprint);
\ No newline at end of file
+/// The declarations `write_globals` prints notations for
+struct GlobalsFilter {
+	/// Only declarations in the main file
+	bool main_file{false};
+	/// Only declarations in these namespaces (e.g., `std::chrono`) or the
+	/// namespaces they contain, unless empty. Inline namespaces are skipped.
+	std::vector<std::string> namespaces;
+};
+
+/*
+Print notations for the names of the records, fields and type aliases of
+`mod`. Notations for names in a namespace go to a submodule named after
+it (nested as the namespaces are), so that clients can import only the
+namespaces they use.
+*/
+void write_globals(::Module& mod, CoqPrinter& print, ClangPrinter& cprint,
+				   const GlobalsFilter& filter = {});
\ No newline at end of file
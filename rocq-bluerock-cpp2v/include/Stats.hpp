@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+namespace fmt {
+class Formatter;
+}
+namespace llvm {
+class raw_ostream;
+}
+
+/*
+Work counters for the printers, by Clang node class (e.g., how many
+`ImplicitCastExpr`s the expression printer printed, the bytes and time
+that took, and how often a type or name was replayed from the sharing
+cache rather than printed).
+
+Counting is off unless `enable` is called (by `cpp2v -node-stats`), in
+which case each thread counts on its own and `write` adds them up. The
+bytes and time of a node include those of the nodes printed for it.
+*/
+namespace stats {
+enum Printer { EXPR, STMT, TYPE, DECL, NAME, PRINTERS };
+
+namespace detail {
+extern bool enabled;
+}
+
+/// Start counting; call this before the printers run
+void enable();
+
+inline bool
+enabled() {
+	return detail::enabled;
+}
+
+/// Write the counters of all threads as a JSON object
+void write(llvm::raw_ostream&);
+
+struct Counters;
+
+/// Counts a node of class `kind` (e.g., `getStmtClassName()`) that
+/// `printer` prints to `out` for as long as the `Scope` lives
+class Scope {
+	Counters* counters_{nullptr};
+	const fmt::Formatter* out_;
+	std::uint64_t bytes_;
+	std::chrono::steady_clock::time_point start_;
+
+	void start(Printer, const char* kind);
+	void stop();
+
+public:
+	Scope(Printer printer, const char* kind, const fmt::Formatter& out)
+		: out_{&out} {
+		if (enabled())
+			start(printer, kind);
+	}
+	Scope(const Scope&) = delete;
+	~Scope() {
+		if (counters_)
+			stop();
+	}
+};
+
+void hit_(Printer, const char* kind);
+
+/// Count a node of class `kind` that `printer` replayed from a cache
+inline void
+hit(Printer printer, const char* kind) {
+	if (enabled())
+		hit_(printer, kind);
+}
+}
@@ -4,10 +4,16 @@
  * See the LICENSE-BedRock file in the repository root for details.
  */
 #pragma once
+#include "DeclStream.hpp"
+#include "Perf.hpp"
+#include "SpecCollector.hpp"
 #include "Trace.hpp"
 #include <clang/AST/ASTConsumer.h>
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/ASTMutationListener.h>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 
@@ -26,21 +32,74 @@ using namespace clang;
 class ToCoqConsumer : public clang::ASTConsumer, clang::ASTMutationListener {
 public:
 	using path = std::optional<std::string>;
+	/// The contents of output files, by path
+	using Buffers = std::map<std::string, std::string>;
+	/*
+	With `buffers`, the output files are printed to `buffers` rather than
+	written. `compiler` may then be null, provided `elaborate` is false.
+	*/
 	explicit ToCoqConsumer(clang::CompilerInstance *compiler,
 						   const path output_file, const path notations_file,
 						   const path templates_file, const path name_test_file,
-						   bool structured_keys, Trace::Mask trace,
-						   bool comment, bool sharing, bool type_check,
-						   bool elaborate = true, bool typedefs = false)
+						   const path specs_file, const path index_file,
+						   const path perf_file, const path binary_file,
+						   const path dep_file,
+						   const path fragment_dir, const path import_dir,
+						   const std::string &import_prefix,
+						   const GlobalsFilter &names_filter,
+						   bool structured_keys,
+						   Trace::Mask trace, bool comment, bool sharing,
+						   bool stable_sharing, bool type_check,
+						   bool check_decls, bool stream,
+						   bool elaborate = true, bool typedefs = false,
+						   unsigned jobs = 1, Buffers *buffers = nullptr)
 		: compiler_(compiler), output_file_(output_file),
 		  notations_file_(notations_file), templates_file_(templates_file),
-		  name_test_file_(name_test_file), structured_keys_(structured_keys),
+		  name_test_file_(name_test_file), specs_file_(specs_file),
+		  index_file_(index_file), perf_file_(perf_file),
+		  binary_file_(binary_file),
+		  dep_file_(dep_file), fragment_dir_(fragment_dir),
+		  import_dir_(import_dir), import_prefix_(import_prefix),
+		  names_filter_(names_filter), structured_keys_(structured_keys),
 		  trace_(trace), comment_{comment}, sharing_{sharing},
-		  elaborate_(elaborate), check_types_{type_check}, typedefs_{typedefs} {
+		  stable_sharing_{stable_sharing},
+		  elaborate_(elaborate), check_types_{type_check},
+		  check_decls_{check_decls}, streaming_{stream}, typedefs_{typedefs},
+		  jobs_{jobs}, buffers_{buffers} {
 	}
 
+private:
+	/*
+	While the stream prints (see `DeclStream`), the consumer changes the
+	AST under the context lock. Elaborating may call the consumer back
+	(e.g., through `AddedCXXTemplateSpecialization`), which then holds
+	the lock already.
+	*/
+	class EditLock {
+		ToCoqConsumer &consumer_;
+		const bool locked_;
+
+	public:
+		explicit EditLock(ToCoqConsumer &consumer)
+			: consumer_{consumer},
+			  locked_{consumer.stream_ && !consumer.editing_} {
+			if (locked_) {
+				consumer_.context_lock_.lock();
+				consumer_.editing_ = true;
+			}
+		}
+		EditLock(const EditLock &) = delete;
+		~EditLock() {
+			if (locked_) {
+				consumer_.editing_ = false;
+				consumer_.context_lock_.unlock();
+			}
+		}
+	};
+
 public:
 	// Implementation of `clang::ASTConsumer`
+	virtual void Initialize(clang::ASTContext &Context) override;
 	virtual void HandleTranslationUnit(clang::ASTContext &Context) override;
 
 	virtual void HandleTagDeclDefinition(TagDecl *decl) override;
@@ -62,13 +121,24 @@ public:
 		// it is not clear why this method should take a
 		// `const ClassTemplateSpecializationDecl` rather than a non-`const`
 		// See question: https://stackoverflow.com/questions/76085015/using-clangs-astconsumer-to-force-generation-of-implicit-members
+		EditLock _{*this};
 		elab(const_cast<ClassTemplateSpecializationDecl *>(D), true);
 	}
+	virtual void AddedCXXImplicitMember(const CXXRecordDecl *RD,
+										const Decl *D) override {
+		if (stream_)
+			stream_->invalidate(RD);
+	}
+	virtual void CompletedImplicitDefinition(const FunctionDecl *D) override {
+		if (stream_)
+			stream_->invalidate(D);
+	}
 
 private:
 	void toCoqModule(clang::ASTContext *ctxt, clang::TranslationUnitDecl *decl,
 					 bool sharing);
 	void elab(Decl *, bool rec = false);
+	void stream(Decl *);
 
 private:
 	clang::CompilerInstance *compiler_;
@@ -76,11 +146,39 @@ private:
 	const path notations_file_;
 	const path templates_file_;
 	const path name_test_file_;
+	const path specs_file_;
+	const path index_file_;
+	const path perf_file_;
+	const path binary_file_;
+	const path dep_file_;
+	const path fragment_dir_;
+	const path import_dir_;
+	const std::string import_prefix_;
+	const GlobalsFilter names_filter_;
 	const bool structured_keys_;
 	const Trace::Mask trace_;
 	const bool comment_;
 	const bool sharing_;
+	const bool stable_sharing_;
 	const bool elaborate_;
 	const bool check_types_;
+	const bool check_decls_;
+	const bool streaming_;
 	const bool typedefs_;
+	const unsigned jobs_;
+	Buffers *const buffers_;
+
+	/// Guards the `ASTContext` for printers on several threads (see
+	/// `ClangPrinter::lock_context`)
+	std::mutex context_lock_;
+
+	// With `streaming_`, from `Initialize` to `HandleTranslationUnit`
+	std::unique_ptr<DeclStream> stream_;
+	// Whether the parsing thread holds `context_lock_` (see `EditLock`)
+	bool editing_{false};
+
+	// From `Initialize` to `HandleTranslationUnit`
+	std::optional<perf::Phase> parsing_;
+	std::uint64_t start_instructions_{0};
+	std::uint64_t start_micros_{0};
 };
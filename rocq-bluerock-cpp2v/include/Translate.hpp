@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "Logging.hpp"
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+}
+
+/*
+The library interface of cpp2v, for tools that translate translation
+units without running the `cpp2v` executable.
+
+`translate` keeps no global state: its log level and log go to the
+calling thread only, and errors in the input fail the call (see
+`Result::ok`) rather than the process. Different threads can therefore
+translate different `ASTContext`s at the same time. It needs no
+`CompilerInstance`.
+*/
+namespace cpp2v {
+struct Options {
+	/// Print the `-o` file
+	bool module{true};
+	/// Print `-names`/`-templates`/`-name-test`/`-binary`/`-MD` files as well
+	bool names{false};
+	bool templates{false};
+	bool name_test{false};
+	bool binary{false};
+	bool dependencies{false};
+
+	bool structured_keys{true};
+	bool comment{false};
+	bool sharing{true};
+	bool stable_sharing{false};
+	bool check_types{false};
+	bool typedefs{true};
+	unsigned jobs{1};
+
+	logging::Level log_level{logging::UNSUPPORTED};
+};
+
+/// The printed files (empty unless requested and printed)
+struct Result {
+	/// Whether the translation unit was translated without errors
+	bool ok{false};
+	/// What `cpp2v -o` would write
+	std::string module;
+	std::string names;
+	std::string templates;
+	std::string name_test;
+	std::string binary;
+	/// A Make-style rule listing the files the translation unit was read from
+	std::string dependencies;
+	/// The warnings and errors of the translation
+	std::string log;
+};
+
+/*
+Translate the translation unit of `ctxt`, whose implicit members should
+already be defined (see `ToCoqConsumer::elab`).
+*/
+Result translate(clang::ASTContext& ctxt, const Options& options);
+
+/*
+Parse `file` with Clang arguments `args` (as after `--` on the `cpp2v`
+command line), elaborate it as `cpp2v` does, and translate it. Clang's
+diagnostics go to the log of the result.
+*/
+Result translate_file(const std::string& file,
+					  const std::vector<std::string>& args,
+					  const Options& options);
+}
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#pragma once
+#include "ModuleBuilder.hpp"
+
+namespace clang {
+class ASTContext;
+}
+
+namespace type_check {
+/*
+Check the bodies and initializers of `definitions` for the consistency
+conditions that `typed.decltype.check_tu` checks on their translations
+(see `bedrock.lang.cpp.syntax.typed`): the operands of casts, built-in
+operators and assignments, and the types of integer literals. Failures
+are reported as Clang errors.
+
+Returns whether all checks passed.
+*/
+bool check(const ::Module::DeclList& definitions, clang::ASTContext& ctxt);
+}
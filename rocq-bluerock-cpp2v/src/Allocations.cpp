@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "Allocations.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <llvm/Support/ErrorHandling.h>
+#include <new>
+
+#ifdef CPP2V_COUNT_ALLOCATIONS
+
+static std::atomic<std::size_t> allocations_{0};
+
+/*
+The standard library's other (non-aligned) forms of `operator new` and
+`operator delete` forward to these two.
+*/
+void*
+operator new(std::size_t size) {
+	allocations_.fetch_add(1, std::memory_order_relaxed);
+	if (auto p = std::malloc(size ? size : 1))
+		return p;
+	llvm::report_bad_alloc_error("cpp2v: operator new failed");
+}
+
+void
+operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+bool
+allocations::enabled() {
+	return true;
+}
+
+std::size_t
+allocations::count() {
+	return allocations_.load(std::memory_order_relaxed);
+}
+
+bool
+allocations::within_budget(std::size_t n, std::size_t decls) {
+	constexpr std::size_t fixed = 1 << 16;
+	return n <= fixed + decls * CPP2V_ALLOCATIONS_PER_DECL;
+}
+
+#else
+
+bool
+allocations::enabled() {
+	return false;
+}
+
+std::size_t
+allocations::count() {
+	return 0;
+}
+
+bool
+allocations::within_budget(std::size_t, std::size_t) {
+	return true;
+}
+
+#endif
@@ -10,7 +10,7 @@
 
 void
 assertion_failed(const char* e, const char* func, const char* file, int line) {
-	llvm::errs() << "Assertion failed: " << e << ", function " << func
-				 << ", file " << file << ", line " << line << ".\n";
+	logging::stream() << "Assertion failed: " << e << ", function " << func
+					  << ", file " << file << ", line " << line << ".\n";
 	logging::die();
 }
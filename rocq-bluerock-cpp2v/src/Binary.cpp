@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "Binary.hpp"
+#include "Logging.hpp"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace binary {
+namespace {
+void
+varint(SmallVectorImpl<char>& out, uint64_t n) {
+	do {
+		unsigned char byte = n & 0x7f;
+		n >>= 7;
+		if (n)
+			byte |= 0x80;
+		out.push_back(byte);
+	} while (n);
+}
+
+bool
+is_ident(StringRef s) {
+	return !s.empty() && (isAlpha(s.front()) || s.front() == '_') &&
+		   all_of(s, [](char c) {
+			   return isAlnum(c) || c == '_' || c == '\'' || c == '.';
+		   });
+}
+
+bool
+is_number(StringRef s) {
+	s.consume_front("-");
+	return !s.empty() && all_of(s, isDigit);
+}
+}
+
+void
+Reader::fail(StringRef what) {
+	if (!failed_)
+		logging::log(level_) << "reading Gallina: " << what << "\n";
+	failed_ = true;
+}
+
+unsigned
+Reader::term(StringRef atom) {
+	if (is_number(atom))
+		return build_.num(atom);
+	if (atom.front() == '@' && is_ident(atom.drop_front()))
+		return build_.explicit_ref(atom.drop_front());
+	if (is_ident(atom))
+		return build_.ref(atom);
+	fail("unexpected `" + atom.str() + "`");
+	return 0;
+}
+
+void
+Reader::atom() {
+	if (atom_.empty() || failed_)
+		return;
+	groups_.back().app.push_back(term(atom_));
+	atom_.clear();
+}
+
+unsigned
+Reader::finish_app(Group& g) {
+	if (g.app.empty()) {
+		fail("expected a term");
+		return 0;
+	}
+	auto t = g.app.front();
+	if (g.app.size() > 1)
+		t = build_.app(t, ArrayRef<unsigned>(g.app).drop_front());
+	g.app.clear();
+	return t;
+}
+
+unsigned
+Reader::finish_list(Group& g) {
+	auto t = finish_app(g);
+	while (!failed_ && !g.elems.empty())
+		t = build_.cons(g.elems.pop_back_val(), t);
+	return t;
+}
+
+unsigned
+Reader::finish(Group& g) {
+	auto t = finish_list(g);
+	if (failed_ || g.tuple.empty())
+		return t;
+	g.tuple.push_back(t);
+	return build_.tuple(g.tuple);
+}
+
+void
+Reader::text(StringRef text) {
+	if (failed_)
+		return;
+	// An atom may be printed in pieces, or with the space after it
+	for (auto c : text) {
+		if (isSpace(c))
+			atom();
+		else
+			atom_.push_back(c);
+	}
+}
+
+void
+Reader::string(StringRef s) {
+	atom();
+	if (!failed_)
+		groups_.back().app.push_back(build_.str(s));
+}
+
+void
+Reader::scope(StringRef scope) {
+	atom();
+	if (failed_)
+		return;
+	auto& app = groups_.back().app;
+	if (app.empty() || !is_ident(scope))
+		return fail("unexpected `%" + scope.str() + "`");
+	app.back() = build_.scope(scope, app.back());
+}
+
+void
+Reader::space() {
+	atom();
+}
+
+void
+Reader::open() {
+	atom();
+	if (!failed_)
+		groups_.emplace_back();
+}
+
+void
+Reader::close() {
+	atom();
+	if (failed_)
+		return;
+	if (groups_.size() == 1)
+		return fail("unbalanced `)`");
+	auto t = finish(groups_.back());
+	groups_.pop_back();
+	if (!failed_)
+		groups_.back().app.push_back(t);
+}
+
+void
+Reader::comma() {
+	atom();
+	if (failed_)
+		return;
+	auto& g = groups_.back();
+	auto t = finish_list(g);
+	g.tuple.push_back(t);
+}
+
+void
+Reader::cons() {
+	atom();
+	if (failed_)
+		return;
+	auto& g = groups_.back();
+	auto t = finish_app(g);
+	g.elems.push_back(t);
+}
+
+std::optional<unsigned>
+Reader::finish() {
+	atom();
+	if (!failed_ && groups_.size() != 1)
+		fail("unbalanced `(`");
+	auto t = failed_ ? 0 : finish(groups_.front());
+	if (failed_)
+		return std::nullopt;
+	return t;
+}
+
+unsigned
+Encoder::string(StringRef s) {
+	auto [it, fresh] = strings_.try_emplace(s, string_list_.size());
+	if (fresh)
+		string_list_.push_back(it->getKey());
+	return it->second;
+}
+
+unsigned
+Encoder::node(StringRef bytes) {
+	auto [it, fresh] = nodes_.try_emplace(bytes, nodes_.size());
+	if (fresh)
+		node_bytes_.append(bytes);
+	return it->second;
+}
+
+unsigned
+Encoder::node(Tag tag, ArrayRef<std::uint64_t> ns) {
+	SmallString<32> bytes;
+	bytes.push_back(tag);
+	for (auto n : ns)
+		varint(bytes, n);
+	return node(bytes);
+}
+
+unsigned
+Encoder::ref(StringRef ident) {
+	return node(REF, {string(ident)});
+}
+
+unsigned
+Encoder::explicit_ref(StringRef ident) {
+	return node(EXPLICIT, {string(ident)});
+}
+
+unsigned
+Encoder::str(StringRef s) {
+	return node(STR, {string(s)});
+}
+
+unsigned
+Encoder::num(StringRef digits) {
+	return node(NUM, {string(digits)});
+}
+
+unsigned
+Encoder::scope(StringRef scope, unsigned n) {
+	return node(SCOPE, {string(scope), n});
+}
+
+unsigned
+Encoder::app(unsigned head, ArrayRef<unsigned> args) {
+	SmallVector<std::uint64_t, 8> ns{head, args.size()};
+	ns.append(args.begin(), args.end());
+	return node(APP, ns);
+}
+
+unsigned
+Encoder::tuple(ArrayRef<unsigned> elems) {
+	SmallVector<std::uint64_t, 4> ns{elems.size()};
+	ns.append(elems.begin(), elems.end());
+	return node(TUPLE, ns);
+}
+
+unsigned
+Encoder::cons(unsigned head, unsigned tail) {
+	return node(CONS, {head, tail});
+}
+
+void
+Encoder::emit(raw_ostream& out, unsigned root) const {
+	SmallString<16> n;
+	auto number = [&](uint64_t v) {
+		n.clear();
+		varint(n, v);
+		out << n;
+	};
+	out << MAGIC;
+	number(VERSION);
+	number(string_list_.size());
+	for (auto s : string_list_) {
+		number(s.size());
+		out << s;
+	}
+	number(nodes_.size());
+	out << node_bytes_;
+	number(root);
+}
+}
@@ -11,23 +11,19 @@
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/DeclCXX.h>
 #include <clang/AST/ExprCXX.h>
-#include <clang/AST/Mangle.h>
-#include <clang/Frontend/CompilerInstance.h>
 #include <optional>
 
 using namespace clang;
 
-ClangPrinter::ClangPrinter(clang::CompilerInstance *compiler,
-						   clang::ASTContext *context, Trace::Mask trace,
+ClangPrinter::ClangPrinter(clang::ASTContext *context,
+						   std::mutex &context_lock, Trace::Mask trace,
 						   bool comment, bool typedefs)
-	: compiler_(compiler), context_(context), trace_(trace), comment_{comment},
-	  typedefs_{typedefs} {
-	mangleContext_ =
-		ItaniumMangleContext::create(*context, compiler->getDiagnostics());
-}
+	: context_(context), context_lock_(&context_lock), trace_(trace),
+	  comment_{comment}, typedefs_{typedefs} {}
 
 unsigned
 ClangPrinter::getTypeSize(const BuiltinType *t) const {
+	auto lock = lock_context();
 	return this->context_->getTypeSize(t);
 }
 
@@ -59,7 +55,7 @@ getParameterNumber(const ParmVarDecl *decl) {
 				return std::optional<int>(i);
 			++i;
 		}
-		llvm::errs() << "failed to find parameter\n";
+		logging::stream() << "failed to find parameter\n";
 	}
 	return std::optional<int>();
 }
@@ -83,25 +79,27 @@ ClangPrinter::printParamName(CoqPrinter &print, const ParmVarDecl *decl) {
 				offset = 0;
 			if (p == decl) {
 				if (decl->getIdentifier()) {
-					print.output() << "\"";
-					decl->printName(print.output().nobreak());
+					SmallString<32> name;
+					llvm::raw_svector_ostream os{name};
+					decl->printName(os);
 					if (offset)
-						print.output() << "..." << offset;
-					return print.output() << "\"";
+						os << "..." << offset;
+					return print.str(name);
 				} else {
-					return print.output() << "(localname.anon " << i << ")";
+					return print.output()
+						   << fmt::lgroup << "localname.anon" << fmt::nbsp << i
+						   << fmt::rgroup;
 				}
 			}
 			info = p->getIdentifier();
 			++i;
 		}
 	}
-	llvm::errs() << "failed to find parameter\n";
 	auto loc = loc::of(decl);
-	error_prefix(logging::fatal(), loc) << "error: cannot find parameter\n";
+	error_prefix(logging::FATAL, loc) << "error: cannot find parameter\n";
 	debug_dump(loc);
-	logging::die();
-	return print.output();
+	logging::fail();
+	return print.str("<unknown parameter>");
 }
 
 fmt::Formatter &
@@ -121,10 +119,11 @@ ClangPrinter::printValCat(CoqPrinter &print, const Expr *d) {
 			print.output() << "Xvalue";
 		else {
 			auto loc = loc::of(d);
-			error_prefix(logging::fatal(), loc)
+			error_prefix(logging::FATAL, loc)
 				<< "error: cannot determine value category\n";
 			debug_dump(loc);
-			logging::die();
+			logging::fail();
+			print.output() << "Prvalue";
 		}
 		return print.output();
 	}
@@ -165,13 +164,13 @@ ClangPrinter::printTypeTemplateParam(CoqPrinter &print, unsigned depth,
 			if (auto y = fd->getTemplateSpecializationArgs()) {
 				auto ary = y->asArray();
 				if (index >= ary.size()) {
-					llvm::errs() << "Looking for depth=" << depth
-								 << " index=" << index << "\n";
+					logging::stream() << "Looking for depth=" << depth
+									  << " index=" << index << "\n";
 					for (auto xx = d; xx; xx = xx->getLexicalParent()) {
-						llvm::errs() << xx->getDeclKindName();
+						logging::stream() << xx->getDeclKindName();
 						if (auto nd = dyn_cast<NamedDecl>(xx))
-							llvm::errs() << " " << nd->getNameAsString();
-						llvm::errs() << "\n";
+							logging::stream() << " " << nd->getNameAsString();
+						logging::stream() << "\n";
 					}
 					always_assert(false);
 				} else {
@@ -210,11 +209,13 @@ ClangPrinter::printTypeTemplateParam(CoqPrinter &print, unsigned depth,
 		}
 	}
 
-	error_prefix(logging::debug(), loc)
+	error_prefix(logging::FATAL, loc)
 		<< "error: could not infer template parameter name at depth " << depth
 		<< ", index " << index << "\n";
 	debug_dump(loc);
-	logging::die();
+	logging::fail();
+	guard::ctor _{print, "Tunsupported", false};
+	return print.str("template parameter");
 }
 
 fmt::Formatter &
@@ -252,9 +253,8 @@ ClangPrinter::printNonTypeTemplateParam(CoqPrinter &print, unsigned depth,
 				}
 				default: {
 					guard::ctor _{print, "Eunsupported"};
-					print.output()
-						<< "\"NonTypeTemplateParam " << v.getKind() << "\"";
-					return print.output();
+					return print.str("NonTypeTemplateParam " +
+									 std::to_string(v.getKind()));
 				}
 				}
 
@@ -286,11 +286,15 @@ ClangPrinter::printNonTypeTemplateParam(CoqPrinter &print, unsigned depth,
 		}
 	}
 
-	error_prefix(logging::debug(), loc)
+	error_prefix(logging::FATAL, loc)
 		<< "error: could not infer template parameter name at depth " << depth
 		<< ", index " << index << "\n";
 	debug_dump(loc);
-	logging::die();
+	logging::fail();
+	guard::ctor _{print, "Eunsupported", false};
+	print.str("template parameter") << fmt::nbsp;
+	guard::ctor type{print, "Tunsupported", false};
+	return print.str("template parameter");
 }
 
 fmt::Formatter &
@@ -303,11 +307,13 @@ ClangPrinter::printField(CoqPrinter &print, const ValueDecl *decl) {
 
 std::string
 ClangPrinter::sourceLocation(const SourceLocation loc) const {
+	auto lock = lock_context();
 	return loc.printToString(this->context_->getSourceManager());
 }
 
 std::string
 ClangPrinter::sourceRange(const SourceRange sr) const {
+	auto lock = lock_context();
 	return sr.printToString(this->context_->getSourceManager());
 }
 
@@ -318,21 +324,39 @@ ClangPrinter::getDecl() const {
 
 llvm::raw_ostream &
 ClangPrinter::debug_dump(loc::loc loc) {
-	return logging::debug() << loc::dump(loc, getContext(), getDecl());
+	auto &os = logging::debug();
+	if (logging::enabled(logging::VERBOSER)) {
+		auto lock = lock_context();
+		os << loc::dump(loc, getContext(), getDecl());
+	}
+	return os;
 }
 
 llvm::raw_ostream &
-ClangPrinter::error_prefix(llvm::raw_ostream &os, loc::loc loc) {
-	return os << loc::prefix(loc, getContext(), getDecl());
+ClangPrinter::error_prefix(logging::Level level, loc::loc loc) {
+	auto &os = logging::log(level);
+	if (logging::enabled(level)) {
+		auto lock = lock_context();
+		os << loc::prefix(loc, getContext(), getDecl());
+	}
+	return os;
+}
+
+llvm::raw_ostream &
+ClangPrinter::describe(llvm::raw_ostream &os, loc::loc loc) {
+	auto lock = lock_context();
+	return os << loc::describe(loc, getContext());
 }
 
 llvm::raw_ostream &
 ClangPrinter::trace(StringRef whence, loc::loc loc) {
-	auto &os = llvm::errs();
+	auto &os = logging::stream();
 	os << "[TRACE] " << whence;
 	auto decl = getDecl();
-	if (loc::can_trace(loc, decl))
+	if (loc::can_trace(loc, decl)) {
+		auto lock = lock_context();
 		os << " " << loc::trace(loc, getContext(), decl);
+	}
 	return os << "\n";
 }
 
@@ -374,10 +398,11 @@ ClangPrinter::printCallingConv(CoqPrinter &print, clang::CallingConv cc,
 	PRINT(CC_AArch64VectorCall);
 #endif
 	default:
-		error_prefix(logging::fatal(), loc)
+		error_prefix(logging::FATAL, loc)
 			<< "error: unsupported calling convention\n";
 		debug_dump(loc);
-		logging::die();
+		logging::fail();
+		print.output() << "CC_C";
 	}
 	return print.output();
 }
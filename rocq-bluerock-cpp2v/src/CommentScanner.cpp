@@ -4,6 +4,7 @@
  * See the LICENSE-BedRock file in the repository root for details.
  */
 #include "CommentScanner.hpp"
+#include "Logging.hpp"
 #include <Formatter.hpp>
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/DeclBase.h>
@@ -49,11 +50,11 @@ CommentScanner::decl_comments(const clang::Decl *decl,
 	auto start = getPrevSourceLoc(sm, decl);
 	auto end = getStartSourceLocWithComment(ctxt, decl);
 
-	llvm::errs() << "start/end: " << start.printToString(sm) << " "
-				 << end.printToString(sm) << "\n";
+	logging::stream() << "start/end: " << start.printToString(sm) << " "
+					  << end.printToString(sm) << "\n";
 
 	if (start.isValid() && end.isValid()) {
-		llvm::errs() << StringRef(sm.getCharacterData(start),
+		logging::stream() << StringRef(sm.getCharacterData(start),
 								  sm.getCharacterData(end) -
 									  sm.getCharacterData(start))
 					 << "\n";
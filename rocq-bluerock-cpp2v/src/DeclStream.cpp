@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "DeclStream.hpp"
+#include "ClangPrinter.hpp"
+#include "CoqPrinter.hpp"
+#include "Formatter.hpp"
+#include "PrePrint.hpp"
+#include "clang/AST/DeclBase.h"
+#include "llvm/Support/raw_ostream.h"
+#include <tuple>
+#include <vector>
+
+using namespace clang;
+
+DeclStream::DeclStream(MakePrinter mk_cprint, std::mutex& context_lock,
+					   bool structured_keys)
+	: mk_cprint_{std::move(mk_cprint)}, context_lock_{context_lock},
+	  structured_keys_{structured_keys}, thread_{[this] { run(); }} {}
+
+DeclStream::~DeclStream() {
+	if (!thread_.joinable())
+		return;
+	{
+		std::lock_guard lock{mutex_};
+		queue_.clear();
+		done_ = true;
+	}
+	ready_.notify_one();
+	(void)thread_.join();
+}
+
+void
+DeclStream::push(const Decl* decl) {
+	{
+		std::lock_guard lock{mutex_};
+		auto& p = printed_decls_[decl];
+		queue_.emplace_back(decl, ++p.version);
+	}
+	ready_.notify_one();
+}
+
+void
+DeclStream::invalidate(const Decl* decl) {
+	for (auto d = decl; d && !isa<TranslationUnitDecl>(d);
+		 d = Decl::castFromDeclContext(d->getDeclContext())) {
+		bool pushed;
+		{
+			std::lock_guard lock{mutex_};
+			pushed = printed_decls_.count(d);
+		}
+		if (pushed)
+			push(d);
+	}
+}
+
+void
+DeclStream::finish() {
+	{
+		std::lock_guard lock{mutex_};
+		done_ = true;
+	}
+	ready_.notify_one();
+	if (!thread_.join())
+		logging::fail();
+}
+
+void
+DeclStream::validate(llvm::ArrayRef<const Decl*> decls, ClangPrinter& cprint) {
+	std::vector<const Decl*> streamed;
+	for (auto decl : decls) {
+		auto it = printed_decls_.find(decl);
+		if (it != printed_decls_.end() &&
+			it->second.printed == it->second.version)
+			streamed.push_back(decl);
+	}
+	Cache cache;
+	auto keys = keys_.keys(streamed, cprint, cache);
+	std::size_t stale = 0;
+	for (std::size_t i = 0; i < streamed.size(); ++i) {
+		auto& p = printed_decls_[streamed[i]];
+		if (p.key != keys[i]) {
+			p.printed = 0;
+			++stale;
+		}
+	}
+	LOG(VERBOSER) << "stream: " << stale << " of " << streamed.size()
+				  << " declarations changed after they were printed\n";
+}
+
+bool
+DeclStream::lookup(const Decl* decl, std::string& bytes, bool& cons) const {
+	auto it = printed_decls_.find(decl);
+	if (it == printed_decls_.end())
+		return false;
+	auto& p = it->second;
+	if (p.printed != p.version || p.key == FragmentCache::NONE)
+		return false;
+	bytes = p.bytes;
+	cons = p.cons;
+	if (!p.log.empty())
+		logging::stream() << p.log;
+	if (p.failed)
+		logging::fail();
+	return true;
+}
+
+void
+DeclStream::run() {
+	auto cprint = mk_cprint_(printer_lock_);
+	Cache cache;
+	for (;;) {
+		const Decl* decl;
+		unsigned version;
+		{
+			std::unique_lock lock{mutex_};
+			ready_.wait(lock, [&] { return done_ || !queue_.empty(); });
+			if (queue_.empty())
+				return;
+			std::tie(decl, version) = queue_.front();
+			queue_.pop_front();
+			// pushed again since
+			if (printed_decls_[decl].version != version)
+				continue;
+		}
+
+		Printed p;
+		{
+			std::lock_guard context{context_lock_};
+			p.key = keys_.keys(decl, cprint, cache).front();
+			if (p.key != FragmentCache::NONE) {
+				llvm::raw_string_ostream log{p.log};
+				logging::Scope scope{{logging::level(), &log}};
+				llvm::raw_string_ostream os{p.bytes};
+				fmt::Formatter fmt{os};
+				CoqPrinter print(fmt, /*templates*/ false, structured_keys_,
+								 cache);
+				p.cons = cprint.withDecl(decl).printDecl(print, decl);
+				p.failed = logging::failed();
+			}
+		}
+
+		std::lock_guard lock{mutex_};
+		auto& q = printed_decls_[decl];
+		if (q.version == version) {
+			p.version = p.printed = version;
+			q = std::move(p);
+			++printed_;
+		}
+	}
+}
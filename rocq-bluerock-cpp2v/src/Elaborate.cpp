@@ -16,16 +16,15 @@
 #include "clang/Basic/Builtins.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Sema/Sema.h"
-#include <set>
+#include "llvm/ADT/DenseSet.h"
 
 using namespace clang;
 
-static raw_ostream &
+static void
 warning(loc::loc loc, const ASTContext &context, StringRef msg) {
-	auto &os = logging::unsupported();
-	os << loc::prefix(loc, context) << "warning: " << msg << "\n";
-	logging::debug() << loc::dump(loc, context);
-	return os;
+	LOG(UNSUPPORTED) << loc::prefix(loc, context) << "warning: " << msg
+					 << "\n";
+	LOG(VERBOSER) << loc::dump(loc, context);
 }
 
 using Flags = ::Module::Flags;
@@ -35,7 +34,7 @@ private:
 	using Visitor = DeclVisitorArgs<Elaborate, void, Flags>;
 
 	clang::CompilerInstance *const ci_;
-	std::set<int64_t> visited_;
+	llvm::DenseSet<const Decl *> visited_;
 	const bool templates_;
 	const bool trace_;
 	bool recursive_;
@@ -51,7 +50,7 @@ private:
 	void trace(StringRef what, const Decl &decl) {
 		auto loc = loc::of(decl);
 		if (loc::can_trace(loc)) {
-			auto &os = llvm::errs();
+			auto &os = logging::stream();
 			auto &context = decl.getASTContext();
 			os << "[Elaborate] " << what << " " << loc::trace(loc, context)
 			   << "\n";
@@ -65,8 +64,7 @@ public:
 		  recursive_(rec) {}
 
 	void Visit(Decl *d, Flags flags) {
-		if (visited_.find(d->getID()) == visited_.end()) {
-			visited_.insert(d->getID());
+		if (visited_.insert(d).second) {
 			Visitor::Visit(d, flags);
 		}
 	}
@@ -258,31 +256,80 @@ ToCoqConsumer::elab(Decl *d, bool rec) {
 	}
 }
 
+/*
+Push the definitions of functions and variables in `d` to the stream,
+outside templates and classes (whose members Clang may still change).
+Records and enumerations are pushed when Clang completes them (see
+`HandleTagDeclDefinition`), and inline member functions when Clang
+parses their bodies.
+*/
+void
+ToCoqConsumer::stream(Decl *d) {
+	if (d->isInvalidDecl() || d->isTemplated())
+		return;
+	if (isa<NamespaceDecl, LinkageSpecDecl, ExportDecl>(d)) {
+		for (auto i : cast<DeclContext>(d)->decls())
+			stream(i);
+	} else if (auto fd = dyn_cast<FunctionDecl>(d)) {
+		if (fd->doesThisDeclarationHaveABody())
+			stream_->push(fd);
+	} else if (auto vd = dyn_cast<VarDecl>(d)) {
+		if (vd->hasGlobalStorage() && !vd->isStaticDataMember())
+			stream_->push(vd);
+	}
+}
+
 bool
 ToCoqConsumer::HandleTopLevelDecl(DeclGroupRef decl) {
+	EditLock _{*this};
 	if (elaborate_) {
 		for (auto i : decl) {
 			elab(i, true);
 		}
 	}
+	if (stream_) {
+		for (auto i : decl) {
+			stream(i);
+		}
+	}
 	return true;
 }
 
 void
 ToCoqConsumer::HandleCXXImplicitFunctionInstantiation(FunctionDecl *decl) {
+	EditLock _{*this};
 	if (elaborate_)
 		elab(decl);
 }
 
 void
 ToCoqConsumer::HandleInlineFunctionDefinition(FunctionDecl *decl) {
+	EditLock _{*this};
 	if (elaborate_)
 		elab(decl);
+	if (stream_ && !decl->isInvalidDecl() && !decl->isTemplated())
+		stream_->push(decl);
 }
 
 void
 ToCoqConsumer::HandleTagDeclDefinition(TagDecl *decl) {
+	EditLock _{*this};
 	if (elaborate_) {
 		elab(decl);
 	}
+	/*
+	Without elaboration, Clang declares the implicit members of a record
+	when they are first used, so its printed form is likely to change.
+	*/
+	if (!stream_ || decl->isInvalidDecl() || decl->isTemplated() ||
+		!decl->isCompleteDefinition() ||
+		!decl->isDefinedOutsideFunctionOrMethod())
+		return;
+	if (auto rd = dyn_cast<CXXRecordDecl>(decl)) {
+		if (!elaborate_)
+			return;
+		// Clang computes layouts on demand; the stream must not race it
+		decl->getASTContext().getASTRecordLayout(rd);
+	}
+	stream_->push(decl);
 }
@@ -12,13 +12,13 @@
 
 namespace fmt {
 
-Formatter::Formatter() : Formatter(llvm::outs()) {}
-
 Formatter::Formatter(llvm::raw_ostream& _out)
 	: out(_out), depth(0), spaces(0), blank(true) {}
 
 llvm::raw_ostream&
 Formatter::line() {
+	if (structure_)
+		structure_->space();
 	out << "\n";
 	blank = true;
 	spaces = 0;
@@ -27,6 +27,8 @@ Formatter::line() {
 
 llvm::raw_ostream&
 Formatter::nobreak() {
+	if (structure_ && spaces)
+		structure_->space();
 	if (blank) {
 		for (unsigned int d = this->depth; d > 0; --d) {
 			out << " ";
@@ -70,7 +72,100 @@ Formatter::ascii(int val) {
 	out << "\"";
 }
 
-Formatter Formatter::default_output = Formatter();
+Formatter&
+Formatter::write(llvm::StringRef text) {
+	nobreak() << text;
+	blank = false;
+	if (structure_)
+		structure_->text(text);
+	return *this;
+}
+
+Formatter&
+Formatter::quoted(llvm::StringRef s) {
+	auto& os = nobreak();
+	os << '"';
+	for (auto rest = s;;) {
+		auto pos = rest.find('"');
+		if (pos == llvm::StringRef::npos) {
+			os << rest;
+			break;
+		}
+		os << rest.take_front(pos + 1) << '"';
+		rest = rest.drop_front(pos + 1);
+	}
+	os << '"';
+	blank = false;
+	if (structure_)
+		structure_->string(s);
+	return *this;
+}
+
+Formatter&
+Formatter::scope(llvm::StringRef scope) {
+	nobreak() << '%' << scope;
+	blank = false;
+	if (structure_)
+		structure_->scope(scope);
+	return *this;
+}
+
+void
+Recording::replay(Structure& s) const {
+	for (auto& e : entries_) {
+		auto text = llvm::StringRef(text_).substr(e.begin, e.size);
+		switch (e.event) {
+		case Event::TEXT:
+			s.text(text);
+			break;
+		case Event::STRING:
+			s.string(text);
+			break;
+		case Event::SCOPE:
+			s.scope(text);
+			break;
+		case Event::SPACE:
+			s.space();
+			break;
+		case Event::OPEN:
+			s.open();
+			break;
+		case Event::CLOSE:
+			s.close();
+			break;
+		case Event::COMMA:
+			s.comma();
+			break;
+		case Event::CONS:
+			s.cons();
+			break;
+		}
+	}
+}
+
+void
+Formatter::replay(llvm::StringRef text, const Recording* structure) {
+	auto outer = structure_;
+	if (outer) {
+		always_assert(structure && "replaying text without its structure");
+		// What separates `text` from what comes before
+		nobreak();
+		structure_ = nullptr;
+	}
+	for (auto pos = text.find('\n'); pos != llvm::StringRef::npos;
+		 pos = text.find('\n')) {
+		if (pos)
+			*this << text.take_front(pos);
+		line();
+		text = text.drop_front(pos + 1);
+	}
+	if (!text.empty())
+		*this << text;
+	if (outer) {
+		structure_ = outer;
+		structure->replay(*outer);
+	}
+}
 
 struct NBSP;
 const NBSP* nbsp;
@@ -101,6 +196,8 @@ const LPAREN* lparen;
 Formatter&
 operator<<(Formatter& out, const LPAREN* _) {
 	out.nobreak() << "(";
+	if (auto s = out.structure())
+		s->open();
 	out.indent();
 	return out;
 }
@@ -112,6 +209,28 @@ operator<<(Formatter& out, const RPAREN* _) {
 	out.outdent();
 	out.clear_spaces();
 	out.nobreak() << ")";
+	if (auto s = out.structure())
+		s->close();
+	return out;
+}
+
+struct LGROUP;
+const LGROUP* lgroup;
+Formatter&
+operator<<(Formatter& out, const LGROUP* _) {
+	out.nobreak() << "(";
+	if (auto s = out.structure())
+		s->open();
+	return out;
+}
+
+struct RGROUP;
+const RGROUP* rgroup;
+Formatter&
+operator<<(Formatter& out, const RGROUP* _) {
+	out.nobreak() << ")";
+	if (auto s = out.structure())
+		s->close();
 	return out;
 }
 
@@ -127,33 +246,39 @@ struct TUPLESEP;
 const TUPLESEP* tuple_sep;
 Formatter&
 operator<<(Formatter& out, const TUPLESEP*) {
-	return out << "," << fmt::nbsp;
+	out.nobreak() << ",";
+	if (auto s = out.structure())
+		s->comma();
+	return out << fmt::nbsp;
 }
 
 struct CONS;
 const CONS* cons;
 Formatter&
 operator<<(Formatter& out, const CONS*) {
-	return out << fmt::nbsp << "::" << fmt::nbsp;
+	out.nbsp();
+	out.nobreak() << "::";
+	if (auto s = out.structure())
+		s->cons();
+	return out << fmt::nbsp;
 }
 
 Formatter&
 operator<<(Formatter& out, BOOL b) {
-	out.nobreak() << (b.value ? "true" : "false");
-	return out;
+	return out.write(b.value ? "true" : "false");
 }
 
 Formatter&
 operator<<(Formatter& out, const NUM& n) {
 	auto& [val, is_signed, is_negative, scope] = n;
-	auto& os = out.nobreak();
-	if (is_negative)
-		os << '(';
-	val.print(os, is_signed);
+	llvm::SmallString<32> digits;
+	val.toString(digits, 10, is_signed);
 	if (is_negative)
-		os << ')';
+		out << lgroup << digits.str() << rgroup;
+	else
+		out << digits.str();
 	if (scope)
-		os << '%' << scope;
+		out.scope(scope);
 	return out;
 }
 
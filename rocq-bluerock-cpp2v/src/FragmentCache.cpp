@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "FragmentCache.hpp"
+#include "ClangPrinter.hpp"
+#include "CoqPrinter.hpp"
+#include "Formatter.hpp"
+#include "Logging.hpp"
+#include "PrePrint.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "clang/AST/ODRHash.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <optional>
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+/// Whether `decl` is (in) a template specialization, which `ODRHash` skips
+bool
+in_specialization(const Decl& decl) {
+	auto dc = isa<DeclContext>(decl) ? cast<DeclContext>(&decl)
+									 : decl.getDeclContext();
+	for (; dc; dc = dc->getParent()) {
+		if (isa<ClassTemplateSpecializationDecl>(dc))
+			return true;
+		if (auto fd = dyn_cast<FunctionDecl>(dc))
+			if (fd->isFunctionTemplateSpecialization())
+				return true;
+	}
+	return false;
+}
+
+std::optional<unsigned>
+odr_hash(const Decl& decl) {
+	if (decl.isInvalidDecl() || decl.isTemplated() || in_specialization(decl))
+		return std::nullopt;
+	ODRHash hash;
+	if (auto fd = dyn_cast<FunctionDecl>(&decl)) {
+		if (fd->isLateTemplateParsed())
+			return std::nullopt;
+		hash.AddFunctionDecl(fd);
+	} else if (auto rd = dyn_cast<CXXRecordDecl>(&decl)) {
+		if (!rd->isCompleteDefinition())
+			return std::nullopt;
+		hash.AddCXXRecordDecl(rd);
+	} else if (auto ed = dyn_cast<EnumDecl>(&decl)) {
+		if (!ed->isCompleteDefinition())
+			return std::nullopt;
+		hash.AddEnumDecl(ed);
+	} else if (isa<VarDecl>(decl) || isa<TypedefNameDecl>(decl))
+		hash.AddSubDecl(&decl);
+	else
+		return std::nullopt;
+	return hash.CalculateHash();
+}
+
+/*
+The non-local declarations (and tag types) a top-level declaration
+refers to, whose structured names its printed form may mention.
+*/
+class References {
+	SetVector<const NamedDecl*> decls_;
+
+	void add(const NamedDecl* decl) {
+		if (decl && decl->isDefinedOutsideFunctionOrMethod() &&
+			!isa<ParmVarDecl>(decl))
+			decls_.insert(decl);
+	}
+
+	void type(QualType qt) {
+		if (qt.isNull())
+			return;
+		if (auto tt = qt->getAs<TypedefType>())
+			add(tt->getDecl());
+		auto t = qt.getCanonicalType().getTypePtr();
+		for (;;) {
+			if (auto pt = t->getPointeeType(); !pt.isNull())
+				t = pt.getCanonicalType().getTypePtr();
+			else if (auto at = t->getAsArrayTypeUnsafe())
+				t = at->getElementType().getCanonicalType().getTypePtr();
+			else
+				break;
+		}
+		if (auto tag = t->getAsTagDecl())
+			add(tag);
+		else if (auto ft = t->getAs<FunctionProtoType>()) {
+			type(ft->getReturnType());
+			for (auto p : ft->param_types())
+				type(p);
+		}
+	}
+
+	void stmt(const Stmt* s) {
+		if (!s)
+			return;
+		if (auto e = dyn_cast<Expr>(s)) {
+			type(e->getType());
+			if (auto dr = dyn_cast<DeclRefExpr>(e))
+				add(dr->getDecl());
+			else if (auto me = dyn_cast<MemberExpr>(e))
+				add(me->getMemberDecl());
+			else if (auto ce = dyn_cast<CXXConstructExpr>(e))
+				add(ce->getConstructor());
+			else if (auto ne = dyn_cast<CXXNewExpr>(e)) {
+				add(ne->getOperatorNew());
+				add(ne->getOperatorDelete());
+			} else if (auto de = dyn_cast<CXXDeleteExpr>(e))
+				add(de->getOperatorDelete());
+		} else if (auto ds = dyn_cast<DeclStmt>(s)) {
+			for (auto d : ds->decls())
+				if (auto vd = dyn_cast<ValueDecl>(d))
+					type(vd->getType());
+		}
+		for (auto child : s->children())
+			stmt(child);
+	}
+
+public:
+	explicit References(const Decl& decl) {
+		if (auto nd = dyn_cast<NamedDecl>(&decl))
+			add(nd);
+		if (auto fd = dyn_cast<FunctionDecl>(&decl)) {
+			type(fd->getType());
+			if (auto cd = dyn_cast<CXXConstructorDecl>(fd))
+				for (auto init : cd->inits()) {
+					add(init->getMember());
+					if (auto base = init->getBaseClass())
+						type(QualType(base, 0));
+					stmt(init->getInit());
+				}
+			stmt(fd->getBody());
+		} else if (auto rd = dyn_cast<CXXRecordDecl>(&decl)) {
+			for (auto& base : rd->bases())
+				type(base.getType());
+			for (auto field : rd->fields())
+				type(field->getType());
+			for (auto method : rd->methods())
+				add(method);
+		} else if (auto vd = dyn_cast<VarDecl>(&decl)) {
+			type(vd->getType());
+			stmt(vd->getInit());
+		} else if (auto td = dyn_cast<TypedefNameDecl>(&decl))
+			type(td->getUnderlyingType());
+		else if (auto ed = dyn_cast<EnumDecl>(&decl))
+			type(ed->getIntegerType());
+	}
+
+	ArrayRef<const NamedDecl*> decls() const {
+		return decls_.getArrayRef();
+	}
+};
+
+void
+folded(raw_ostream& os, const Stmt* s, ASTContext& ctxt) {
+	if (!s)
+		return;
+	if (auto cs = dyn_cast<CaseStmt>(s)) {
+		os << cs->getLHS()->EvaluateKnownConstInt(ctxt) << ' ';
+		if (auto rhs = cs->getRHS())
+			os << rhs->EvaluateKnownConstInt(ctxt) << ' ';
+	} else if (auto sl = dyn_cast<SourceLocExpr>(s)) {
+		auto val = sl->EvaluateInContext(ctxt, nullptr);
+		if (sl->isIntType())
+			os << val.getInt() << ' ';
+		else if (auto base = val.getLValueBase().dyn_cast<const Expr*>())
+			if (auto lit = dyn_cast<StringLiteral>(base))
+				os << lit->getBytes() << '\0';
+	} else if (auto da = dyn_cast<CXXDefaultArgExpr>(s))
+		folded(os, da->getExpr(), ctxt);
+	else if (auto di = dyn_cast<CXXDefaultInitExpr>(s))
+		folded(os, di->getExpr(), ctxt);
+	for (auto child : s->children())
+		folded(os, child, ctxt);
+}
+
+/*
+The values the printer computes from a top-level declaration rather than
+reading them off its source: those of `case` labels and enumerators,
+which may come from constants declared elsewhere, and those of
+`__builtin_LINE` and the like, which depend on where the declaration is.
+*/
+void
+folded(raw_ostream& os, const Decl& decl, ASTContext& ctxt) {
+	if (auto fd = dyn_cast<FunctionDecl>(&decl)) {
+		if (auto cd = dyn_cast<CXXConstructorDecl>(fd))
+			for (auto init : cd->inits())
+				folded(os, init->getInit(), ctxt);
+		folded(os, fd->getBody(), ctxt);
+	} else if (auto rd = dyn_cast<CXXRecordDecl>(&decl)) {
+		for (auto field : rd->fields())
+			folded(os, field->getInClassInitializer(), ctxt);
+	} else if (auto vd = dyn_cast<VarDecl>(&decl))
+		folded(os, vd->getInit(), ctxt);
+	else if (auto ed = dyn_cast<EnumDecl>(&decl))
+		for (auto ec : ed->enumerators())
+			os << ec->getInitVal() << ' ';
+}
+
+void
+layout(raw_ostream& os, const Decl& decl, ASTContext& ctxt) {
+	auto rd = dyn_cast<CXXRecordDecl>(&decl);
+	if (!rd || !rd->isCompleteDefinition())
+		return;
+	auto& layout = ctxt.getASTRecordLayout(rd);
+	os << layout.getSize().getQuantity() << ' '
+	   << layout.getAlignment().getQuantity();
+	for (unsigned i = 0; i < layout.getFieldCount(); ++i)
+		os << ' ' << layout.getFieldOffset(i);
+	for (auto& base : rd->bases())
+		if (auto brd = base.getType()->getAsCXXRecordDecl();
+			brd && !base.isVirtual())
+			os << ' ' << layout.getBaseClassOffset(brd).getQuantity();
+}
+}
+
+std::vector<FragmentCache::Key>
+FragmentCache::keys(ArrayRef<const Decl*> decls, ClangPrinter& cprint,
+					Cache& cache) const {
+	auto& ctxt = cprint.getContext();
+	auto& sources = ctxt.getSourceManager();
+
+	std::vector<Key> keys;
+	for (auto decl : decls) {
+		auto odr = odr_hash(*decl);
+		if (!odr) {
+			keys.push_back(NONE);
+			continue;
+		}
+
+		std::string bytes;
+		{
+			raw_string_ostream os{bytes};
+			os << options_ << '\0' << *odr << '\0';
+
+			// `ODRHash` ignores (e.g.) the spelling of literals
+			bool invalid = false;
+			auto text = Lexer::getSourceText(
+				CharSourceRange::getTokenRange(decl->getSourceRange()),
+				sources, ctxt.getLangOpts(), &invalid);
+			if (!invalid)
+				os << text;
+			os << '\0';
+
+			layout(os, *decl, ctxt);
+			os << '\0';
+
+			folded(os, *decl, ctxt);
+			os << '\0';
+
+			fmt::Formatter fmt{os};
+			CoqPrinter print{fmt, /*templates*/ false,
+							 /*structured_keys*/ true, cache};
+			for (auto nd : References(*decl).decls()) {
+				cprint.withDecl(nd).printName(print, *nd);
+				os << '\0';
+			}
+		}
+		auto key = xxHash64(bytes);
+		keys.push_back(key == NONE ? NONE + 1 : key);
+	}
+	return keys;
+}
+
+std::string
+FragmentCache::path(Key key) const {
+	SmallString<128> path{dir_};
+	sys::path::append(path, utohexstr(key));
+	return path.str().str();
+}
+
+/*
+A fragment file holds `0` or `1` (for `cons`), the sharing names the
+fragment mentions (separated by spaces) and a newline, then the bytes.
+*/
+bool
+FragmentCache::lookup(Key key, std::string& bytes, bool& cons,
+					  Cache::Refs& refs) const {
+	if (key == NONE)
+		return false;
+	auto buffer = MemoryBuffer::getFile(path(key));
+	if (!buffer)
+		return false;
+	auto data = (*buffer)->getBuffer();
+	if (data.empty() || (data[0] != '0' && data[0] != '1'))
+		return false;
+	cons = data[0] == '1';
+	auto [names, rest] = data.drop_front().split('\n');
+	if (rest.data() == nullptr)
+		return false;
+	refs.clear();
+	SmallVector<StringRef, 16> words;
+	names.split(words, ' ', -1, /*KeepEmpty*/ false);
+	for (auto word : words) {
+		Cache::Ref ref{word[0], 0};
+		if ((ref.prefix != Cache::TYPE_PREFIX &&
+			 ref.prefix != Cache::NAME_PREFIX) ||
+			word.drop_front().getAsInteger(10, ref.n))
+			return false;
+		refs.push_back(ref);
+	}
+	bytes = rest.str();
+	return true;
+}
+
+void
+FragmentCache::store(Key key, StringRef bytes, bool cons,
+					 ArrayRef<Cache::Ref> refs) const {
+	if (key == NONE)
+		return;
+	if (auto err = sys::fs::create_directories(dir_)) {
+		logging::debug() << "fragment cache: cannot create " << dir_ << ": "
+						 << err.message() << "\n";
+		return;
+	}
+	// `writeToOutput` renames a temporary file into place, so concurrent
+	// readers and writers see whole fragments.
+	if (auto err = writeToOutput(path(key), [&](raw_ostream& os) {
+			os << (cons ? '1' : '0');
+			for (auto& ref : refs)
+				os << ' ' << ref.prefix << ref.n;
+			os << '\n' << bytes;
+			return Error::success();
+		}))
+		logging::debug() << "fragment cache: " << toString(std::move(err))
+						 << "\n";
+}
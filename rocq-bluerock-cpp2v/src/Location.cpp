@@ -17,6 +17,8 @@ namespace structured {
 
 void
 locfree_warn(const Decl& decl, const ASTContext& context, StringRef msg) {
+	if (!logging::enabled(logging::UNSUPPORTED))
+		return;
 	auto& os = logging::unsupported();
 	auto src = decl.getBeginLoc();
 	if (src.isValid()) {
@@ -30,7 +32,8 @@ locfree_warn(const Decl& decl, const ASTContext& context, StringRef msg) {
 			os, context.getPrintingPolicy(), true);
 	}
 	os << "): warning: " << msg << '\n';
-	decl.dump(logging::debug());
+	if (logging::enabled(logging::VERBOSER))
+		decl.dump(logging::debug());
 }
 
 } // namespace structured
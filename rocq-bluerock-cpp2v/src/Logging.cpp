@@ -7,12 +7,19 @@
 #include <llvm/Support/raw_ostream.h>
 
 namespace logging {
-static Level log_level = Level::NONE;
+thread_local Level detail::log_level = Level::NONE;
+thread_local llvm::raw_ostream* detail::log_stream = nullptr;
+thread_local bool detail::failed = false;
+
+llvm::raw_ostream&
+stream() {
+	return detail::log_stream ? *detail::log_stream : llvm::errs();
+}
 
 llvm::raw_ostream&
 log(Level level) {
-	if (level <= log_level) {
-		return llvm::errs();
+	if (enabled(level)) {
+		return stream();
 	} else {
 		return llvm::nulls();
 	}
@@ -20,11 +27,12 @@ log(Level level) {
 
 void
 set_level(Level level) {
-	log_level = level;
+	detail::log_level = level;
 }
 
 [[noreturn]] void
 die() {
+	stream().flush();
 	llvm::outs().flush();
 	llvm::errs().flush();
 	exit(1);
@@ -14,16 +14,20 @@
 #include "Logging.hpp"
 #include "SpecCollector.hpp"
 #include "clang/Basic/Builtins.h"
+#include "clang/Basic/Module.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Sema/Sema.h"
-#include <set>
+#include "llvm/ADT/DenseSet.h"
 
 using namespace clang;
 
 static void
-unsupported_decl(raw_ostream &os, const Decl *decl, const ASTContext &context) {
-	os << loc::prefix(loc::of(decl), context)
-	   << "warning: ModuleBuilder dropping unsupported declaration\n";
+unsupported_decl(logging::Level level, const Decl *decl,
+				 const ASTContext &context) {
+	logging::with(level, [&](raw_ostream &os) {
+		os << loc::prefix(loc::of(decl), context)
+		   << "warning: ModuleBuilder dropping unsupported declaration\n";
+	});
 }
 
 using Flags = ::Module::Flags;
@@ -37,7 +41,7 @@ private:
 	const bool templates_;
 	SpecCollector &specs_;
 	clang::ASTContext *const context_;
-	std::set<int64_t> visited_;
+	llvm::DenseSet<const Decl *> visited_;
 
 	const ASTContext &getContext() const {
 		return *context_;
@@ -72,14 +76,12 @@ public:
 		  context_(context) {}
 
 	void Visit(const Decl *d, Flags flags) {
-		if (visited_.find(d->getID()) == visited_.end()) {
-			visited_.insert(d->getID());
+		if (visited_.insert(d).second)
 			Visitor::Visit(d, flags);
-		}
 	}
 
 	void VisitDecl(const Decl *d, Flags) {
-		unsupported_decl(logging::debug(), d, getContext());
+		unsupported_decl(logging::VERBOSER, d, getContext());
 	}
 
 #define IGNORE(D)                                                              \
@@ -113,7 +115,7 @@ public:
 	}
 
 	void VisitTypeDecl(const TypeDecl *type, Flags) {
-		unsupported_decl(logging::verbose(), type, getContext());
+		unsupported_decl(logging::VERBOSE, type, getContext());
 	}
 
 	static bool isCanonical(const TypedefNameDecl *decl) {
@@ -191,10 +193,11 @@ public:
 		// time being we fix this within Coq by de-duplicating the definition.
 		auto debug = [=](const char *info) {
 #ifdef DEBUG
-			llvm::errs() << info << ": ";
+			auto &os = logging::stream();
+			os << info << ": ";
 			decl->getNameForDiagnostic(
-				llvm::errs(), PrintingPolicy(context_->getLangOpts()), true);
-			llvm::errs() << ' ' << (void *)decl->getCanonicalDecl() << "\n";
+				os, PrintingPolicy(context_->getLangOpts()), true);
+			os << ' ' << (void *)decl->getCanonicalDecl() << "\n";
 #endif
 		};
 
@@ -202,9 +205,9 @@ public:
 		auto defn = decl->getDefinition();
 		if (defn == decl) {
 			debug("defn == decl");
-			if (auto c = context_->getRawCommentForDeclNoCache(decl)) {
-				this->specs_.add_specification(decl, c, *context_);
-			}
+			if (specs_.enabled())
+				if (auto c = context_->getRawCommentForDeclNoCache(decl))
+					this->specs_.add_specification(decl, c);
 
 			auto what = go(decl, flags, true);
 			if (what >= Filter::What::DEFINITION) {
@@ -302,7 +305,7 @@ build_module(clang::TranslationUnitDecl *tu, ::Module &mod, Filter &filter,
 }
 
 void ::Module::add_assert(const clang::StaticAssertDecl &d) {
-	asserts_.push_back(&d);
+	asserts_.push_back(&d, arena_);
 }
 
 using DeclList = ::Module::DeclList;
@@ -313,13 +316,13 @@ void ::Module::add_decl(StringRef indef, DeclList &decls, DeclList &tdecls,
 		if (trace_) {
 			auto loc = loc::of(decl);
 			if (loc::can_trace(loc)) {
-				auto &os = llvm::errs();
+				auto &os = logging::stream();
 				auto &context = decl.getASTContext();
 				os << "[ModuleBuilder] " << indef << intemp << " "
 				   << loc::trace(loc, context) << "\n";
 			}
 		}
-		list.push_back(&decl);
+		list.push_back(&decl, arena_);
 	};
 	if (flags.in_template) {
 		save("1", tdecls);
@@ -331,10 +334,31 @@ void ::Module::add_decl(StringRef indef, DeclList &decls, DeclList &tdecls,
 	}
 }
 
+/// The top-level Clang module `d` was imported from (if any)
+static const clang::Module *
+imported_module(const NamedDecl &d) {
+	auto m = d.getImportedOwningModule();
+	return m ? m->getTopLevelModule() : nullptr;
+}
+
 void ::Module::add_definition(const clang::NamedDecl &d, Flags flags) {
+	if (split_imports_ && flags.none())
+		if (auto m = imported_module(d)) {
+			auto &import = imports_[m->getFullModuleName()];
+			import.module = m;
+			import.definitions.push_back(&d, arena_);
+			return;
+		}
 	add_decl("1", definitions_, template_definitions_, d, flags);
 }
 
 void ::Module::add_declaration(const clang::NamedDecl &d, Flags flags) {
+	if (split_imports_ && flags.none())
+		if (auto m = imported_module(d)) {
+			auto &import = imports_[m->getFullModuleName()];
+			import.module = m;
+			import.declarations.push_back(&d, arena_);
+			return;
+		}
 	add_decl("0", declarations_, template_declarations_, d, flags);
 }
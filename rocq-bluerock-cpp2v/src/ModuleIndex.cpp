@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "ModuleIndex.hpp"
+#include "Logging.hpp"
+#include "PrePrint.hpp"
+#include "clang/AST/Decl.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// The sharing names of `refs`, in order of first mention
+static std::vector<std::string>
+deps(llvm::ArrayRef<Cache::Ref> refs) {
+	std::vector<std::string> result;
+	llvm::StringSet<> seen;
+	for (auto& ref : refs) {
+		auto name = ref.prefix + std::to_string(ref.n);
+		if (seen.insert(name).second)
+			result.push_back(std::move(name));
+	}
+	return result;
+}
+
+void
+ModuleIndex::shared(std::string name, std::uint64_t begin, std::uint64_t end,
+					llvm::ArrayRef<Cache::Ref> refs) {
+	shared_.push_back({std::move(name), "", begin, end, deps(refs), 0});
+}
+
+void
+ModuleIndex::decl(const clang::Decl* decl, std::uint64_t begin,
+				  std::uint64_t end, llvm::ArrayRef<Cache::Ref> refs,
+				  std::uint64_t instructions) {
+	std::string name;
+	if (auto nd = llvm::dyn_cast<clang::NamedDecl>(decl))
+		name = nd->getQualifiedNameAsString();
+	decls_.push_back({std::move(name), key_(decl), begin, end, deps(refs),
+					  instructions});
+}
+
+void
+ModuleIndex::write(llvm::StringRef path, llvm::StringRef module_file,
+				   bool big_endian) const {
+	llvm::SmallString<128> module{module_file};
+	if (auto err = llvm::sys::fs::make_absolute(module))
+		logging::stream() << module_file << ": " << err.message() << "\n";
+
+	std::error_code err;
+	llvm::raw_fd_ostream os{path, err};
+	if (err) {
+		logging::stream() << path << ": " << err.message() << "\n";
+		return;
+	}
+	llvm::json::OStream json{os, 1};
+	auto range = [&](std::uint64_t begin, std::uint64_t end) {
+		json.attributeArray("range", [&] {
+			json.value(begin);
+			json.value(end);
+		});
+	};
+	auto entries = [&](llvm::StringRef what, const std::vector<Entry>& list) {
+		json.attributeArray(what, [&] {
+			for (auto& e : list)
+				json.object([&] {
+					json.attribute("name", e.name);
+					if (!e.key.empty())
+						json.attribute("key", e.key);
+					range(e.begin, e.end);
+					json.attributeArray("deps", [&] {
+						for (auto& dep : e.deps)
+							json.value(dep);
+					});
+				});
+		});
+	};
+	json.object([&] {
+		json.attribute("module", module.str());
+		json.attribute("endian", big_endian ? "Big" : "Little");
+		json.attributeArray("header", [&] {
+			json.value(0);
+			json.value(header_);
+		});
+		entries("shared", shared_);
+		entries("decls", decls_);
+	});
+	os << "\n";
+}
+
+void
+ModuleIndex::write_costs(llvm::StringRef path, llvm::StringRef module_file,
+						 const Totals& totals) const {
+	auto buffer = llvm::MemoryBuffer::getFile(module_file);
+	if (!buffer) {
+		logging::stream() << module_file << ": "
+						  << buffer.getError().message() << "\n";
+		return;
+	}
+	auto file = (*buffer)->getBuffer();
+
+	std::error_code err;
+	llvm::raw_fd_ostream os{path, err};
+	if (err) {
+		logging::stream() << path << ": " << err.message() << "\n";
+		return;
+	}
+	llvm::json::OStream json{os};
+	json.object([&] {
+		json.attribute("i", totals.instructions);
+		json.attribute("t", totals.micros);
+		// cpp2v has no OCaml heap
+		json.attribute("mj", 0);
+		json.attribute("mn", 0);
+		json.attribute("rss", totals.peak_rss);
+		json.attribute("sz", totals.bytes);
+		json.attributeArray("cs", [&] {
+			// The entries are in file order
+			std::uint64_t line = 1, counted = 0;
+			for (auto& e : decls_) {
+				if (file.size() < e.end)
+					break;
+				line += file.slice(counted, e.begin).count('\n');
+				counted = e.begin;
+				json.object([&] {
+					json.attribute("l", line);
+					json.attribute("s", e.begin);
+					json.attribute("e", e.end);
+					json.attribute("p", e.name.empty() ? e.key : e.name);
+					json.attribute("i", e.instructions);
+				});
+			}
+		});
+	});
+	os << "\n";
+}
+
+namespace {
+struct Piece {
+	llvm::StringRef text;
+	std::vector<llvm::StringRef> deps;
+};
+
+/// The text of the `range` of `file`, and the `deps` of `entry`
+bool
+piece(const llvm::json::Object& entry, llvm::StringRef file, Piece& result) {
+	auto range = entry.getArray("range");
+	auto deps = entry.getArray("deps");
+	if (!range || range->size() != 2 || !deps)
+		return false;
+	auto begin = (*range)[0].getAsInteger();
+	auto end = (*range)[1].getAsInteger();
+	if (!begin || !end || *begin < 0 || *end < *begin ||
+		file.size() < std::uint64_t(*end))
+		return false;
+	result.text = file.slice(*begin, *end);
+	for (auto& dep : *deps)
+		if (auto name = dep.getAsString())
+			result.deps.push_back(*name);
+	return true;
+}
+}
+
+bool
+extract(llvm::StringRef index, llvm::ArrayRef<std::string> names,
+		llvm::raw_ostream& out) {
+	auto fail = [&](llvm::StringRef path, const llvm::Twine& why) {
+		logging::stream() << path << ": " << why << "\n";
+		return false;
+	};
+
+	auto index_buffer = llvm::MemoryBuffer::getFile(index);
+	if (!index_buffer)
+		return fail(index, index_buffer.getError().message());
+	auto json = llvm::json::parse((*index_buffer)->getBuffer());
+	if (!json)
+		return fail(index, toString(json.takeError()));
+	auto root = json->getAsObject();
+	if (!root)
+		return fail(index, "not a module index");
+	auto module = root->getString("module");
+	auto endian = root->getString("endian");
+	auto header = root->getArray("header");
+	auto shared = root->getArray("shared");
+	auto decls = root->getArray("decls");
+	if (!module || !endian || !header || header->size() != 2 || !shared ||
+		!decls)
+		return fail(index, "not a module index");
+
+	auto module_buffer = llvm::MemoryBuffer::getFile(*module);
+	if (!module_buffer)
+		return fail(*module, module_buffer.getError().message());
+	auto file = (*module_buffer)->getBuffer();
+	auto header_end = (*header)[1].getAsInteger();
+	if (!header_end || file.size() < std::uint64_t(*header_end))
+		return fail(index, "out of date");
+
+	// The declarations asked for, in file order
+	std::vector<Piece> selected;
+	llvm::StringSet<> found;
+	for (auto& value : *decls) {
+		auto entry = value.getAsObject();
+		if (!entry)
+			return fail(index, "not a module index");
+		auto wanted = [&](llvm::StringRef field) {
+			auto n = entry->getString(field);
+			if (!n || !llvm::is_contained(names, *n))
+				return false;
+			found.insert(*n);
+			return true;
+		};
+		auto by_name = wanted("name");
+		auto by_key = wanted("key");
+		if (!by_name && !by_key)
+			continue;
+		Piece p;
+		if (!piece(*entry, file, p))
+			return fail(index, "out of date");
+		selected.push_back(std::move(p));
+	}
+	for (auto& name : names)
+		if (!found.count(name))
+			return fail(index, "no declaration named " + name);
+
+	// The sharing definitions they need, directly or not
+	llvm::StringMap<Piece> definitions;
+	std::vector<llvm::StringRef> order;
+	for (auto& value : *shared) {
+		auto entry = value.getAsObject();
+		if (!entry)
+			return fail(index, "not a module index");
+		auto name = entry->getString("name");
+		Piece p;
+		if (!name || !piece(*entry, file, p))
+			return fail(index, "out of date");
+		order.push_back(*name);
+		definitions[*name] = std::move(p);
+	}
+	llvm::StringSet<> needed;
+	std::vector<llvm::StringRef> todo;
+	for (auto& p : selected)
+		todo.insert(todo.end(), p.deps.begin(), p.deps.end());
+	while (!todo.empty()) {
+		auto name = todo.back();
+		todo.pop_back();
+		auto it = definitions.find(name);
+		if (it == definitions.end() || !needed.insert(name).second)
+			continue;
+		todo.insert(todo.end(), it->second.deps.begin(),
+					it->second.deps.end());
+	}
+
+	out << file.take_front(*header_end);
+	for (auto name : order)
+		if (needed.count(name))
+			out << definitions[name].text.trim() << "\n";
+	out << "\nDefinition module : translation_unit :=\n"
+		<< "  translation_unit.check\n  (";
+	for (auto& p : selected)
+		out << p.text.trim() << " ::\n   ";
+	out << "nil) " << *endian << ".\n";
+	return true;
+}
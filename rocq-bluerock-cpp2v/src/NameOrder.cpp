@@ -0,0 +1,802 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "NameOrder.hpp"
+#include "Binary.hpp"
+#include "ClangPrinter.hpp"
+#include "CoqPrinter.hpp"
+#include "Formatter.hpp"
+#include "Logging.hpp"
+#include "PrePrint.hpp"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <climits>
+#include <optional>
+
+using namespace clang;
+using namespace llvm;
+
+namespace name_order {
+namespace {
+
+/*
+The constructors `compareN` (see `bedrock.lang.cpp.syntax.compare`)
+meets in names, by inductive type and as `cpp2v` prints them, in the
+order `compareN` puts them: their order of declaration, except for
+`bool` (`Bool.compare`). `compareN` compares the constructors of a type
+by this order, and then their arguments from left to right.
+*/
+const StringMap<unsigned>&
+positions() {
+	static const auto positions = [] {
+		std::initializer_list<std::initializer_list<StringRef>> types = {
+			// name'
+			{"Ninst", "Nglobal", "Ndependent", "Nscoped", "Nunsupported"},
+			// atomic_name_
+			{"Nid", "Nfunction", "Nanon", "Nanonymous", "Nfirst_decl",
+			 "Nfirst_child", "Nunsupported_atomic"},
+			// function_name_
+			{"Nf", "Nctor", "Ndtor", "Nop", "Nop_conv", "Nop_lit",
+			 "Nunsupported_function"},
+			// function_qualifiers.t
+			{"function_qualifiers.N", "function_qualifiers.Nl",
+			 "function_qualifiers.Nr", "function_qualifiers.Nc",
+			 "function_qualifiers.Ncl", "function_qualifiers.Ncr",
+			 "function_qualifiers.Nv", "function_qualifiers.Nvl",
+			 "function_qualifiers.Nvr", "function_qualifiers.Ncv",
+			 "function_qualifiers.Ncvl", "function_qualifiers.Ncvr"},
+			// OverloadableOperator
+			{"OOTilde",
+			 "OOExclaim",
+			 "OOPlusPlus",
+			 "OOMinusMinus",
+			 "OOStar",
+			 "OOPlus",
+			 "OOMinus",
+			 "OOSlash",
+			 "OOPercent",
+			 "OOCaret",
+			 "OOAmp",
+			 "OOPipe",
+			 "OOEqual",
+			 "OOLessLess",
+			 "OOGreaterGreater",
+			 "OOPlusEqual",
+			 "OOMinusEqual",
+			 "OOStarEqual",
+			 "OOSlashEqual",
+			 "OOPercentEqual",
+			 "OOCaretEqual",
+			 "OOAmpEqual",
+			 "OOPipeEqual",
+			 "OOLessLessEqual",
+			 "OOGreaterGreaterEqual",
+			 "OOEqualEqual",
+			 "OOExclaimEqual",
+			 "OOLess",
+			 "OOGreater",
+			 "OOLessEqual",
+			 "OOGreaterEqual",
+			 "OOSpaceship",
+			 "OOComma",
+			 "OOArrowStar",
+			 "OOArrow",
+			 "OOSubscript",
+			 "OOAmpAmp",
+			 "OOPipePipe",
+			 "OONew",
+			 "OODelete",
+			 "OOCall",
+			 "OOCoawait"},
+			// temp_arg'
+			{"Atype", "Avalue", "Apack_expansion", "Atemplate",
+			 "Aunsupported"},
+			// type'
+			{"Tparam",
+			 "Tresult_param",
+			 "Tresult_global",
+			 "Tresult_unop",
+			 "Tresult_binop",
+			 "Tresult_call",
+			 "Tresult_member_call",
+			 "Tresult_parenlist",
+			 "Tresult_member",
+			 "Tptr",
+			 "Tref",
+			 "Trv_ref",
+			 "Tnum",
+			 "Tchar_",
+			 "Tvoid",
+			 "Tarray",
+			 "Tincomplete_array",
+			 "Tvariable_array",
+			 "Tnamed",
+			 "Tenum",
+			 "Tfunction",
+			 "Tbool",
+			 "Tmember_pointer",
+			 "Tfloat_",
+			 "Tqualified",
+			 "Tnullptr",
+			 "Tarch",
+			 "Tdecltype",
+			 "Texprtype",
+			 "Tunsupported"},
+			// Expr'
+			{"Eparam",
+			 "Eunresolved_global",
+			 "Eunresolved_unop",
+			 "Eunresolved_binop",
+			 "Eunresolved_call",
+			 "Eunresolved_member_call",
+			 "Eunresolved_parenlist",
+			 "Eunresolved_member",
+			 "Evar",
+			 "Eenum_const",
+			 "Eglobal",
+			 "Eglobal_member",
+			 "Echar",
+			 "Estring",
+			 "Eint",
+			 "Ebool",
+			 "Eunop",
+			 "Ebinop",
+			 "Ederef",
+			 "Eaddrof",
+			 "Eassign",
+			 "Eassign_op",
+			 "Epreinc",
+			 "Epostinc",
+			 "Epredec",
+			 "Epostdec",
+			 "Eseqand",
+			 "Eseqor",
+			 "Ecomma",
+			 "Ecall",
+			 "Eexplicit_cast",
+			 "Ecast",
+			 "Emember",
+			 "Emember_ignore",
+			 "Emember_call",
+			 "Eoperator_call",
+			 "Esubscript",
+			 "Esizeof",
+			 "Ealignof",
+			 "Eoffsetof",
+			 "Econstructor",
+			 "Elambda",
+			 "Eimplicit",
+			 "Eimplicit_init",
+			 "Eif",
+			 "Eif2",
+			 "Ethis",
+			 "Enull",
+			 "Einitlist",
+			 "Einitlist_union",
+			 "Enew",
+			 "Edelete",
+			 "Eandclean",
+			 "Ematerialize_temp",
+			 "Eatomic",
+			 "Estmt",
+			 "Eva_arg",
+			 "Epseudo_destructor",
+			 "Earrayloop_init",
+			 "Earrayloop_index",
+			 "Eopaque_ref",
+			 "Eunsupported"},
+			// Stmt'
+			{"Sseq", "Sdecl", "Sif", "Sif_consteval", "Swhile", "Sfor", "Sdo",
+			 "Sswitch", "Scase", "Sdefault", "Sbreak", "Scontinue", "Sreturn",
+			 "Sexpr", "Sattr", "Sasm", "Slabeled", "Sgoto", "Sunsupported"},
+			// VarDecl'
+			{"Dvar", "Ddecompose", "Dinit"},
+			// BindingDecl'
+			{"Bvar", "Bbind"},
+			// Cast'
+			{"Cdependent",		"Cbitcast",		   "Clvaluebitcast",
+			 "Cl2r",			"Cl2r_bitcast",	   "Cnoop",
+			 "Carray2ptr",		"Cfun2ptr",		   "Cint2ptr",
+			 "Cptr2int",		"Cptr2bool",	   "Cintegral",
+			 "Cint2bool",		"Cfloat2int",	   "Cint2float",
+			 "Cfloat",			"Cnull2ptr",	   "Cnull2memberptr",
+			 "Cbuiltin2fun",	"C2void",		   "Cctor",
+			 "Cuser",			"Cdynamic",		   "Cderived2base",
+			 "Cbase2derived",	"Cunsupported"},
+			// The types of the arguments of these constructors
+			{"int_rank.Ichar", "int_rank.Ishort", "int_rank.Iint",
+			 "int_rank.Ilong", "int_rank.Ilonglong", "int_rank.I128"},
+			{"Signed", "Unsigned"},
+			{"char_type.Cchar", "char_type.Cwchar", "char_type.C8",
+			 "char_type.C16", "char_type.C32"},
+			{"float_type.Ffloat16", "float_type.Ffloat", "float_type.Fdouble",
+			 "float_type.Flongdouble", "float_type.Ffloat128"},
+			{"QCV", "QC", "QV", "QM"},
+			{"CC_C", "CC_MsAbi", "CC_RegCall"},
+			{"Ar_Definite", "Ar_Variadic"},
+			{"FunctionType"},
+			{"Lvalue", "Prvalue", "Xvalue"},
+			{"Uminus", "Uplus", "Unot", "Ubnot", "Uunsupported"},
+			{"Badd", "Band", "Bcmp", "Bdiv", "Beq", "Bge", "Bgt", "Ble", "Blt",
+			 "Bmul", "Bneq", "Bor", "Bmod", "Bshl", "Bshr", "Bsub", "Bxor",
+			 "Bdotp", "Bdotip", "Bunsupported"},
+			{"Runop", "Rpreinc", "Rpredec", "Rpostinc", "Rpostdec", "Rstar",
+			 "Rarrow"},
+			{"Rbinop", "Rassign", "Rassign_op", "Rsubscript"},
+			{"AO__atomic_load",
+			 "AO__atomic_load_n",
+			 "AO__atomic_store",
+			 "AO__atomic_store_n",
+			 "AO__atomic_compare_exchange",
+			 "AO__atomic_compare_exchange_n",
+			 "AO__atomic_exchange",
+			 "AO__atomic_exchange_n",
+			 "AO__atomic_fetch_add",
+			 "AO__atomic_fetch_sub",
+			 "AO__atomic_fetch_and",
+			 "AO__atomic_fetch_or",
+			 "AO__atomic_fetch_xor",
+			 "AO__atomic_fetch_nand",
+			 "AO__atomic_add_fetch",
+			 "AO__atomic_sub_fetch",
+			 "AO__atomic_and_fetch",
+			 "AO__atomic_or_fetch",
+			 "AO__atomic_xor_fetch",
+			 "AO__atomic_nand_fetch"},
+			{"Virtual", "Direct"},
+			{"operator_impl.Func", "operator_impl.MFunc"},
+			{"new_form.Allocating", "new_form.NonAllocating"},
+			{"cast_style.functional", "cast_style.c", "cast_style.static",
+			 "cast_style.dynamic", "cast_style.reinterpret",
+			 "cast_style.const"},
+			{"Exact", "Range"},
+			{"Some", "None"},
+			{"inl", "inr"},
+			{"nil", "cons"},
+			{"pair"},
+			{"false", "true"},
+		};
+		StringMap<unsigned> positions;
+		for (auto& ctors : types) {
+			unsigned i = 0;
+			for (auto ctor : ctors) {
+				auto fresh = positions.try_emplace(ctor, i++).second;
+				always_assert(fresh && "constructor of two types");
+			}
+		}
+		return positions;
+	}();
+	return positions;
+}
+
+/// `pos` of the terms `compareN` would not see (see `Terms::reduce`)
+constexpr unsigned UNKNOWN = UINT_MAX;
+
+int
+compare_numbers(StringRef x, StringRef y) {
+	bool nx = x.consume_front("-"), ny = y.consume_front("-");
+	if (nx != ny)
+		return nx ? -1 : 1;
+	x = x.ltrim('0');
+	y = y.ltrim('0');
+	int c = x.size() != y.size() ? (x.size() < y.size() ? -1 : 1)
+								 : x.compare(y);
+	return nx ? -c : c;
+}
+
+/*
+The values of printed names, as Coq computes them: `reduce` unfolds the
+notations and parser definitions (see `bedrock.lang.cpp.parser` and,
+with `templates`, `bedrock.lang.cpp.mparser`) that `cpp2v` prints in
+names, and `compare` is `compareN` on the results.
+
+The few definitions that need the types of expressions (those of
+`mparser` when `cpp2v` prints no type) are kept as they are printed, as
+are any terms unknown here. They compare after the constructors of their
+type, by name and then arguments.
+*/
+class Terms : public binary::Builder {
+	enum Kind : unsigned char { CTOR, STR, NUM };
+	struct Term {
+		Kind kind;
+		unsigned pos;	 // of a constructor (see `positions`)
+		StringRef text;	 // the constructor, string or number
+		unsigned first;	 // the arguments of a constructor, in `args_`
+		unsigned size;
+	};
+	enum Qualifiers : unsigned { QM = 0, QC = 1, QV = 2, QCV = QC | QV };
+
+	const bool templates_;
+	BumpPtrAllocator alloc_;
+	StringSaver saver_{alloc_};
+	std::vector<Term> terms_;
+	std::vector<unsigned> args_;
+
+	unsigned add(Kind kind, StringRef text, ArrayRef<unsigned> args = {}) {
+		unsigned pos = UNKNOWN;
+		if (kind == CTOR) {
+			auto it = positions().find(text);
+			if (it != positions().end())
+				pos = it->second;
+		}
+		terms_.push_back(Term{kind, pos, saver_.save(text),
+							  unsigned(args_.size()), unsigned(args.size())});
+		args_.insert(args_.end(), args.begin(), args.end());
+		return terms_.size() - 1;
+	}
+	unsigned ctor(StringRef ctor, ArrayRef<unsigned> args = {}) {
+		return add(CTOR, ctor, args);
+	}
+
+	ArrayRef<unsigned> view(unsigned t) const {
+		auto& term = terms_[t];
+		return ArrayRef<unsigned>(args_).slice(term.first, term.size);
+	}
+	// A copy, as adding terms moves `args_`
+	SmallVector<unsigned, 4> args(unsigned t) const {
+		auto as = view(t);
+		return {as.begin(), as.end()};
+	}
+	bool is(unsigned t, StringRef ctor, std::size_t arity) const {
+		auto& term = terms_[t];
+		return term.kind == CTOR && term.text == ctor && term.size == arity;
+	}
+
+	unsigned list(ArrayRef<unsigned> elems) {
+		auto l = ctor("nil");
+		for (auto e : llvm::reverse(elems))
+			l = ctor("cons", {e, l});
+		return l;
+	}
+	std::vector<unsigned> elements(unsigned l) const {
+		std::vector<unsigned> elems;
+		for (; is(l, "cons", 2); l = view(l)[1])
+			elems.push_back(view(l)[0]);
+		return elems;
+	}
+
+	unsigned qualifiers(unsigned q) {
+		static constexpr StringRef names[] = {"QM", "QC", "QV", "QCV"};
+		return ctor(names[q]);
+	}
+	static unsigned qualifiers(StringRef q) {
+		return StringSwitch<unsigned>(q)
+			.Case("QC", QC)
+			.Case("QV", QV)
+			.Case("QCV", QCV)
+			.Default(QM);
+	}
+
+	// `tqualified q t`
+	unsigned tqualified(unsigned q, unsigned t) {
+		while (is(t, "Tqualified", 2)) {
+			q |= qualifiers(terms_[view(t)[0]].text);
+			t = view(t)[1];
+		}
+		if (is(t, "Tref", 1) || is(t, "Trv_ref", 1) || q == QM)
+			return t;
+		return ctor("Tqualified", {qualifiers(q), t});
+	}
+
+	// `to_arg_type t`
+	unsigned to_arg_type(unsigned t) {
+		while (is(t, "Tqualified", 2))
+			t = view(t)[1];
+		if (is(t, "Tarray", 2) || is(t, "Tvariable_array", 2) ||
+			is(t, "Tincomplete_array", 1))
+			return ctor("Tptr", {view(t)[0]});
+		return t;
+	}
+
+	// `normalize_type' cv t`
+	unsigned normalize(unsigned cv, unsigned t) {
+		auto text = terms_[t].text;
+		auto as = args(t);
+		auto with = [&](unsigned arg, unsigned to) {
+			auto copy = as;
+			copy[arg] = to;
+			return ctor(text, copy);
+		};
+		if (is(t, "Tptr", 1))
+			return tqualified(cv, ctor("Tptr", {normalize(QM, as[0])}));
+		if (is(t, "Tref", 1) || is(t, "Trv_ref", 1))
+			return with(0, normalize(QM, as[0]));
+		if (is(t, "Tarray", 2) || is(t, "Tincomplete_array", 1) ||
+			is(t, "Tvariable_array", 2))
+			return with(0, normalize(cv, as[0]));
+		if (is(t, "Tfunction", 1) && is(as[0], "FunctionType", 4)) {
+			auto ft = args(as[0]);
+			std::vector<unsigned> params;
+			for (auto p : elements(ft[3]))
+				params.push_back(to_arg_type(normalize(QM, p)));
+			auto ret = normalize(QM, ft[2]);
+			return ctor("Tfunction", {ctor("FunctionType", {ft[0], ft[1], ret,
+															list(params)})});
+		}
+		if (is(t, "Tmember_pointer", 2))
+			return with(1, normalize(QM, as[1]));
+		if (is(t, "Tqualified", 2))
+			return normalize(cv | qualifiers(terms_[as[0]].text), as[1]);
+		return tqualified(cv, t);
+	}
+
+	/// `Some t` when `o` is `Some t`
+	std::optional<unsigned> some(unsigned o) const {
+		if (is(o, "Some", 1))
+			return view(o)[0];
+		return std::nullopt;
+	}
+
+	unsigned cast(StringRef style, ArrayRef<unsigned> as) {
+		return ctor("Eexplicit_cast",
+					{ctor(style), as[1], ctor("Ecast", {as[0], as[2]})});
+	}
+
+	unsigned capture(unsigned q, unsigned lambda, unsigned field, unsigned ty) {
+		auto cv = qualifiers(terms_[q].text);
+		auto ptr = ctor("Tptr", {tqualified(cv, ctor("Tnamed", {lambda}))});
+		auto self = ctor("Ethis", {ptr});
+		return ctor("Emember",
+					{ctor("true"), self, field, ctor("false"), ty});
+	}
+
+	/// `head` applied to `as`, evaluated
+	unsigned reduce(StringRef head, ArrayRef<unsigned> as) {
+		auto n = as.size();
+		auto call = [&](StringRef f, std::size_t arity) {
+			return head == f && n == arity;
+		};
+
+		// `bedrock.lang.cpp.parser.type`
+		if (call("Talias", 2) || call("Tunderlying", 2) ||
+			call("Tdecay_type", 2))
+			return as[1];
+		if (call("Tunary_xform", 3))
+			return as[2];
+		if (call("Tfunction", 5))
+			return normalize(QM, ctor("Tfunction", {ctor("FunctionType",
+														 as.drop_front())}));
+		if (call("Qconst", 1) || call("Qvolatile", 1) ||
+			call("Qconst_volatile", 1)) {
+			auto q = head == "Qconst" ? QC : head == "Qvolatile" ? QV : QCV;
+			return templates_ ? ctor("Tqualified", {qualifiers(q), as[0]})
+							  : tqualified(q, as[0]);
+		}
+
+		// `bedrock.lang.cpp.parser.name`
+		if (call("Nfunction", 3)) {
+			std::vector<unsigned> ts;
+			for (auto t : elements(as[2]))
+				ts.push_back(to_arg_type(normalize(QM, t)));
+			return ctor("Nfunction", {as[0], as[1], list(ts)});
+		}
+		if (call("Nrecord_by_field", 1) || call("Nenum_by_enumerator", 1))
+			return ctor("Nfirst_child", as);
+		if (call("Nby_first_decl", 1))
+			return ctor("Nfirst_decl", as);
+		if (call("Nlocal", 1))
+			return ctor("Nglobal", as);
+		if (call("Ndependent", 1) && is(as[0], "Tnamed", 1))
+			return view(as[0])[0];
+
+		// `bedrock.lang.cpp.parser.expr`
+		if (call("Ecstyle_cast", 3))
+			return cast("cast_style.c", as);
+		if (call("Efunctional_cast", 3) || call("Ebuiltin_bit_cast", 3))
+			return cast("cast_style.functional", as);
+		if (call("Estatic_cast", 3))
+			return cast("cast_style.static", as);
+		if (call("Econst_cast", 3))
+			return cast("cast_style.const", as);
+		if (call("Ereinterpret_cast", 3))
+			return cast("cast_style.reinterpret", as);
+		if (call("Edynamic_cast", 3))
+			return cast("cast_style.dynamic", as);
+		if (call("Eextension", 1) || call("Edefault_init_expr", 1))
+			return as[0];
+		if (call("Esource_loc", 2))
+			return as[1];
+		if (call("Egnu_null", 1))
+			return ctor("Ecast", {ctor("Cptr2int", as), ctor("Enull")});
+		if (call("Ealignof_preferred", 2))
+			return ctor("Eunsupported", {add(STR, "alignof_preferred"), as[1]});
+		if (call("Eoperator_member_call", 6))
+			return ctor("Eoperator_call",
+						{as[0], ctor("operator_impl.MFunc", as.slice(1, 3)),
+						 ctor("cons", {as[4], as[5]})});
+		if (call("Eoperator_call", 4))
+			return ctor("Eoperator_call",
+						{as[0], ctor("operator_impl.Func", as.slice(1, 2)),
+						 as[3]});
+		if (call("Eenum_const_at", 3))
+			return ctor("Ecast", {ctor("Cintegral", {as[2]}),
+								  ctor("Eenum_const", as.take_front(2))});
+		if (call("Ebuiltin", 2))
+			return ctor("Ecast",
+						{ctor("Cbuiltin2fun", {ctor("Tptr", {as[1]})}),
+						 ctor("Eglobal", as)});
+		if (call("Emember", 3)) {
+			auto m = as[2];
+			auto ma = args(m);
+			if (is(m, "Field", 3))
+				return ctor("Emember", {as[0], as[1], ma[0], ma[1], ma[2]});
+			if (is(m, "Enum", 1) && is(ma[0], "Nscoped", 2) &&
+				is(view(ma[0])[1], "Nid", 1)) {
+				auto en = args(ma[0]);
+				auto x = view(en[1])[0];
+				return ctor("Emember_ignore",
+							{as[0], as[1], ctor("Eenum_const", {en[0], x})});
+			}
+			if (is(m, "Static", 2))
+				return ctor("Emember_ignore",
+							{as[0], as[1], ctor("Eglobal", ma)});
+		}
+		if (call("Eunevaluated_var", 2) && terms_[as[0]].kind == STR)
+			return ctor("Eunsupported",
+						{add(STR, "Unevaluated variable: " +
+									  terms_[as[0]].text.str()),
+						 ctor("Tref", {as[1]})});
+		if (call("Ecapture_var", 4))
+			return capture(as[0], as[1], ctor("Nid", {as[2]}), as[3]);
+		if (call("Ecapture_this", 3))
+			return ctor("Ecast",
+						{ctor("Cl2r"),
+						 capture(as[0], as[1], ctor("Nid", {add(STR, ".this")}),
+								 as[2])});
+		if (call("Econcept_specialization", 2)) {
+			if (auto b = some(as[1]))
+				return ctor("Ebool", {*b});
+			return ctor("Eunsupported",
+						{add(STR, "unresolved concept specialization"),
+						 ctor("Tbool")});
+		}
+		if (call("localname.anon", 1) && terms_[as[0]].kind == NUM)
+			return add(STR, "#" + terms_[as[0]].text.str());
+		if (call("BS.string_to_bytes", 1) && terms_[as[0]].kind == STR) {
+			auto s = terms_[as[0]].text;
+			std::vector<unsigned> bytes;
+			for (unsigned char c : s)
+				bytes.push_back(add(NUM, std::to_string(c)));
+			return list(bytes);
+		}
+
+		// `bedrock.lang.cpp.parser.stmt`
+		if (call("Sreturn_val", 1))
+			return ctor("Sreturn", {ctor("Some", as)});
+		if (call("Sforeach", 8)) {
+			std::vector<unsigned> ss;
+			if (auto init = some(as[3]))
+				ss.push_back(*init);
+			ss.insert(ss.end(), as.begin(), as.begin() + 3);
+			ss.push_back(
+				ctor("Sfor", {ctor("None"), as[4], as[5],
+							  ctor("Sseq", {list({as[6], as[7]})})}));
+			return ctor("Sseq", {list(ss)});
+		}
+
+		// `bedrock.lang.cpp.mparser`, which infers the missing types of
+		// some expressions
+		if (templates_) {
+			auto typed = [&](StringRef ctor) -> std::optional<unsigned> {
+				if (auto t = some(as.back())) {
+					SmallVector<unsigned, 4> copy{as.begin(), as.end()};
+					copy.back() = *t;
+					return this->ctor(ctor, copy);
+				}
+				return std::nullopt;
+			};
+			std::optional<unsigned> e;
+			if (call("Eassign", 3) || call("Eassign_op", 4) ||
+				call("Ebinop", 4) || call("Eunop", 3) || call("Epreinc", 2) ||
+				call("Epredec", 2) || call("Epostinc", 2) ||
+				call("Epostdec", 2) || call("Ederef", 2))
+				e = typed(head);
+			else if (call("Eunresolved_member", 3) && is(as[0], "false", 0))
+				e = ctor("Eunresolved_member", as.drop_front());
+			else if (call("Dvar", 3)) {
+				// `set_declared_type`
+				auto init = as[2];
+				auto i = some(init);
+				if (i && is(*i, "Eunresolved_parenlist", 2) &&
+					is(view(*i)[0], "None", 0)) {
+					auto es = view(*i)[1];
+					auto list = ctor("Eunresolved_parenlist",
+									 {ctor("Some", {as[1]}), es});
+					init = ctor("Some", {list});
+				}
+				e = ctor("Dvar", {as[0], as[1], init});
+			}
+			if (e)
+				return *e;
+			if (call("Esubscript", 3) || call("Eassign", 3) ||
+				call("Eassign_op", 4) || call("Ebinop", 4) ||
+				call("Eunop", 3) || call("Epreinc", 2) || call("Epredec", 2) ||
+				call("Epostinc", 2) || call("Epostdec", 2) ||
+				call("Ederef", 2) || call("Eunresolved_member", 3)) {
+				auto t = ctor(head, as);
+				terms_[t].pos = UNKNOWN;
+				return t;
+			}
+		}
+		return ctor(head, as);
+	}
+
+	/// The abbreviations `cpp2v` prints for `head` (e.g. `Tint`)
+	std::optional<unsigned> abbreviation(StringRef head) {
+		auto num = [&](StringRef rank, StringRef sign) {
+			return ctor("Tnum", {ctor(("int_rank." + rank).str()), ctor(sign)});
+		};
+		auto chr = [&](StringRef type) {
+			return ctor("Tchar_", {ctor(("char_type." + type).str())});
+		};
+		auto flt = [&](StringRef type) {
+			return ctor("Tfloat_", {ctor(("float_type." + type).str())});
+		};
+		if (head == "Tschar" || head == "Ti8")
+			return num("Ichar", "Signed");
+		if (head == "Tuchar" || head == "Tu8" || head == "Tbyte")
+			return num("Ichar", "Unsigned");
+		if (head == "Tshort" || head == "Ti16")
+			return num("Ishort", "Signed");
+		if (head == "Tushort" || head == "Tu16")
+			return num("Ishort", "Unsigned");
+		if (head == "Tint" || head == "Ti32")
+			return num("Iint", "Signed");
+		if (head == "Tuint" || head == "Tu32")
+			return num("Iint", "Unsigned");
+		if (head == "Tlong")
+			return num("Ilong", "Signed");
+		if (head == "Tulong" || head == "Tsize_t")
+			return num("Ilong", "Unsigned");
+		if (head == "Tlonglong" || head == "Ti64")
+			return num("Ilonglong", "Signed");
+		if (head == "Tulonglong" || head == "Tu64")
+			return num("Ilonglong", "Unsigned");
+		if (head == "Tint128_t" || head == "Ti128")
+			return num("I128", "Signed");
+		if (head == "Tuint128_t" || head == "Tu128")
+			return num("I128", "Unsigned");
+		if (head == "Tchar")
+			return chr("Cchar");
+		if (head == "Twchar" || head == "Twchar_t")
+			return chr("Cwchar");
+		if (head == "Tchar8" || head == "Tchar8_t")
+			return chr("C8");
+		if (head == "Tchar16" || head == "Tchar16_t")
+			return chr("C16");
+		if (head == "Tchar32" || head == "Tchar32_t")
+			return chr("C32");
+		if (head == "Tfloat16")
+			return flt("Ffloat16");
+		if (head == "Tfloat")
+			return flt("Ffloat");
+		if (head == "Tdouble")
+			return flt("Fdouble");
+		if (head == "Tlongdouble")
+			return flt("Flongdouble");
+		if (head == "Tfloat128")
+			return flt("Ffloat128");
+		if (head == "Sskip")
+			return ctor("Sseq", {ctor("nil")});
+		if (head == "Sreturn_void")
+			return ctor("Sreturn", {ctor("None")});
+		return std::nullopt;
+	}
+
+public:
+	explicit Terms(bool templates) : templates_{templates} {}
+
+	unsigned ref(StringRef ident) override {
+		if (auto t = abbreviation(ident))
+			return *t;
+		return ctor(ident);
+	}
+	unsigned explicit_ref(StringRef ident) override {
+		return ctor(ident);
+	}
+	unsigned str(StringRef s) override {
+		return add(STR, s);
+	}
+	unsigned num(StringRef digits) override {
+		return add(NUM, digits);
+	}
+	unsigned scope(StringRef, unsigned n) override {
+		return n;
+	}
+	unsigned app(unsigned head, ArrayRef<unsigned> as) override {
+		// Names only apply constructors and definitions
+		auto all = args(head);
+		all.append(as.begin(), as.end());
+		return reduce(terms_[head].text, all);
+	}
+	unsigned tuple(ArrayRef<unsigned> elems) override {
+		// `(a, b, c)` is `pair (pair a b) c`, which compares as `a b c`
+		return ctor("pair", elems);
+	}
+	unsigned cons(unsigned head, unsigned tail) override {
+		return ctor("cons", {head, tail});
+	}
+
+	int compare(unsigned a, unsigned b) const {
+		if (a == b)
+			return 0;
+		auto& x = terms_[a];
+		auto& y = terms_[b];
+		if (x.kind != y.kind)
+			return x.kind < y.kind ? -1 : 1;
+		switch (x.kind) {
+		case STR:
+			return x.text.compare(y.text);
+		case NUM:
+			return compare_numbers(x.text, y.text);
+		case CTOR:
+			break;
+		}
+		if (x.pos != y.pos)
+			return x.pos < y.pos ? -1 : 1;
+		if (x.pos == UNKNOWN)
+			if (auto c = x.text.compare(y.text))
+				return c;
+		auto xs = view(a), ys = view(b);
+		for (std::size_t i = 0; i < std::min(xs.size(), ys.size()); ++i)
+			if (auto c = compare(xs[i], ys[i]))
+				return c;
+		return xs.size() == ys.size() ? 0 : (xs.size() < ys.size() ? -1 : 1);
+	}
+};
+}
+
+std::vector<const NamedDecl*>
+sort(const ::Module::DeclList& declarations,
+	 const ::Module::DeclList& definitions, ClangPrinter& cprint,
+	 Cache& cache, bool templates, bool quiet) {
+	DenseSet<const Decl*> seen;
+	std::vector<const NamedDecl*> decls;
+	for (auto decl : definitions) {
+		seen.insert(decl->getCanonicalDecl());
+		decls.push_back(decl);
+	}
+	for (auto decl : declarations)
+		if (seen.insert(decl->getCanonicalDecl()).second)
+			decls.push_back(decl);
+
+	std::optional<logging::Scope> silence;
+	if (quiet)
+		silence.emplace(logging::Settings{logging::NONE, &logging::stream()});
+	Terms terms{templates};
+	std::vector<std::pair<unsigned, const NamedDecl*>> keyed;
+	std::vector<const NamedDecl*> unkeyed;
+	for (auto decl : decls) {
+		binary::Reader reader{terms, logging::VERBOSER};
+		{
+			fmt::Formatter fmt{nulls()};
+			fmt.set_structure(&reader);
+			CoqPrinter print{fmt, templates, /*structured_keys*/ true, cache};
+			cprint.withDecl(decl).printName(print, *decl);
+		}
+		if (auto key = reader.finish())
+			keyed.emplace_back(*key, decl);
+		else
+			unkeyed.push_back(decl);
+	}
+	silence.reset();
+
+	std::stable_sort(keyed.begin(), keyed.end(),
+					 [&](const auto& a, const auto& b) {
+						 return terms.compare(a.first, b.first) < 0;
+					 });
+	decls.clear();
+	for (auto& [_, decl] : keyed)
+		decls.push_back(decl);
+	decls.insert(decls.end(), unkeyed.begin(), unkeyed.end());
+	return decls;
+}
+}
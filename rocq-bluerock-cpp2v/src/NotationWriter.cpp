@@ -16,19 +16,24 @@
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Version.inc"
 #include <algorithm>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
 
-// TODO this should be replaced by something else.
-bool
-print_path(llvm::raw_string_ostream &print, const DeclContext *dc,
-		   bool end = true) {
-	if (dc == nullptr || isa<TranslationUnitDecl>(dc)) {
-		if (end)
-			print << "::";
-		return true;
-	} else {
-		if (not print_path(print, dc->getParent())) {
-			return false;
-		}
+namespace {
+/*
+The paths of declaration contexts, as the names file spells them (e.g.,
+`::ns::C<int>::`), computed once per context: the declarations of a record
+or namespace share the path of their parent.
+*/
+class Paths {
+	std::map<const DeclContext *, std::optional<std::string>> paths_;
+
+	// TODO this should be replaced by something else.
+	static bool print_component(llvm::raw_string_ostream &print,
+								const DeclContext *dc) {
 		if (auto ts = dyn_cast<ClassTemplateSpecializationDecl>(dc)) {
 			print << ts->getNameAsString() << "<";
 			bool first = true;
@@ -58,27 +63,80 @@ print_path(llvm::raw_string_ostream &print, const DeclContext *dc,
 					return false;
 				}
 			}
-			print << (end ? ">::" : ">");
+			print << ">::";
 		} else if (auto td = dyn_cast<TagDecl>(dc)) {
 			if (td->getName() != "") {
-				print << td->getNameAsString() << (end ? "::" : "");
+				print << td->getNameAsString() << "::";
 			} else
 				return false;
 		} else if (auto ns = dyn_cast<NamespaceDecl>(dc)) {
 			if (!ns->isAnonymousNamespace()) {
-				print << ns->getNameAsString() << (end ? "::" : "");
+				print << ns->getNameAsString() << "::";
 			} else
 				return false;
 		} else {
-			using namespace logging;
-			//logging::log() << "unknown declaration while printing path "
-			//               << dc->getDeclKindName() << "\n";
 			return false;
 		}
+		return true;
 	}
-	return true;
+
+public:
+	/// The path of `dc`, ending in `::`, if it has one
+	const std::string *get(const DeclContext *dc) {
+		if (dc == nullptr || isa<TranslationUnitDecl>(dc)) {
+			static const std::string root{"::"};
+			return &root;
+		}
+		if (auto it = paths_.find(dc); it != paths_.end())
+			return it->second ? &*it->second : nullptr;
+
+		std::optional<std::string> path;
+		if (auto parent = get(dc->getParent())) {
+			std::string s{*parent};
+			llvm::raw_string_ostream os{s};
+			if (print_component(os, dc))
+				path = std::move(os.str());
+		}
+		auto &result = paths_[dc] = std::move(path);
+		return result ? &*result : nullptr;
+	}
+};
+
+/*
+The names of the namespaces enclosing `dc`, outermost first. Inline
+namespaces are left out, as users do not spell them (libc++'s
+`std::__1::chrono` is `std::chrono`).
+*/
+std::vector<std::string>
+namespaces(const DeclContext *dc) {
+	std::vector<std::string> result;
+	for (; dc; dc = dc->getParent())
+		if (auto ns = dyn_cast<NamespaceDecl>(dc); ns && !ns->isInline())
+			result.push_back(ns->getNameAsString());
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+/// Split `std::chrono` (or `::std::chrono`) into its components
+std::vector<std::string>
+split_namespace(llvm::StringRef name) {
+	llvm::SmallVector<llvm::StringRef, 4> parts;
+	name.split(parts, "::", -1, /*KeepEmpty*/ false);
+	return {parts.begin(), parts.end()};
 }
 
+/// A Coq module name for namespace `name`
+std::string
+module_name(const std::string &name) {
+	static const std::set<std::string> keywords{
+		"_", "as", "at", "cofix", "else", "end", "exists", "exists2", "fix",
+		"for", "forall", "fun", "if", "IF", "in", "let", "match", "mod",
+		"Prop", "return", "Set", "SProp", "then", "Type", "using", "where",
+		"with"};
+	return keywords.count(name) ? name + "_" : name;
+}
+} // namespace
+
 static inline bool
 starts_with(llvm::StringRef &s, const char *what) {
 #if 19 <= CLANG_VERSION_MAJOR
@@ -89,81 +147,100 @@ starts_with(llvm::StringRef &s, const char *what) {
 }
 
 void
-write_globals(::Module &mod, CoqPrinter &print, ClangPrinter &cprint) {
-	print.output() << "Module _'." << fmt::indent << fmt::line;
+write_globals(::Module &mod, CoqPrinter &print, ClangPrinter &cprint,
+			  const GlobalsFilter &filter) {
+	std::vector<std::vector<std::string>> wanted;
+	for (auto &ns : filter.namespaces)
+		wanted.push_back(split_namespace(ns));
+
+	Paths paths;
+	// The notations printed so far, to skip records declared more than once
+	std::set<std::string> seen;
+	// The notations for the names in each namespace
+	std::map<std::vector<std::string>, std::string> groups;
 
 	auto write_notations = [&](const clang::NamedDecl *def) {
 		if (!def->getIdentifier())
 			return;
-		std::string s_notation;
-		llvm::raw_string_ostream notation{s_notation};
 		llvm::StringRef def_name = def->getName();
 		if (def_name == "__builtin_va_list" || starts_with(def_name, "__SV") ||
 			starts_with(def_name, "__clang_sv"))
 			return;
-		if (const FieldDecl *fd = dyn_cast<FieldDecl>(def)) {
-			if (not print_path(notation, fd->getParent(), true))
+		if (filter.main_file) {
+			auto &sm = def->getASTContext().getSourceManager();
+			if (!sm.isInMainFile(sm.getExpansionLoc(def->getLocation())))
 				return;
+		}
+		auto group = namespaces(def->getDeclContext());
+		if (!wanted.empty() &&
+			std::none_of(wanted.begin(), wanted.end(), [&](auto &ns) {
+				return ns.size() <= group.size() &&
+					   std::equal(ns.begin(), ns.end(), group.begin());
+			}))
+			return;
+
+		llvm::raw_string_ostream os{groups[group]};
+		fmt::Formatter fmt{os};
+		CoqPrinter out(fmt, print.templates(), print.structured_keys(),
+					   print.cache());
+		auto notation = [&](const std::string &name) {
+			if (!seen.insert(name).second)
+				return false;
+			out.output() << "Notation \"'" << name << "'\" :=" << fmt::nbsp;
+			return true;
+		};
 
-			notation << fd->getNameAsString();
-			print.output() << "Notation \"'" << s_notation;
-			print.output() << fd->getNameAsString() << "'\" :=" << fmt::nbsp;
-			cprint.printField(print, fd);
-			print.output() << " (in custom cppglobal at level 0)." << fmt::line;
+		if (const FieldDecl *fd = dyn_cast<FieldDecl>(def)) {
+			auto path = paths.get(fd->getParent());
+			if (!path)
+				return;
+			if (notation(*path + fd->getNameAsString())) {
+				cprint.printField(out, fd);
+				out.output()
+					<< " (in custom cppglobal at level 0)." << fmt::line;
+			}
 		} else if (const RecordDecl *rd = dyn_cast<RecordDecl>(def)) {
-			if (not print_path(notation, rd, false))
+			auto path = paths.get(rd);
+			if (!path)
 				return;
 
 			if (!rd->isAnonymousStructOrUnion() &&
-				rd->getNameAsString() != "") {
-				print.output()
-					<< "Notation \"'" << s_notation << "'\" :=" << fmt::nbsp;
-
-				cprint.printName(print, *rd);
-				print.output()
+				rd->getNameAsString() != "" &&
+				notation(path->substr(0, path->size() - 2))) {
+				cprint.printName(out, *rd);
+				out.output()
 					<< "%bs (in custom cppglobal at level 0)." << fmt::line;
 			}
 
 			for (auto fd : rd->fields()) {
-				if (fd->getName() != "") {
-					print.output() << "Notation \"'" << s_notation << "::";
-					print.output()
-						<< fd->getNameAsString() << "'\" :=" << fmt::nbsp;
-					cprint.printField(print, fd);
-					print.output()
+				if (fd->getName() != "" &&
+					notation(*path + fd->getNameAsString())) {
+					cprint.printField(out, fd);
+					out.output()
 						<< " (in custom cppglobal at level 0)." << fmt::line;
 				}
 			}
 		} else if (isa<FunctionDecl>(def)) {
 			// todo(gmm): skipping due to function overloading
-		} else if (const TypedefDecl *td = dyn_cast<TypedefDecl>(def)) {
+		} else if (const auto *td = dyn_cast<TypedefNameDecl>(def)) {
 			if (td->isTemplated())
 				return;
-			if (not print_path(notation, td->getDeclContext(), true))
+			auto path = paths.get(td->getDeclContext());
+			if (!path)
 				return;
 
-			print.output() << "Notation \"'" << s_notation;
-			print.output() << td->getNameAsString() << "'\" :=" << fmt::nbsp;
-			cprint.printQualType(print, td->getUnderlyingType(), loc::of(td));
-			print.output() << " (only parsing, in custom cppglobal at level 0)."
-						   << fmt::line;
-		} else if (const auto *ta = dyn_cast<TypeAliasDecl>(def)) {
-			if (ta->isTemplated())
-				return;
-			if (not print_path(notation, ta->getDeclContext(), true))
-				return;
-
-			print.output() << "Notation \"'" << s_notation;
-			print.output() << ta->getNameAsString() << "'\" :=" << fmt::nbsp;
-			cprint.printQualType(print, ta->getUnderlyingType(), loc::of(ta));
-			print.output() << " (only parsing, in custom cppglobal at level 0)."
-						   << fmt::line;
+			if (notation(*path + td->getNameAsString())) {
+				cprint.printQualType(out, td->getUnderlyingType(),
+									 loc::of(td));
+				out.output()
+					<< " (only parsing, in custom cppglobal at level 0)."
+					<< fmt::line;
+			}
 		} else if (isa<VarDecl>(def) || isa<EnumDecl>(def) ||
 				   isa<EnumConstantDecl>(def)) {
 		} else {
-			using namespace logging;
-			log(Level::VERBOSE) << "unknown declaration type "
-								<< def->getDeclKindName() << "\n";
+			LOG(VERBOSE) << "unknown declaration type "
+						 << def->getDeclKindName() << "\n";
 		}
 	};
 
@@ -173,6 +250,35 @@ write_globals(::Module &mod, CoqPrinter &print, ClangPrinter &cprint) {
 	for (auto def : mod.declarations())
 		write_notations(def);
 
+	// One (nested) module per namespace; `groups` lists each namespace
+	// right before the namespaces it contains.
+	std::vector<std::string> open;
+	auto close = [&] {
+		auto name = module_name(open.back());
+		print.output() << fmt::outdent << "End " << name << "." << fmt::line;
+		print.output() << "Export " << name << "." << fmt::line;
+		open.pop_back();
+	};
+
+	print.output() << "Module _'." << fmt::indent << fmt::line;
+	for (auto &[group, text] : groups) {
+		if (text.empty())
+			continue;
+		auto common = std::mismatch(open.begin(), open.end(), group.begin(),
+									group.end())
+						  .first -
+					  open.begin();
+		while (open.size() > std::size_t(common))
+			close();
+		while (open.size() < group.size()) {
+			open.push_back(group[open.size()]);
+			print.output() << "Module " << module_name(open.back()) << "."
+						   << fmt::indent << fmt::line;
+		}
+		print.output().replay(text);
+	}
+	while (!open.empty())
+		close();
 	print.output() << fmt::outdent << "End _'." << fmt::line;
 	print.output() << "Export _'." << fmt::line << fmt::line;
 }
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "Perf.hpp"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+bool detail::enabled{false};
+
+namespace {
+std::chrono::steady_clock::time_point start;
+
+#ifdef __linux__
+/*
+A counter of the user-space instructions of the calling thread, and,
+with `inherit`, of the threads it starts afterwards (once they exit).
+*/
+int
+open_counter(bool inherit) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.inherit = inherit;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+std::uint64_t
+read_counter(int fd) {
+	std::uint64_t count{0};
+	if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
+
+void
+close_counter(int fd) {
+	if (0 <= fd)
+		close(fd);
+}
+#else
+int
+open_counter(bool) {
+	return -1;
+}
+
+std::uint64_t
+read_counter(int) {
+	return 0;
+}
+
+void
+close_counter(int) {}
+#endif
+
+int process_counter{-1};
+
+struct ThreadCounter {
+	int fd{open_counter(false)};
+	~ThreadCounter() {
+		close_counter(fd);
+	}
+};
+}
+
+bool
+enable(std::string& why) {
+#ifdef __linux__
+	process_counter = open_counter(true);
+	if (process_counter < 0) {
+		why = std::strerror(errno);
+		return false;
+	}
+	start = std::chrono::steady_clock::now();
+	detail::enabled = true;
+	return true;
+#else
+	why = "instructions are only counted on Linux";
+	return false;
+#endif
+}
+
+std::uint64_t
+instructions() {
+	return read_counter(process_counter);
+}
+
+std::uint64_t
+thread_instructions() {
+	if (!enabled())
+		return 0;
+	thread_local ThreadCounter counter;
+	return read_counter(counter.fd);
+}
+
+std::uint64_t
+micros() {
+	auto time = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+}
+
+std::uint64_t
+peak_rss() {
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	// In kilobytes
+	return std::uint64_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+struct Node {
+	unsigned uid;
+	std::string name;
+	std::uint64_t c0, c1{0};
+	std::uint64_t t0, t1{0};
+	llvm::json::Object meta;
+	std::vector<std::unique_ptr<Node>> items;
+};
+
+namespace {
+unsigned uids{0};
+std::vector<std::unique_ptr<Node>> roots;
+std::vector<Node*> live;
+}
+
+Phase::Phase(llvm::StringRef name) {
+	if (!enabled())
+		return;
+	auto& items = live.empty() ? roots : live.back()->items;
+	items.push_back(std::make_unique<Node>(
+		Node{uids++, name.str(), instructions(), 0, micros(), 0, {}, {}}));
+	node_ = items.back().get();
+	live.push_back(node_);
+}
+
+Phase::~Phase() {
+	if (!node_)
+		return;
+	node_->c1 = instructions();
+	node_->t1 = micros();
+	live.erase(std::find(live.begin(), live.end(), node_));
+}
+
+void
+Phase::meta(llvm::StringRef key, std::uint64_t value) {
+	if (node_)
+		node_->meta[key] = value;
+}
+
+void
+Phase::meta(llvm::StringRef key, llvm::StringRef value) {
+	if (node_)
+		node_->meta[key] = value;
+}
+
+void
+write_log(llvm::raw_ostream& os) {
+	llvm::json::OStream json{os, 1};
+	std::function<void(const Node&)> span = [&](const Node& node) {
+		json.object([&] {
+			json.attribute("uid", node.uid);
+			json.attribute("name", node.name);
+			json.attributeObject("meta", [&] {
+				json.attribute("c0", node.c0);
+				json.attribute("c1", node.c1);
+				json.attribute("us", node.t1 - node.t0);
+				for (auto& [key, value] : node.meta)
+					json.attribute(key, value);
+			});
+			json.attributeArray("items", [&] {
+				for (auto& item : node.items)
+					span(*item);
+			});
+		});
+	};
+	json.array([&] {
+		for (auto& root : roots)
+			span(*root);
+	});
+	os << "\n";
+}
+}
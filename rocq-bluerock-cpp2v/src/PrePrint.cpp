@@ -27,17 +27,14 @@ struct PrePrint :
 		if (not type)
 			return false;
 		if (not cache_.lookup(type))
-			if (TypeVisitor<PrePrint, bool>::Visit(type)) {
-				auto name = cache_.fresh(type);
-				type_printer_(Cache::TYPE_PREFIX, name, type);
-				cache_.store(type, name);
-			}
+			if (TypeVisitor<PrePrint, bool>::Visit(type))
+				cache_.store(type, type_printer_(Cache::TYPE_PREFIX, type));
 		return false;
 	}
 
 	bool VisitType(const Type* type) {
 #if 0
-		llvm::errs() << type->getTypeClassName() << "\n";
+		logging::stream() << type->getTypeClassName() << "\n";
 #endif
 		return false;
 	}
@@ -212,11 +209,8 @@ struct PrePrint :
 			return;
 		if (decl == nullptr)
 			return;
-		if (not cache_.lookup(decl)) {
-			auto name = cache_.fresh(decl);
-			name_printer_(Cache::NAME_PREFIX, name, decl);
-			cache_.store(decl, name);
-		}
+		if (not cache_.lookup(decl))
+			cache_.store(decl, name_printer_(Cache::NAME_PREFIX, decl));
 	}
 
 #if 0
@@ -250,4 +244,4 @@ prePrintDecl(const clang::Decl* decl, Cache& cache,
 			 const PRINTER<clang::Type>& type_fn,
 			 const PRINTER<clang::NamedDecl>& name_fn) {
 	PrePrint{cache, type_fn, name_fn}.Visit(decl);
-}
\ No newline at end of file
+}
@@ -9,6 +9,7 @@
 #include "DeclVisitorWithArgs.h"
 #include "Formatter.hpp"
 #include "Logging.hpp"
+#include "Stats.hpp"
 #include "Template.hpp"
 #include "config.hpp"
 #include "clang/AST/Decl.h"
@@ -16,6 +17,7 @@
 #include "clang/Basic/Builtins.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Sema/Sema.h"
+#include "llvm/ADT/SmallString.h"
 #include <clang/AST/Type.h>
 #include <clang/Basic/Version.inc>
 
@@ -23,16 +25,24 @@ using namespace clang;
 
 const char *templateArgumentKindName(TemplateArgument::ArgKind);
 
+/// Report an error in the input, failing the translation unit
+static void
+error(ClangPrinter &cprint, loc::loc loc, StringRef msg) {
+	cprint.error_prefix(logging::FATAL, loc) << "error: " << msg << "\n";
+	cprint.debug_dump(loc);
+	logging::fail();
+}
+
+/// Report a broken invariant of `cpp2v`, and stop
 [[noreturn]] static void
 fatal(ClangPrinter &cprint, loc::loc loc, StringRef msg) {
-	cprint.error_prefix(logging::fatal(), loc) << "error: " << msg << "\n";
-	cprint.debug_dump(loc);
+	error(cprint, loc, msg);
 	logging::die();
 }
 
 static raw_ostream &
 unsupported(ClangPrinter &cprint, loc::loc loc, const Twine &msg) {
-	auto &os = cprint.error_prefix(logging::unsupported(), loc)
+	auto &os = cprint.error_prefix(logging::UNSUPPORTED, loc)
 			   << "warning: unsupported " << msg << "\n";
 	cprint.debug_dump(loc);
 	return os;
@@ -407,7 +417,7 @@ printFields(const CXXRecordDecl &decl, const ASTRecordLayout *layout,
 		if (!field)
 			fatal(cprint, loc::of(decl), "null field");
 		if (field->isBitField())
-			fatal(cprint, loc::of(field), "bit fields are not supported");
+			error(cprint, loc::of(field), "bit fields are not supported");
 
 		guard::ctor _(print, "@mkMember", i != 0);
 		print.output() << (print.templates() ? "lang.temp" : "lang.cpp")
@@ -433,7 +443,9 @@ printStructBases(const CXXRecordDecl &decl, const ASTRecordLayout *layout,
 		};
 
 		if (base.isVirtual())
-			fatal("virtual base classes are not supported");
+			error(cprint,
+				  loc::refine(loc::of(decl), base.getTypeSourceInfo()),
+				  "virtual base classes are not supported");
 
 		auto type = base.getType().getTypePtrOrNull();
 		if (!type)
@@ -491,9 +503,11 @@ printStructOverrides(CoqPrinter &print, const CXXRecordDecl &decl,
 			fatal(cprint, loc::of(decl), "null method");
 		if (m->isVirtual() and not is_pure_virtual(*m)) {
 			for (auto o : m->overridden_methods()) {
-				print.output() << "(";
-				cprint.printName(print, o, loc::of(m)) << fmt::tuple_sep;
-				cprint.printName(print, *m) << ")" << fmt::cons;
+				print.begin_tuple();
+				cprint.printName(print, o, loc::of(m));
+				print.next_tuple();
+				cprint.printName(print, *m);
+				print.end_tuple() << fmt::cons;
 			}
 		}
 	}
@@ -503,7 +517,11 @@ printStructOverrides(CoqPrinter &print, const CXXRecordDecl &decl,
 static fmt::Formatter &
 printDeleteName(CoqPrinter &print, const CXXRecordDecl &decl,
 				ClangPrinter &cprint) {
-	auto dtor = decl.getDestructor();
+	auto dtor = [&] {
+		// Looking up the destructor may build the lookup table of `decl`
+		auto lock = cprint.lock_context();
+		return decl.getDestructor();
+	}();
 	auto del = dtor ? dtor->getOperatorDelete() : nullptr;
 	if (del) {
 		guard::some _(print);
@@ -555,8 +573,12 @@ printStruct(CoqPrinter &print, const CXXRecordDecl &decl, ClangPrinter &cprint,
 	if (!decl.isCompleteDefinition())
 		return print.none();
 
-	const auto layout =
-		decl.isDependentContext() ? nullptr : &ctxt.getASTRecordLayout(&decl);
+	auto layout = [&]() -> const ASTRecordLayout * {
+		if (decl.isDependentContext())
+			return nullptr;
+		auto lock = cprint.lock_context();
+		return &ctxt.getASTRecordLayout(&decl);
+	}();
 
 	guard::some some(print);
 	guard::ctor _(print, "Build_Struct");
@@ -586,8 +608,12 @@ printUnion(CoqPrinter &print, const CXXRecordDecl &decl, ClangPrinter &cprint,
 	if (!decl.isCompleteDefinition())
 		return print.none();
 
-	const auto layout =
-		decl.isDependentContext() ? nullptr : &ctxt.getASTRecordLayout(&decl);
+	auto layout = [&]() -> const ASTRecordLayout * {
+		if (decl.isDependentContext())
+			return nullptr;
+		auto lock = cprint.lock_context();
+		return &ctxt.getASTRecordLayout(&decl);
+	}();
 
 	guard::some some(print);
 	guard::ctor _(print, "Build_Union");
@@ -732,7 +758,8 @@ printMethod(CoqPrinter &print, const CXXMethodDecl &decl, ClangPrinter &cprint,
 		guard::ctor _(print, "UserDefined");
 		return cprint.printStmt(print, body);
 	} else if (decl.isDefaulted()) {
-		return print.output() << "(Some Defaulted)";
+		return print.output() << fmt::lgroup << "Some" << fmt::nbsp
+							  << "Defaulted" << fmt::rgroup;
 	} else {
 		return print.none();
 	}
@@ -886,7 +913,8 @@ printDestructor(CoqPrinter &print, const CXXDestructorDecl &decl,
 		guard::ctor _(print, "UserDefined");
 		return cprint.printStmt(print, body);
 	} else if (decl.isDefaulted()) {
-		return print.output() << "(Some Defaulted)";
+		return print.output() << fmt::lgroup << "Some" << fmt::nbsp
+							  << "Defaulted" << fmt::rgroup;
 	} else {
 		return print.none();
 	}
@@ -982,11 +1010,14 @@ struct EnumConst {
 		fmt::Formatter &print(CoqPrinter &print) const {
 			switch (kind) {
 			case Kint: {
-				return print.output() << "(inr " << val << ")";
+				return print.output() << fmt::lgroup << "inr" << fmt::nbsp
+									  << val << fmt::rgroup;
 			}
 			case Kchar: {
 				auto c = toBRiCkCharacter(bitsize, val.getExtValue());
-				return print.output() << "(inl " << c << "%N)";
+				(print.output() << fmt::lgroup << "inl" << fmt::nbsp << c)
+					.scope("N");
+				return print.output() << fmt::rgroup;
 			}
 			default:
 				always_assert(false);
@@ -1048,7 +1079,7 @@ crackEnumConst(const EnumConstantDecl &decl, CoqPrinter &print,
 	};
 	auto v = decl.getInitVal();
 	if (isBRiCkCharacterType(*bt))
-		return ret(EnumConst::UVal(ctxt.getTypeSize(bt), v));
+		return ret(EnumConst::UVal(cprint.getTypeSize(bt), v));
 	else
 		return ret(EnumConst::UVal(v));
 }
@@ -1092,11 +1123,7 @@ staticAssertMessage(const StaticAssertDecl &decl) {
 class PrintDecl :
 	public ConstDeclVisitorArgs<PrintDecl, bool, CoqPrinter &, ClangPrinter &,
 								const ASTContext &> {
-private:
-	PrintDecl() = default;
-
 public:
-	static PrintDecl printer;
 
 	bool VisitDecl(const Decl *decl, CoqPrinter &print, ClangPrinter &cprint,
 				   const ASTContext &) {
@@ -1212,8 +1239,8 @@ public:
 		} else if (decl->isUnion()) {
 			return VisitUnionDecl(decl, print, cprint, ctxt);
 		} else {
-			std::string msg;
-			llvm::raw_string_ostream os{msg};
+			SmallString<64> msg;
+			llvm::raw_svector_ostream os{msg};
 			os << "CXXRecord with tag kind " << decl->getKindName();
 			unsupported(cprint, loc::of(decl), msg);
 			return false;
@@ -1284,11 +1311,10 @@ public:
 	}
 };
 
-PrintDecl PrintDecl::printer;
-
 bool
 ClangPrinter::printDecl(CoqPrinter &print, const clang::Decl *decl) {
 	if (trace(Trace::Decl))
 		trace("printDecl", loc::of(decl));
-	return PrintDecl::printer.Visit(decl, print, *this, *context_);
+	stats::Scope _{stats::DECL, decl->getDeclKindName(), print.output()};
+	return PrintDecl{}.Visit(decl, print, *this, *context_);
 }
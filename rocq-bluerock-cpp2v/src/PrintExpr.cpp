@@ -9,12 +9,14 @@
 #include "Formatter.hpp"
 #include "Logging.hpp"
 #include "OpaqueNames.hpp"
+#include "Stats.hpp"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Mangle.h"
 #include "clang/AST/StmtVisitor.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/Builtins.h"
 #include "clang/Basic/TargetInfo.h"
+#include "llvm/ADT/SmallString.h"
 #include <bit>
 #include <clang/Basic/Version.inc>
 
@@ -60,9 +62,11 @@ ClangPrinter::printOverloadableOperator(CoqPrinter& print,
 #undef OVERLOADED_OPERATOR
 #undef OVERLOADED_OPERATOR_MULTI
 	default:
-		error_prefix(logging::fatal(), loc)
-			<< "unknown overloadable operator " << oo << "\n";
-		logging::die();
+		error_prefix(logging::FATAL, loc)
+			<< "error: unknown overloadable operator " << oo << "\n";
+		logging::fail();
+		// Keep printing; the translation unit already failed
+		return print.output() << "OOCall";
 	}
 }
 
@@ -96,7 +100,7 @@ is_static_member(ValueDecl* decl) {
 		return true; // vd->isStaticLocal();
 	} else {
 		decl->dump();
-		llvm::errs().flush();
+		logging::stream().flush();
 		always_assert(false && "unsupported [is_static_member]");
 		return false;
 	}
@@ -124,7 +128,8 @@ ClangPrinter::printValueDeclExpr(CoqPrinter& print, const ValueDecl* decl,
 	};
 	auto t = on.find_anon(decl);
 	if (t != -1) {
-		print.ctor("Evar", false) << "(localname.anon " << t << ")";
+		print.ctor("Evar", false) << fmt::lgroup << "localname.anon"
+								  << fmt::nbsp << t << fmt::rgroup;
 	} else if (decl->getDeclContext()->isFunctionOrMethod() and
 			   not(isa<FunctionDecl>(decl) or check_static_local(decl))) {
 		print.ctor("Evar", false);
@@ -168,8 +173,8 @@ struct PrintDependentName : public ConstStmtVisitor<PrintDependentName, void> {
 
 	void Visit(const Expr* expr) {
 		if (cprint.trace(Trace::Name)) {
-			llvm::errs() << "printDependentName(" << expr->getStmtClassName()
-						 << ")\n";
+			logging::stream()
+				<< "printDependentName(" << expr->getStmtClassName() << ")\n";
 			expr->dump();
 		}
 		ConstStmtVisitor<PrintDependentName, void>::Visit(expr);
@@ -197,16 +202,17 @@ struct PrintDependentName : public ConstStmtVisitor<PrintDependentName, void> {
 
 	void VisitUnresolvedMemberExpr(const UnresolvedMemberExpr* expr) {
 		auto name = expr->getName();
-		llvm::errs() << "printDeclarationName(" << expr->getName().getNameKind()
-					 << ")";
+		logging::stream() << "printDeclarationName("
+						  << expr->getName().getNameKind() << ")";
 		name.dump();
 
-		print.output() << "(Nunsupported \"VisitUnresolvedMemberExpr\")";
+		print.output() << fmt::lgroup << "Nunsupported" << fmt::nbsp;
+		print.str("VisitUnresolvedMemberExpr") << fmt::rgroup;
 	}
 
 	void VisitExpr(const Expr* expr) {
-		llvm::errs() << "PrintDependentName(" << expr->getStmtClassName()
-					 << ")\n";
+		logging::stream() << "PrintDependentName("
+						  << expr->getStmtClassName() << ")\n";
 		expr->dump();
 		// TODO: DependentScopeMemberExpr
 		print.ctor("Nunsupported");
@@ -272,7 +278,11 @@ public:
 		logging::fatal() << "Error: while printing an expr, got a statement '"
 						 << stmt->getStmtClassName() << " at "
 						 << cprint.sourceRange(stmt->getSourceRange()) << "'\n";
-		logging::die();
+		logging::fail();
+		guard::ctor _{print, "Eunsupported", false};
+		print.str(stmt->getStmtClassName()) << fmt::nbsp;
+		guard::ctor type{print, "Tunsupported", false};
+		print.str("statement");
 	}
 
 	void unsupported_expr(const Expr* expr,
@@ -280,16 +290,16 @@ public:
 						  bool well_known = false) {
 		auto loc = loc::of(expr);
 		if (!well_known || ClangPrinter::warn_well_known) {
-			cprint.error_prefix(logging::unsupported(), loc)
-				<< "warning: unsupported expression";
+			auto& os = cprint.error_prefix(logging::UNSUPPORTED, loc)
+					   << "warning: unsupported expression";
 			if (msg)
-				logging::unsupported() << ": " << *msg;
-			logging::unsupported() << "\n";
+				os << ": " << *msg;
+			os << "\n";
 		}
 		print.ctor("Eunsupported", false);
-		std::string coqmsg;
-		llvm::raw_string_ostream os{coqmsg};
-		os << loc::describe(loc, cprint.getContext());
+		SmallString<128> coqmsg;
+		llvm::raw_svector_ostream os{coqmsg};
+		cprint.describe(os, loc);
 		print.str(coqmsg) << fmt::nbsp;
 		done(expr, Done::DT);
 	}
@@ -298,9 +308,9 @@ public:
 		if (expr->containsErrors()) {
 			auto loc = loc::of(expr);
 			print.ctor("Eerror", false);
-			std::string coqmsg;
-			llvm::raw_string_ostream os{coqmsg};
-			os << loc::describe(loc, cprint.getContext());
+			SmallString<128> coqmsg;
+			llvm::raw_svector_ostream os{coqmsg};
+			cprint.describe(os, loc);
 			print.str(coqmsg) << fmt::nbsp;
 			print.end_ctor();
 		} else {
@@ -398,12 +408,12 @@ public:
 			CASE(PtrMemI, "Bdotip")
 #undef CASE
 		default:
-			logging::unsupported()
+			LOG(UNSUPPORTED)
 				<< "Unsupported binary operator '" << expr->getOpcodeStr()
 				<< "' (at " << cprint.sourceRange(expr->getSourceRange())
 				<< ")\n";
-			print.output() << "(Bunsupported \"" << expr->getOpcodeStr()
-						   << "\")";
+			print.output() << fmt::lgroup << "Bunsupported" << fmt::nbsp;
+			print.str(expr->getOpcodeStr()) << fmt::rgroup;
 			break;
 		}
 	}
@@ -491,13 +501,13 @@ public:
 			CASE(PreInc, "<PreInc>")
 #undef CASE
 		default:
-			logging::unsupported()
+			LOG(UNSUPPORTED)
 				<< "Unsupported unary operator '"
 				<< UnaryOperator::getOpcodeStr(expr->getOpcode()) << "' (at "
 				<< cprint.sourceRange(expr->getSourceRange()) << ")\n";
-			print.output() << "(Uunsupported \""
-						   << UnaryOperator::getOpcodeStr(expr->getOpcode())
-						   << "\")";
+			print.output() << fmt::lgroup << "Uunsupported" << fmt::nbsp;
+			print.str(UnaryOperator::getOpcodeStr(expr->getOpcode()))
+				<< fmt::rgroup;
 			break;
 		}
 	}
@@ -573,17 +583,17 @@ public:
 	void VisitDeclRefExpr(const DeclRefExpr* expr) {
 		auto var_decl = expr->getDecl();
 		if (!var_decl) {
-			cprint.error_prefix(logging::fatal(), loc::of(expr))
-				<< "DeclRefExpr missing Decl\n";
-			print.die();
+			cprint.error_prefix(logging::FATAL, loc::of(expr))
+				<< "error: DeclRefExpr missing Decl\n";
+			logging::fail();
+			return unsupported_expr(expr, "DeclRefExpr missing Decl");
 		}
 
 		if (ClangPrinter::debug && cprint.trace(Trace::Expr)) {
 			auto& os = cprint.trace("VisitDeclRefExpr", loc::of(expr));
 			auto loc = loc::of(var_decl);
 			if (loc::can_describe(loc))
-				os << "Declaration: " << loc::describe(loc, cprint.getContext())
-				   << "\n";
+				cprint.describe(os << "Declaration: ", loc) << "\n";
 		}
 		if (expr->refersToEnclosingVariableOrCapture()) {
 			auto maybe_lambda = cprint.getLambdaClass();
@@ -652,12 +662,12 @@ public:
 				cprint.printNonTypeTemplateParam(
 					print, param->getDepth(), param->getIndex(), loc::of(expr));
 #if 0
-				llvm::errs() << "\n";
+				logging::stream() << "\n";
 				expr->dump();
 				var_decl->dump();
-				llvm::errs() << "\n";
+				logging::stream() << "\n";
 
-				llvm::errs().flush();
+				logging::stream().flush();
 
 				always_assert(false);
 				unsupported_expr(expr, std::nullopt,
@@ -745,8 +755,9 @@ public:
 			print.list(expr->arguments(),
 					   [&](auto i) { cprint.printExpr(print, i, names); });
 		} else {
-			logging::unsupported() << "unsupported operator call";
-			logging::die();
+			unsupported_expr(expr, "operator call");
+			logging::fail();
+			return;
 		}
 
 		done(expr, Done::NONE);
@@ -832,7 +843,7 @@ public:
 			done(ce, Done::DT);
 			break;
 		default:
-			logging::unsupported()
+			LOG(UNSUPPORTED)
 				<< "unsupported cast kind \"" << ce->getCastKindName() << "\""
 				<< " (at " << cprint.sourceRange(ce->getSourceRange()) << ")\n";
 			print.ctor("Cunsupported", false);
@@ -906,12 +917,12 @@ public:
 		} else {
 			lit->getValue().toStringUnsigned(s);
 		}
-		print.output() << s << "%Z";
+		print.output().write(s).scope("Z");
 		done(lit);
 	}
 
 	void VisitCharacterLiteral(const CharacterLiteral* lit) {
-		print.ctor("Echar", false) << lit->getValue() << "%N";
+		(print.ctor("Echar", false) << lit->getValue()).scope("N");
 		done(lit);
 	}
 
@@ -929,7 +940,10 @@ public:
 	void VisitSourceLocExpr(const SourceLocExpr* expr) {
 		guard::ctor _{print, "Esource_loc"};
 		print.str(expr->getBuiltinStr()) << fmt::nbsp;
-		auto val = expr->EvaluateInContext(cprint.getContext(), nullptr);
+		auto val = [&] {
+			auto lock = cprint.lock_context();
+			return expr->EvaluateInContext(cprint.getContext(), nullptr);
+		}();
 		if (expr->isIntType()) {
 			print.ctor("Eint");
 			print.output() << fmt::Z(val.getInt(), false) << fmt::nbsp;
@@ -969,7 +983,7 @@ public:
 				}
 				i += width;
 			}
-			print.output() << byte << "%N";
+			(print.output() << byte).scope("N");
 			print.cons();
 		}
 		print.end_list();
@@ -990,22 +1004,32 @@ public:
 
 	void VisitCXXBoolLiteralExpr(const CXXBoolLiteralExpr* lit) {
 		if (lit->getValue()) {
-			print.output() << "(Ebool true)";
+			print.output() << fmt::lgroup << "Ebool" << fmt::nbsp << "true"
+						   << fmt::rgroup;
 		} else {
-			print.output() << "(Ebool false)";
+			print.output() << fmt::lgroup << "Ebool" << fmt::nbsp << "false"
+						   << fmt::rgroup;
 		}
 	}
 
 	void VisitFloatingLiteral(const FloatingLiteral* lit) {
-		print.ctor("Eunsupported") << fmt::nbsp << "\"float: ";
-		lit->getValue().print(print.output().nobreak());
-		print.output() << "\"";
+		SmallString<32> value;
+		llvm::raw_svector_ostream os{value};
+		lit->getValue().print(os);
+		print.ctor("Eunsupported");
+		print.str("float: " + value.str().str());
 		done(lit, Done::T);
 	}
 
 	void VisitMemberExpr(const MemberExpr* expr) {
 		auto member = expr->getMemberDecl();
 		auto base = expr->getBase();
+		if (!isa<FieldDecl, EnumConstantDecl, VarDecl, CXXMethodDecl>(member)) {
+			cprint.error_prefix(logging::FATAL, loc::of(expr))
+				<< "error: unknown member in MemberExpr\n";
+			logging::fail();
+			return unsupported_expr(expr, "member");
+		}
 
 		print.ctor("Emember");
 		print.boolean(expr->isArrow()) << fmt::nbsp;
@@ -1037,13 +1061,11 @@ public:
 			guard::ctor _{print, "Static", false};
 			cprint.printName(print, *vd) << fmt::nbsp;
 			cprint.printQualType(print, member->getType(), loc::of(member));
-		} else if (auto md = dyn_cast<CXXMethodDecl>(member)) {
+		} else {
+			auto md = cast<CXXMethodDecl>(member);
 			guard::ctor _{print, "Static", false};
 			cprint.printName(print, *md) << fmt::nbsp;
 			cprint.printQualType(print, member->getType(), loc::of(member));
-		} else {
-			logging::fatal() << "Unknown member in MemberExpr\n";
-			logging::die();
 		}
 		print.end_ctor();
 	}
@@ -1103,7 +1125,8 @@ public:
 		auto idx = 0;
 		print.list(ctor->parameters(), [&](auto i) {
 			print.ctor("Evar", false);
-			print.output() << "(localname.anon " << idx << ")";
+			print.output() << fmt::lgroup << "localname.anon" << fmt::nbsp
+						   << idx << fmt::rgroup;
 			print.output() << fmt::nbsp;
 			cprint.printQualType(print, i->getType(), loc::of(i));
 			print.end_ctor();
@@ -1122,14 +1145,14 @@ public:
 
 			print.ctor("inl") << fmt::lparen;
 			cprint.printName(print, method, loc::of(expr));
-			print.output() << "," << fmt::nbsp;
+			print.output() << fmt::tuple_sep;
 			if (method->isVirtual() &&
 				me->performsVirtualDispatch(ctxt.getLangOpts())) {
 				print.output() << "Virtual";
 			} else {
 				print.output() << "Direct";
 			}
-			print.output() << "," << fmt::nbsp;
+			print.output() << fmt::tuple_sep;
 
 			if (const CXXMethodDecl* const md =
 					dyn_cast<CXXMethodDecl>(me->getMemberDecl())) {
@@ -1349,19 +1372,18 @@ public:
 			using namespace logging;
 			fatal() << "unsupported expression "
 					   "`UnaryExprOrTypeTraitExpr` at "
-					<< expr->getSourceRange().printToString(
-						   ctxt.getSourceManager())
-					<< "\n";
+					<< cprint.sourceRange(expr->getSourceRange()) << "\n";
 			print.ctor("Eunsupported");
-			print.output() << "\"UnaryExprOrTypeTraitExpr(" << expr->getKind()
-						   << "\")" << fmt::nbsp;
+			print.str("UnaryExprOrTypeTraitExpr(" +
+					  std::to_string(expr->getKind()) + ")")
+				<< fmt::nbsp;
 			done(expr);
 		}
 		}
 	}
 
 	void VisitOffsetOfExpr(const OffsetOfExpr* expr) {
-		auto unsupported = [&](const std::string what) {
+		auto unsupported = [&](StringRef what) {
 			unsupported_expr(expr, what);
 		};
 		if (expr->getNumComponents() != 1)
@@ -1442,23 +1464,27 @@ public:
 	}
 
 	void VisitCXXDeleteExpr(const CXXDeleteExpr* expr) {
+		auto op = expr->getOperatorDelete();
+		if (!op) {
+			cprint.error_prefix(logging::FATAL, loc::of(expr))
+				<< "error: missing [delete] operator\n";
+			logging::fail();
+			return unsupported_expr(expr, "delete");
+		}
+
 		print.ctor("Edelete");
 		print.output() << fmt::BOOL(expr->isArrayForm()) << fmt::nbsp;
 
-		if (auto op = expr->getOperatorDelete()) {
-			if (op->isDestroyingOperatorDelete()) {
-				logging::fatal() << "destroying delete is not supported\n";
-				logging::die();
-			}
-			print.begin_tuple();
-			cprint.printName(print, *op);
-			print.next_tuple();
-			cprint.printQualType(print, op->getType(), loc::of(op));
-			print.end_tuple();
-		} else {
-			logging::fatal() << "missing [delete] operator\n";
-			logging::die();
+		if (op->isDestroyingOperatorDelete()) {
+			cprint.error_prefix(logging::FATAL, loc::of(expr))
+				<< "error: destroying delete is not supported\n";
+			logging::fail();
 		}
+		print.begin_tuple();
+		cprint.printName(print, *op);
+		print.next_tuple();
+		cprint.printQualType(print, op->getType(), loc::of(op));
+		print.end_tuple();
 		print.output() << fmt::nbsp;
 
 		cprint.printExpr(print, expr->getArgument(), names);
@@ -1477,7 +1503,7 @@ public:
 		// mark this explicitly.
 		print.ctor("Eandclean");
 		if (ClangPrinter::debug && cprint.trace(Trace::Expr)) {
-			auto& os = llvm::errs();
+			auto& os = logging::stream();
 			os << "and_clean objects: " << expr->getNumObjects() << "\n";
 			for (auto i : expr->getObjects()) {
 				os << i.getOpaqueValue() << "\n";
@@ -1533,7 +1559,7 @@ public:
 #undef BUILTIN
 #undef ATOMIC_BUILTIN
 		default:
-			// llvm::errs() << "atomic (" << expr->getOp() << ")\n";
+			// logging::stream() << "atomic (" << expr->getOp() << ")\n";
 			return unsupported_expr(expr);
 		}
 
@@ -1660,7 +1686,10 @@ ClangPrinter::printExpr(CoqPrinter& print, const clang::Expr* expr,
 		trace("printExpr", loc::of(expr));
 
 	auto depth = print.output().get_depth();
-	PrintExpr{print, *this, li}.Visit(expr);
+	{
+		stats::Scope _{stats::EXPR, expr->getStmtClassName(), print.output()};
+		PrintExpr{print, *this, li}.Visit(expr);
+	}
 	if (depth != print.output().get_depth()) {
 		using namespace logging;
 		fatal() << "Error: BUG indentation bug in during: "
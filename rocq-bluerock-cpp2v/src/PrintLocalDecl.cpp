@@ -9,7 +9,6 @@
 #include "Formatter.hpp"
 #include "Logging.hpp"
 #include "OpaqueNames.hpp"
-#include "clang/Frontend/CompilerInstance.h"
 
 using namespace clang;
 
@@ -25,6 +24,7 @@ private:
 
 	CXXDestructorDecl* get_dtor(QualType qt) {
 		if (auto rd = qt->getAsCXXRecordDecl()) {
+			auto lock = cprint.lock_context();
 			return rd->getDestructor();
 		} else if (auto ary = qt->getAsArrayTypeUnsafe()) {
 			return get_dtor(ary->getElementType());
@@ -60,7 +60,7 @@ public:
 
 		} else if (decl->isStaticLocal()) {
 			bool thread_safe =
-				cprint.getCompiler().getLangOpts().ThreadsafeStatics;
+				cprint.getContext().getLangOpts().ThreadsafeStatics;
 			print.ctor("Dinit");
 			print.output() << fmt::BOOL(thread_safe) << fmt::nbsp;
 			cprint.printName(print, *decl);
@@ -112,7 +112,8 @@ public:
 		cprint.printExpr(print, decl->getInit(), names);
 
 		int index = names.push_anon(decl);
-		print.output() << fmt::nbsp << "(localname.anon " << index << ")";
+		print.output() << fmt::nbsp << fmt::lgroup << "localname.anon"
+					   << fmt::nbsp << index << fmt::rgroup;
 
 		print.output() << fmt::nbsp;
 
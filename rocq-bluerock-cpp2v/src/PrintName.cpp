@@ -8,6 +8,7 @@
 #include "CoqPrinter.hpp"
 #include "Formatter.hpp"
 #include "Logging.hpp"
+#include "Stats.hpp"
 #include "Template.hpp"
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/DeclCXX.h>
@@ -15,6 +16,7 @@
 #include <clang/AST/Mangle.h>
 #include <clang/Basic/Version.inc>
 #include <clang/Frontend/CompilerInstance.h>
+#include <llvm/ADT/SmallString.h>
 #include <optional>
 
 using namespace clang;
@@ -175,14 +177,14 @@ printNameForDiagnostics(raw_ostream& os, const NamedDecl& decl,
 static raw_ostream&
 fatal(ClangPrinter& cprint, loc::loc loc) {
 	cprint.debug_dump(loc);
-	return cprint.error_prefix(logging::fatal(), loc) << "error: ";
+	return cprint.error_prefix(logging::FATAL, loc) << "error: ";
 }
 
 static raw_ostream&
 warning(ClangPrinter& cprint, loc::loc loc, bool dump = true) {
 	if (dump)
 		cprint.debug_dump(loc);
-	return cprint.error_prefix(logging::unsupported(), loc) << "warning: ";
+	return cprint.error_prefix(logging::UNSUPPORTED, loc) << "warning: ";
 }
 
 static raw_ostream&
@@ -197,7 +199,8 @@ toDecl(const DeclContext& ctx, ClangPrinter& cprint, loc::loc loc) {
 	else {
 		fatal(cprint, loc) << "declaration context of kind "
 						   << ctx.getDeclKindName() << " not a declaration\n";
-		logging::die();
+		logging::fail();
+		return ref<const Decl>{*cprint.getContext().getTranslationUnitDecl()};
 	}
 }
 
@@ -288,32 +291,35 @@ isIgnorableContext(const DeclContext& ctx, ClangPrinter& cprint) {
 
 static ref<const DeclContext>
 getNonIgnorableAncestor(const Decl& decl, ClangPrinter& cprint) {
-	auto fatal = [&](const std::string what, loc::loc loc) NORETURN {
+	// Fail, and carry on in the translation unit
+	auto fatal = [&](StringRef what, loc::loc loc) -> const DeclContext* {
 		::fatal(cprint, loc) << what << "\n";
-		logging::die();
+		logging::fail();
+		return cprint.getContext().getTranslationUnitDecl();
 	};
-	auto parent = [&](const DeclContext* ctx) {
+	auto parent = [&](const DeclContext* ctx) -> const DeclContext* {
 		if (auto p = ctx->getParent()) {
 			if (cprint.trace(Trace::Name))
 				cprint.trace("getNonIgnorableAncestor skipping", loc::of(ctx));
 			return p;
 		} else
-			fatal("declaration context outside any translation unit",
-				  loc::of(ctx));
+			return fatal("declaration context outside any translation unit",
+						 loc::of(ctx));
 	};
 	if (auto p = decl.getDeclContext()) {
 		for (; isIgnorableContext(*p, cprint); p = parent(p))
 			;
 		if (false && cprint.trace(Trace::Name)) {
-			std::string what;
-			llvm::raw_string_ostream os{what};
+			SmallString<128> what;
+			llvm::raw_svector_ostream os{what};
 			os << "getNonIgnorableAncestor (= "
 			   << loc::describe(loc::of(p), cprint.getContext()) << ")";
 			cprint.trace(what, loc::of(decl));
 		}
 		return ref{*p};
 	} else
-		fatal("declaration outside any translation unit\n", loc::of(decl));
+		return ref{*fatal("declaration outside any translation unit",
+						  loc::of(decl))};
 }
 
 // Decide if a declaration is named or anonymous.
@@ -354,7 +360,8 @@ getAnonymousIndex(const DeclContext& ctx, const Decl& decl, unsigned& acc,
 		if (!d) {
 			fatal(cprint, loc::of(ctx))
 				<< "declaration context with null declaration\n";
-			logging::die();
+			logging::fail();
+			continue;
 		}
 		if (auto dctx = dyn_cast<DeclContext>(d)) {
 			if (isIgnorableContext(*dctx, cprint) &&
@@ -374,11 +381,12 @@ getAnonymousIndex(const DeclContext& ctx, const Decl& decl,
 	if (!getAnonymousIndex(ctx, decl, i, cprint)) {
 		fatal(cprint, loc::of(decl))
 			<< "could not find anonymous declaration in context\n";
-		logging::die();
+		logging::fail();
+		return 0;
 	}
 	if (false && cprint.trace(Trace::Name)) {
-		std::string what;
-		llvm::raw_string_ostream os{what};
+		SmallString<32> what;
+		llvm::raw_svector_ostream os{what};
 		os << "getAnonymousIndex (= " << i << " )";
 		cprint.trace(what, loc::of(decl));
 	}
@@ -529,11 +537,13 @@ printTemplateArgument(CoqPrinter& print, const TemplateArgument& arg,
 		if (cprint.warn_well_known) {
 			unsupported(cprint, loc, false)
 				<< "template argument of kind " << k << "\n";
+			if (logging::enabled(logging::VERBOSER)) {
 #if 19 <= CLANG_VERSION_MAJOR
-			arg.dump();
+				arg.dump();
 #else
-			arg.dump(logging::debug());
+				arg.dump(logging::debug());
 #endif
+			}
 		}
 		guard::ctor _(print, "Aunsupported", false);
 		return print.str(k);
@@ -623,8 +633,8 @@ printFunctionName(CoqPrinter& print, const FunctionDecl& decl,
 	if (ClangPrinter::debug && cprint.trace(Trace::Name))
 		cprint.trace("printFunctionName", loc::of(decl));
 	auto unsupported = [&]() -> auto& {
-		std::string what;
-		llvm::raw_string_ostream os{what};
+		SmallString<128> what;
+		llvm::raw_svector_ostream os{what};
 		os << "function name: ";
 		decl.getNameForDiagnostic(os, cprint.getContext().getPrintingPolicy(),
 								  false);
@@ -703,7 +713,7 @@ printAtomicName(const DeclContext& ctx, const Decl& decl, CoqPrinter& print,
 		return unsupported("ident for un-named term");
 	};
 
-	auto ident_or_anon = [&](const std::optional<std::string> anon_error =
+	auto ident_or_anon = [&](std::optional<StringRef> anon_error =
 								 std::nullopt) -> auto& {
 		if (auto nd = isNamed(decl)) {
 			guard::ctor _(print, "Nid", false);
@@ -755,7 +765,7 @@ printAtomicName(const DeclContext& ctx, const Decl& decl, CoqPrinter& print,
 	}
 	if (auto rd = dyn_cast<RecordDecl>(&decl)) {
 		if (rd->getParent()->isTranslationUnit()) {
-			logging::unsupported()
+			LOG(UNSUPPORTED)
 				<< "Anonymous global records without declarations are not "
 				   "supported. These can not be referenced in C++!\n "
 				<< fmt::dump(*rd);
@@ -775,10 +785,10 @@ printAtomicName(const DeclContext& ctx, const Decl& decl, CoqPrinter& print,
 			}
 		}
 		if (ed->getParent()->isTranslationUnit()) {
-			logging::unsupported() << "Unsupported empty enumeration in global "
-									  "context. These can not be "
-									  "referenced in C++!\n"
-								   << fmt::dump(*ed);
+			LOG(UNSUPPORTED) << "Unsupported empty enumeration in global "
+								"context. These can not be "
+								"referenced in C++!\n"
+							 << fmt::dump(*ed);
 			return unsupported("enum");
 		}
 	} else if (auto ns = dyn_cast<NamespaceDecl>(&decl)) {
@@ -853,8 +863,8 @@ printAtomicName(const DeclContext& ctx, const Decl& decl, CoqPrinter& print,
 	case Decl::Kind::Binding:
 		return ident_or_anon("anonymous binding");
 	default:
-		std::string what;
-		llvm::raw_string_ostream os{what};
+		SmallString<64> what;
+		llvm::raw_svector_ostream os{what};
 		os << "atomic name of kind " << decl.getDeclKindName();
 		return unsupported(what);
 	}
@@ -867,10 +877,12 @@ printName(CoqPrinter& print, const Decl& decl, ClangPrinter& cprint) {
 	if (ClangPrinter::debug && cprint.trace(Trace::Name))
 		cprint.trace("structured::printName", loc::of(decl));
 	if (auto nd = dyn_cast<NamedDecl>(&decl)) {
-		if (print.reference(nd))
+		if (print.reference(nd)) {
+			stats::hit(stats::NAME, decl.getDeclKindName());
 			return print.output();
+		}
 	} else {
-		llvm::errs() << "not a named decl\n";
+		logging::stream() << "not a named decl\n";
 		decl.dump();
 		always_assert(false);
 	}
@@ -948,7 +960,7 @@ printDtorName(CoqPrinter& print, const CXXRecordDecl& decl,
 
 template<typename T>
 T&
-deref(CoqPrinter& print, ClangPrinter& cprint, const std::string whence, T* p,
+deref(CoqPrinter& print, ClangPrinter& cprint, StringRef whence, T* p,
 	  loc::loc loc) {
 	if (!p) {
 		fatal(cprint, loc) << whence << ": null pointer\n";
@@ -963,8 +975,8 @@ ClangPrinter::printNameComment(CoqPrinter& print, const Decl& decl) {
 		trace("printNameComment", loc::of(decl));
 	if (comment_)
 		if (auto nd = dyn_cast<NamedDecl>(&decl)) {
-			std::string cmt;
-			llvm::raw_string_ostream os{cmt};
+			SmallString<128> cmt;
+			llvm::raw_svector_ostream os{cmt};
 			structured::printNameForDiagnostics(os, *nd, getContext());
 			return print.cmt(cmt);
 		}
@@ -987,9 +999,40 @@ fmt::Formatter&
 ClangPrinter::printName(CoqPrinter& print, const Decl& decl, bool full) {
 	if (trace(Trace::Name))
 		trace("printName", loc::of(decl));
+	stats::Scope _{stats::NAME, decl.getDeclKindName(), print.output()};
 	if (full) {
-		auto temp = withDecl(&decl);
-		return structured::printName(print, decl, temp);
+		/*
+		Structured names are printed over and over (e.g., as keys and as
+		the scopes of other names), so we print each one once per mode and
+		replay its bytes, and the structure they were printed with (see
+		`Formatter::replay`).
+		*/
+		auto& cache = print.cache();
+		auto templates = print.templates();
+		auto structure = print.output().structure();
+		auto name = cache.printed_name(&decl, templates, structure);
+		if (name)
+			stats::hit(stats::NAME, decl.getDeclKindName());
+		else {
+			SmallString<256> bytes;
+			fmt::Recording recording;
+			Cache::Refs refs;
+			{
+				llvm::raw_svector_ostream os{bytes};
+				fmt::Formatter fmt{os};
+				if (structure)
+					fmt.set_structure(&recording);
+				CoqPrinter scratch{fmt, templates, print.structured_keys(),
+								   cache};
+				Cache::Recorder recorder{cache, refs};
+				auto temp = withDecl(&decl);
+				structured::printName(scratch, decl, temp);
+			}
+			name = cache.remember_name(&decl, templates, bytes,
+									   structure ? &recording : nullptr, refs);
+		}
+		cache.replay(*name, print.output());
+		return print.output();
 	} else
 		return structured::printAtomicName(*(decl.getDeclContext()), decl,
 										   print, *this);
@@ -1099,10 +1142,13 @@ printDeclarationName(CoqPrinter& print, const DeclarationName& name,
 	}
 
 	default:
-		llvm::errs() << "printDeclarationName(" << name.getNameKind() << ")";
+		logging::stream() << "printDeclarationName(" << name.getNameKind()
+						  << ")";
 		name.dump();
-		print.output() << "(Nunsupported \"printDeclarationName("
-					   << name.getNameKind() << ")\")";
+		print.output() << fmt::lgroup << "Nunsupported" << fmt::nbsp;
+		print.str("printDeclarationName(" +
+				  std::to_string(name.getNameKind()) + ")")
+			<< fmt::rgroup;
 	}
 	return print.output();
 }
@@ -1134,7 +1180,8 @@ ClangPrinter::printNestedName(CoqPrinter& print,
 		unsupported(*this, loc, true)
 			<< "unsupported NestedNameSpecifier " << spec->getKind() << "\n";
 		guard::ctor _{print, "Nunsupported", false};
-		print.output() << "\"NestedNameSpecifier(" << spec->getKind() << ")\"";
+		print.str("NestedNameSpecifier(" + std::to_string(spec->getKind()) +
+				  ")");
 	}
 	return print.output();
 }
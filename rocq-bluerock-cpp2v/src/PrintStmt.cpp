@@ -8,6 +8,7 @@
 #include "CoqPrinter.hpp"
 #include "Formatter.hpp"
 #include "Logging.hpp"
+#include "Stats.hpp"
 #include "clang/AST/Attr.h"
 #include "clang/AST/Mangle.h"
 #include "clang/AST/StmtVisitor.h"
@@ -18,20 +19,17 @@ using namespace clang;
 class PrintStmt :
 	public ConstStmtVisitor<PrintStmt, void, CoqPrinter &, ClangPrinter &,
 							ASTContext &> {
-private:
-	PrintStmt() {}
-
 public:
-	static PrintStmt printer;
 
 	void VisitStmt(const Stmt *stmt, CoqPrinter &print, ClangPrinter &cprint,
 				   ASTContext &ctxt) {
 		using namespace logging;
 		fatal() << "unsupported statement " << stmt->getStmtClassName()
-				<< " at "
-				<< stmt->getSourceRange().printToString(ctxt.getSourceManager())
-				<< "\n";
-		die();
+				<< " at " << cprint.sourceRange(stmt->getSourceRange()) << "\n";
+		fail();
+		print.ctor("Sunsupported");
+		print.str(stmt->getStmtClassName());
+		print.end_ctor();
 	}
 
 	void VisitDeclStmt(const DeclStmt *stmt, CoqPrinter &print,
@@ -190,9 +188,12 @@ public:
 		// note, this only occurs when printing the body of a switch statement
 		print.ctor("Scase");
 
+		auto lock = cprint.lock_context();
 		auto lo = stmt->getLHS()->EvaluateKnownConstInt(ctxt);
-		if (auto rhs = stmt->getRHS()) {
-			auto hi = rhs->EvaluateKnownConstInt(ctxt);
+		auto rhs = stmt->getRHS();
+		auto hi = rhs ? rhs->EvaluateKnownConstInt(ctxt) : lo;
+		lock.unlock();
+		if (rhs) {
 			guard::ctor _(print, "Range");
 			print.output() << lo << fmt::nbsp << hi;
 		} else {
@@ -351,14 +352,15 @@ public:
 	}
 };
 
-PrintStmt PrintStmt::printer;
-
 fmt::Formatter &
 ClangPrinter::printStmt(CoqPrinter &print, const clang::Stmt *stmt) {
 	if (trace(Trace::Stmt))
 		trace("printStmt", loc::of(stmt));
 	__attribute__((unused)) auto depth = print.output().get_depth();
-	PrintStmt::printer.Visit(stmt, print, *this, *this->context_);
+	{
+		stats::Scope _{stats::STMT, stmt->getStmtClassName(), print.output()};
+		PrintStmt{}.Visit(stmt, print, *this, *this->context_);
+	}
 	always_assert(depth == print.output().get_depth());
 	return print.output();
 }
@@ -7,6 +7,7 @@
 #include "ClangPrinter.hpp"
 #include "CoqPrinter.hpp"
 #include "Logging.hpp"
+#include "Stats.hpp"
 #include "TypeVisitorWithArgs.h"
 #include "config.hpp"
 #include "clang/AST/ASTContext.h"
@@ -15,31 +16,35 @@
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Mangle.h"
 #include "clang/AST/Type.h"
+#include "llvm/ADT/SmallString.h"
 #include <Formatter.hpp>
 
 using namespace clang;
 using namespace fmt;
 
-[[noreturn]] static void
+/// Report an error and fail the translation unit, printing `Tunsupported`
+static fmt::Formatter&
 fatal(CoqPrinter& print, ClangPrinter& cprint, loc::loc loc, StringRef msg) {
-	cprint.error_prefix(logging::fatal(), loc) << "error: " << msg << "\n";
+	cprint.error_prefix(logging::FATAL, loc) << "error: " << msg << "\n";
 	cprint.debug_dump(loc);
-	print.die();
+	logging::fail();
+	guard::ctor _(print, "Tunsupported", false);
+	return print.str(msg);
 }
 
 static void
 unsupported(CoqPrinter& print, ClangPrinter& cprint, loc::loc loc,
 			const Twine& msg, bool well_known = false) {
 	if (!well_known || ClangPrinter::warn_well_known) {
-		cprint.error_prefix(logging::unsupported(), loc)
+		cprint.error_prefix(logging::UNSUPPORTED, loc)
 			<< "warning: unsupported " << msg << "\n";
 		cprint.debug_dump(loc);
 	}
 	guard::ctor _(print, "Tunsupported", false);
 	{
-		std::string coqmsg;
-		llvm::raw_string_ostream os{coqmsg};
-		os << loc::describe(loc, cprint.getContext());
+		SmallString<128> coqmsg;
+		llvm::raw_svector_ostream os{coqmsg};
+		cprint.describe(os, loc);
 		print.str(coqmsg);
 	}
 }
@@ -52,16 +57,14 @@ unsupported_type(CoqPrinter& print, ClangPrinter& cprint, const Type* type,
 
 class PrintType :
 	public TypeVisitor<PrintType, void, CoqPrinter&, ClangPrinter&> {
-private:
-	PrintType() = default;
-
 public:
-	static PrintType printer;
 
 	void Visit(const Type* type, CoqPrinter& print, ClangPrinter& cprint) {
 		if (not print.reference(type))
 			TypeVisitor<PrintType, void, CoqPrinter&, ClangPrinter&>::Visit(
 				type, print, cprint);
+		else
+			stats::hit(stats::TYPE, type->getTypeClassName());
 	}
 
 	void VisitType(const Type* type, CoqPrinter& print, ClangPrinter& cprint) {
@@ -144,7 +147,7 @@ public:
 			print.ctor("@Tunary_xform", false);
 
 			print.str(getTransformName(kind));
-			print.output() << "%bs" << fmt::nbsp;
+			print.output().scope("bs") << fmt::nbsp;
 			break;
 		}
 
@@ -262,10 +265,10 @@ public:
 			if (type->isSizelessBuiltinType()) {
 				// TODO: This seems a bit random. Do we need
 				// another type constructor?
-				print.output() << fmt::lparen << "Tarch None \""
-							   << type->getNameAsCString(
-									  cprint.getContext().getPrintingPolicy())
-							   << "\"" << fmt::rparen;
+				print.output() << fmt::lparen << "Tarch None" << fmt::nbsp;
+				print.str(type->getNameAsCString(
+					cprint.getContext().getPrintingPolicy()))
+					<< fmt::rparen;
 				break;
 			} else {
 				unsupported(print, cprint, loc::of(type),
@@ -376,13 +379,12 @@ public:
 		if (ClangPrinter::debug && cprint.trace(Trace::Type)) {
 			auto loc = loc::of(type);
 			cprint.trace("printRiskyTypeComment", loc);
-			std::string cmt;
-			llvm::raw_string_ostream os{cmt};
-			auto& context = cprint.getContext();
+			SmallString<128> cmt;
+			llvm::raw_svector_ostream os{cmt};
 			os << "risky type";
 			if (loc::can_describe(loc))
-				os << ": " << loc::describe(loc, context);
-			cprint.error_prefix(logging::unsupported(), loc)
+				cprint.describe(os << ": ", loc);
+			cprint.error_prefix(logging::UNSUPPORTED, loc)
 				<< "warning: " << cmt << "\n";
 			return print.cmt(cmt);
 		} else
@@ -502,14 +504,15 @@ public:
 	}
 };
 
-PrintType PrintType::printer;
-
 fmt::Formatter&
 ClangPrinter::printType(CoqPrinter& print, const Type& type, loc::loc loc) {
 	if (trace(Trace::Type))
 		trace("printType", loc::refine(loc, type));
 	__attribute__((unused)) auto depth = print.output().get_depth();
-	PrintType::printer.Visit(&type, print, *this);
+	{
+		stats::Scope _{stats::TYPE, type.getTypeClassName(), print.output()};
+		PrintType{}.Visit(&type, print, *this);
+	}
 	always_assert(depth == print.output().get_depth());
 	return print.output();
 }
@@ -520,7 +523,7 @@ ClangPrinter::printType(CoqPrinter& print, const clang::Type* type,
 	if (type)
 		return printType(print, *type, loc);
 	else
-		fatal(print, *this, loc, "unexpected null type in printType");
+		return fatal(print, *this, loc, "unexpected null type in printType");
 }
 
 fmt::Formatter&
@@ -548,7 +551,8 @@ ClangPrinter::printQualType(CoqPrinter& print, const QualType& qt,
 		}
 		return print.output();
 	} else
-		fatal(print, *this, loc, "unexpected null type in printQualType");
+		return fatal(print, *this, loc,
+					 "unexpected null type in printQualType");
 }
 
 fmt::Formatter&
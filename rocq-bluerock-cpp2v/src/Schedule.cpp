@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "Schedule.hpp"
+#include "Logging.hpp"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <optional>
+
+namespace schedule {
+bool
+History::read(llvm::StringRef path) {
+	if (!llvm::sys::fs::exists(path))
+		return true;
+	auto fail = [&](const llvm::Twine& why) {
+		logging::stream() << path << ": " << why << "\n";
+		return false;
+	};
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer)
+		return fail(buffer.getError().message());
+	auto json = llvm::json::parse((*buffer)->getBuffer());
+	if (!json)
+		return fail(toString(json.takeError()));
+	auto root = json->getAsObject();
+	if (!root)
+		return fail("not a batch history");
+	for (auto& [job, value] : *root) {
+		auto entry = value.getAsObject();
+		auto micros = entry ? entry->getInteger("micros") : std::nullopt;
+		auto bytes = entry ? entry->getInteger("bytes") : std::nullopt;
+		if (!micros || !bytes || *micros < 0 || *bytes < 0)
+			return fail("not a batch history");
+		costs_[job.str()] = {std::uint64_t(*micros), std::uint64_t(*bytes)};
+	}
+	return true;
+}
+
+bool
+History::write(llvm::StringRef path) const {
+	std::error_code err;
+	llvm::raw_fd_ostream os{path, err};
+	if (err) {
+		logging::stream() << path << ": " << err.message() << "\n";
+		return false;
+	}
+	// In job order, so that histories diff well
+	std::vector<llvm::StringRef> jobs;
+	for (auto& entry : costs_)
+		jobs.push_back(entry.getKey());
+	llvm::sort(jobs);
+	llvm::json::OStream json{os, 1};
+	json.object([&] {
+		for (auto job : jobs) {
+			auto& cost = costs_.find(job)->second;
+			json.attributeObject(job, [&] {
+				json.attribute("micros", cost.micros);
+				json.attribute("bytes", cost.bytes);
+			});
+		}
+	});
+	os << "\n";
+	return true;
+}
+
+std::vector<Run>
+run(llvm::ArrayRef<std::string> jobs, const History& history,
+	unsigned workers, Job job) {
+	// Longest first, and unknown ones before them, in the given order
+	constexpr auto unknown = std::numeric_limits<std::uint64_t>::max();
+	auto estimate = [&](const std::string& name) {
+		auto cost = history.find(name);
+		return cost ? cost->micros : unknown;
+	};
+	std::vector<Run> runs;
+	for (auto& name : jobs)
+		runs.push_back({name});
+	std::stable_sort(runs.begin(), runs.end(),
+					 [&](const Run& a, const Run& b) {
+						 return estimate(a.job) > estimate(b.job);
+					 });
+
+	// Idle workers take the next job
+	auto start = std::chrono::steady_clock::now();
+	auto now = [&] {
+		auto time = std::chrono::steady_clock::now() - start;
+		return std::uint64_t(
+			std::chrono::duration_cast<std::chrono::microseconds>(time)
+				.count());
+	};
+	std::atomic<std::size_t> next{0};
+	auto work = [&](unsigned worker) {
+		for (auto i = next++; i < runs.size(); i = next++) {
+			auto& run = runs[i];
+			run.worker = worker;
+			run.start = now();
+			run.ok = job(run.job, run.bytes);
+			run.end = now();
+		}
+	};
+	workers = std::max(1u, std::min<unsigned>(workers, runs.size()));
+	std::vector<logging::Thread> threads;
+	for (unsigned worker = 1; worker < workers; ++worker)
+		threads.emplace_back([&work, worker] { work(worker); });
+	work(0);
+	for (auto& thread : threads)
+		(void)thread.join();
+	return runs;
+}
+
+namespace {
+llvm::raw_ostream&
+seconds(llvm::raw_ostream& os, std::uint64_t micros) {
+	return os << llvm::format("%.2fs", micros / 1e6);
+}
+}
+
+void
+summarize(llvm::raw_ostream& os, llvm::ArrayRef<Run> runs) {
+	if (runs.empty())
+		return;
+	unsigned workers = 0;
+	for (auto& run : runs)
+		workers = std::max(workers, run.worker + 1);
+	std::vector<std::uint64_t> busy(workers, 0), done(workers, 0);
+	std::uint64_t total = 0, wall = 0;
+	unsigned last = 0;
+	for (auto& run : runs) {
+		auto time = run.end - run.start;
+		busy[run.worker] += time;
+		done[run.worker] = std::max(done[run.worker], run.end);
+		total += time;
+		if (wall < run.end) {
+			wall = run.end;
+			last = run.worker;
+		}
+	}
+	std::uint64_t idle = 0;
+	for (auto end : done)
+		idle += wall - end;
+
+	os << "cpp2v: " << runs.size() << " translation units on " << workers
+	   << " threads in ";
+	seconds(os, wall) << " (";
+	seconds(os, total) << " in all)\n";
+	os << "cpp2v: critical path (";
+	seconds(os, busy[last]) << "):";
+	for (auto& run : runs)
+		if (run.worker == last) {
+			os << " " << run.job << " (";
+			seconds(os, run.end - run.start) << ")";
+		}
+	os << "\n";
+	os << "cpp2v: threads idle at the end for ";
+	seconds(os, idle) << " in all\n";
+}
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "Stats.hpp"
+#include "Formatter.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace stats {
+bool detail::enabled{false};
+
+struct Counters {
+	std::uint64_t count{0};
+	std::uint64_t bytes{0};
+	std::uint64_t ns{0};
+	std::uint64_t hits{0};
+
+	void add(const Counters& c) {
+		count += c.count;
+		bytes += c.bytes;
+		ns += c.ns;
+		hits += c.hits;
+	}
+};
+
+namespace {
+// Node class names are static strings, so a thread's table is keyed by
+// their addresses; `write` adds them up by name
+using Table = llvm::DenseMap<const char*, Counters>;
+
+std::mutex mutex;
+// The tables of the threads still running, and the totals of the others
+std::set<const Table*> live;
+std::map<std::string, Counters> totals[PRINTERS];
+
+void
+add(std::map<std::string, Counters>* into, const Table* tables) {
+	for (unsigned p = 0; p < PRINTERS; ++p)
+		for (auto& [kind, c] : tables[p])
+			into[p][kind].add(c);
+}
+
+struct Tables {
+	Table tables[PRINTERS];
+
+	Tables() {
+		std::lock_guard lock{mutex};
+		live.insert(tables);
+	}
+	~Tables() {
+		std::lock_guard lock{mutex};
+		live.erase(tables);
+		add(totals, tables);
+	}
+};
+
+Counters&
+counters(Printer printer, const char* kind) {
+	thread_local Tables mine;
+	return mine.tables[printer][kind];
+}
+
+const char*
+printer_name(unsigned printer) {
+	switch (printer) {
+	case EXPR:
+		return "expr";
+	case STMT:
+		return "stmt";
+	case TYPE:
+		return "type";
+	case DECL:
+		return "decl";
+	default:
+		return "name";
+	}
+}
+}
+
+void
+enable() {
+	detail::enabled = true;
+}
+
+void
+Scope::start(Printer printer, const char* kind) {
+	counters_ = &counters(printer, kind);
+	bytes_ = out_->tell();
+	start_ = std::chrono::steady_clock::now();
+}
+
+void
+Scope::stop() {
+	auto time = std::chrono::steady_clock::now() - start_;
+	counters_->count++;
+	counters_->bytes += out_->tell() - bytes_;
+	counters_->ns +=
+		std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+void
+hit_(Printer printer, const char* kind) {
+	counters(printer, kind).hits++;
+}
+
+void
+write(llvm::raw_ostream& os) {
+	std::map<std::string, Counters> all[PRINTERS];
+	{
+		std::lock_guard lock{mutex};
+		for (unsigned p = 0; p < PRINTERS; ++p)
+			all[p] = totals[p];
+		for (auto tables : live)
+			add(all, tables);
+	}
+
+	llvm::json::OStream json{os, 2};
+	json.object([&] {
+		for (unsigned p = 0; p < PRINTERS; ++p)
+			json.attributeObject(printer_name(p), [&] {
+				for (auto& [kind, c] : all[p])
+					json.attributeObject(kind, [&] {
+						json.attribute("count", c.count);
+						json.attribute("bytes", c.bytes);
+						json.attribute("ns", c.ns);
+						json.attribute("hits", c.hits);
+					});
+			});
+	});
+	os << "\n";
+}
+}
@@ -11,24 +11,18 @@ using namespace fmt;
 
 fmt::Formatter&
 CoqPrinter::str(llvm::StringRef str) {
-	auto& os = output_;
 	/*
 	Coq string literals may include embeded newlines
 	and utf8 sequences. We only need to double any
 	occurrences of `"`.
 	*/
-	os << '\"';
-	for (char c : str) {
-		os << c;
-		if (c == '"')
-			os << c;
-	}
-	return os << '\"';
+	return output_.quoted(str);
 }
 
 fmt::Formatter&
 CoqPrinter::cmt(llvm::StringRef str) {
-	auto& os = output_;
+	// Written past the structure of what is printed
+	auto& os = output_.nobreak();
 	os << "(* ";
 	auto b = str.begin();
 	auto n = str.size();
@@ -41,5 +35,6 @@ CoqPrinter::cmt(llvm::StringRef str) {
 				os << ' ';
 		}
 	}
-	return os << " *)";
+	os << " *)";
+	return output_;
 }
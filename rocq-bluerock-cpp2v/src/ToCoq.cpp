@@ -3,23 +3,49 @@
  * This software is distributed under the terms of the BedRock Open-Source License.
  * See the LICENSE-BedRock file in the repository root for details.
  */
+#include "Allocations.hpp"
 #include "Assert.hpp"
+#include "Binary.hpp"
 #include "ClangPrinter.hpp"
 #include "CommentScanner.hpp"
 #include "CoqPrinter.hpp"
+#include "DeclStream.hpp"
 #include "Filter.hpp"
+#include "FragmentCache.hpp"
 #include "ModuleBuilder.hpp"
+#include "ModuleIndex.hpp"
+#include "NameOrder.hpp"
+#include "Perf.hpp"
 #include "PrePrint.hpp"
 #include "SpecCollector.hpp"
+#include "TypeCheck.hpp"
+#include "Version.hpp"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/FileManager.h"
+#include "clang/Basic/Module.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Basic/TargetInfo.h"
 #include "clang/Basic/Version.inc"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/StringSaver.h"
 #include <Formatter.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <list>
+#include <memory>
+#include <optional>
+#include <vector>
 
 #include "clang/AST/ASTConsumer.h"
 #include "clang/Frontend/CompilerInstance.h"
@@ -34,15 +60,21 @@
 using namespace clang;
 using namespace fmt;
 
+/// Print to `path`, or to `buffer` if there is one.
 template<typename CLOSURE>
 void
 with_open_file(const std::optional<std::string> path,
-			   CLOSURE f /* void f(Formatter&) */) {
-	if (path.has_value()) {
+			   CLOSURE f /* void f(Formatter&) */,
+			   std::string* buffer = nullptr) {
+	if (buffer) {
+		llvm::raw_string_ostream output{*buffer};
+		Formatter fmt{output};
+		f(fmt);
+	} else if (path.has_value()) {
 		std::error_code ec;
 		llvm::raw_fd_ostream output(*path, ec);
 		if (ec.value()) {
-			llvm::errs() << *path << ": " << ec.message() << "\n";
+			logging::stream() << *path << ": " << ec.message() << "\n";
 		} else {
 			Formatter fmt{output};
 			f(fmt);
@@ -50,16 +82,335 @@ with_open_file(const std::optional<std::string> path,
 	}
 }
 
+namespace {
+/*
+With `-vv`, summarize the work that went into one output file: how many
+structured names were replayed from the `Cache` and, when built with
+`CPP2V_COUNT_ALLOCATIONS`, how many heap allocations printing its
+top-level declarations took. In that build, also check that these
+allocations stay within `allocations::within_budget`.
+*/
+class Report {
+	llvm::StringRef what_;
+	const Cache& cache_;
+	const std::size_t decls_;
+	const unsigned hits_{cache_.name_hits()};
+	const unsigned misses_{cache_.name_misses()};
+	const std::size_t allocations_{allocations::count()};
+
+public:
+	Report(llvm::StringRef what, const Cache& cache, std::size_t decls)
+		: what_{what}, cache_{cache}, decls_{decls} {}
+	Report(const Report&) = delete;
+	~Report() {
+		auto allocations = allocations::count() - allocations_;
+		logging::with(logging::VERBOSER, [&](llvm::raw_ostream& os) {
+			auto hits = cache_.name_hits() - hits_;
+			auto total = hits + cache_.name_misses() - misses_;
+			os << what_ << ": structured names printed " << total
+			   << " times, " << hits << " replayed";
+			if (total)
+				os << " (" << (100 * hits / total) << "%)";
+			os << "\n";
+			if (allocations::enabled()) {
+				os << what_ << ": " << allocations << " allocations for "
+				   << decls_ << " declarations";
+				if (decls_)
+					os << " (" << (allocations / decls_) << " per declaration)";
+				os << "\n";
+			}
+			os << what_ << ": peak resident set " << (perf::peak_rss() >> 10)
+			   << " KiB\n";
+		});
+		always_assert(allocations::within_budget(allocations, decls_) &&
+					  "allocations grow faster than the declarations printed");
+	}
+};
+
+/*
+The output files of one translation unit. Files printed with the same
+`Cache` are printed one after another, in the order they were added.
+Only when `concurrent` (with `-jobs N` for `N > 1`) are files printed
+with different caches printed on threads of their own.
+*/
+class Outputs {
+	using Task = std::function<void()>;
+	std::vector<std::pair<const Cache*, std::vector<Task>>> groups_;
+	ToCoqConsumer::Buffers* const buffers_;
+	const bool concurrent_;
+
+public:
+	/// With `buffers`, print to `(*buffers)[path]` instead of to `path`
+	Outputs(ToCoqConsumer::Buffers* buffers, bool concurrent)
+		: buffers_{buffers}, concurrent_{concurrent} {}
+
+	template<typename CLOSURE>
+	void add(const std::optional<std::string>& path, Cache& cache,
+			 CLOSURE f /* void f(Formatter&, Cache&) */) {
+		if (!path)
+			return;
+		// The concurrent tasks must not insert into `buffers_`
+		auto buffer = buffers_ ? &(*buffers_)[*path] : nullptr;
+		auto group = llvm::find_if(
+			groups_, [&](const auto& group) { return group.first == &cache; });
+		if (group == groups_.end())
+			group = groups_.insert(group, {&cache, {}});
+		group->second.push_back([path, buffer, &cache, f]() {
+			with_open_file(
+				path, [&](Formatter& fmt) { f(fmt, cache); }, buffer);
+		});
+	}
+
+	bool concurrent() const {
+		return concurrent_ && 1 < groups_.size();
+	}
+
+	void run() {
+		auto run_group = [](const std::vector<Task>& tasks) {
+			for (auto& task : tasks)
+				task();
+		};
+		if (!concurrent()) {
+			for (auto& group : groups_)
+				run_group(group.second);
+			return;
+		}
+		std::vector<logging::Thread> threads;
+		for (auto& group : groups_)
+			threads.emplace_back(
+				[&run_group, &tasks = group.second] { run_group(tasks); });
+		logging::join(threads);
+	}
+};
+}
+
 void
 printDecl(const clang::Decl* decl, CoqPrinter& print, ClangPrinter& cprint) {
 	if (cprint.withDecl(decl).printDecl(print, decl))
 		print.cons();
 }
 
+using Decls = std::vector<const clang::Decl*>;
+
+template<typename... LISTS>
+static Decls
+concat(const LISTS&... lists) {
+	Decls decls;
+	(decls.insert(decls.end(), lists.begin(), lists.end()), ...);
+	return decls;
+}
+
+/*
+The symbols `typed.decltype.check_symbol` has something to check for:
+definitions of functions and initialized variables.
+*/
+static const NamedDecl*
+checked_symbol(const clang::Decl* decl) {
+	if (auto fd = dyn_cast<FunctionDecl>(decl))
+		return fd->doesThisDeclarationHaveABody() ? fd : nullptr;
+	if (auto vd = dyn_cast<VarDecl>(decl))
+		return vd->hasInit() ? vd : nullptr;
+	return nullptr;
+}
+
+/*
+Clang's `ASTContext` computes record layouts, type sizes and destructor
+lookups on demand and caches them. Printers on several threads only do
+so under `ClangPrinter::lock_context`, and we compute the ones they
+usually ask for beforehand, so that they seldom wait for each other.
+*/
+static void
+prepare(clang::ASTContext& ctxt, const Decls& decls) {
+	for (auto ty : {ctxt.CharTy, ctxt.WCharTy, ctxt.Char8Ty, ctxt.Char16Ty,
+					ctxt.Char32Ty})
+		ctxt.getTypeSize(ty);
+	for (auto decl : decls)
+		if (auto rd = dyn_cast<CXXRecordDecl>(decl))
+			if (rd->isCompleteDefinition() && !rd->isDependentContext()) {
+				ctxt.getASTRecordLayout(rd);
+				rd->getDestructor();
+			}
+}
+
+/// A declaration printed into an arena (see `printEach`)
+struct Printed {
+	StringRef bytes;
+	/// Whether it is an element of the list (see `printDecl`)
+	bool cons{false};
+	std::uint64_t instructions{0};
+	/// The sharing names it mentions, in order of first mention
+	llvm::ArrayRef<Cache::Ref> refs;
+};
+
+/*
+Print each of `decls` into a buffer of its own, as `print` would.
+
+With `jobs > 1`, the declarations are printed on that many threads, each
+with its own `ClangPrinter` (from `mk_cprint`) and its own fork of the
+sharing cache. Declarations `streamed` printed already are not printed
+again. With `measure`, the instructions each declaration took to print
+are recorded as well.
+
+Each thread prints into a scratch buffer of its own, and copies each
+declaration from there into an arena of its own in `arenas`, which must
+outlive the result. Declarations thus take no heap buffer each.
+*/
+template<typename MK_CPRINT>
+static std::vector<Printed>
+printEach(const Decls& decls, CoqPrinter& print, ClangPrinter& cprint,
+		  unsigned jobs, MK_CPRINT mk_cprint /* ClangPrinter() */,
+		  const FragmentCache* fragments,
+		  llvm::ArrayRef<FragmentCache::Key> keys, const DeclStream* streamed,
+		  bool measure, std::vector<llvm::BumpPtrAllocator>& arenas) {
+	jobs = std::min<std::size_t>(jobs, decls.size());
+	std::vector<Printed> printed(decls.size());
+	std::atomic<std::size_t> reused{0};
+
+	/// The buffers of a thread
+	struct Scratch {
+		llvm::StringSaver saver;
+		std::string bytes;
+		Cache::Refs refs;
+	};
+
+	// Save the distinct names of `refs` with `printed[i]`
+	auto save_refs = [&](std::size_t i, Cache::Refs& refs, Scratch& scratch) {
+		llvm::DenseSet<std::pair<char, Cache::name_t>> seen;
+		llvm::erase_if(refs, [&](const Cache::Ref& ref) {
+			return !seen.insert({ref.prefix, ref.n}).second;
+		});
+		if (refs.empty())
+			return;
+		auto copy = scratch.saver.getAllocator().Allocate<Cache::Ref>(
+			refs.size());
+		std::uninitialized_copy(refs.begin(), refs.end(), copy);
+		printed[i].refs = llvm::ArrayRef(copy, refs.size());
+	};
+	auto print_decl = [&](std::size_t i, ClangPrinter& wcprint, Cache& cache,
+						  Scratch& scratch) {
+		auto decl = decls[i];
+		auto key = fragments ? keys[i] : FragmentCache::NONE;
+		auto& bytes = scratch.bytes;
+		auto& refs = scratch.refs;
+		bytes.clear();
+		refs.clear();
+		if (streamed && streamed->lookup(decl, bytes, printed[i].cons)) {
+			printed[i].bytes = scratch.saver.save(bytes);
+			return;
+		}
+		// A fragment may mention sharing names of another run
+		if (fragments &&
+			fragments->lookup(key, bytes, printed[i].cons, refs)) {
+			if (cache.defines_all(refs)) {
+				printed[i].bytes = scratch.saver.save(bytes);
+				save_refs(i, refs, scratch);
+				++reused;
+				return;
+			}
+			bytes.clear();
+			refs.clear();
+		}
+		{
+			llvm::raw_string_ostream os{bytes};
+			Formatter fmt{os};
+			CoqPrinter wprint(fmt, print.templates(), print.structured_keys(),
+							  cache);
+			Cache::Recorder recorder{cache, refs};
+			printed[i].cons = wcprint.withDecl(decl).printDecl(wprint, decl);
+		}
+		printed[i].bytes = scratch.saver.save(bytes);
+		save_refs(i, refs, scratch);
+		if (fragments)
+			fragments->store(key, bytes, printed[i].cons, printed[i].refs);
+	};
+	auto print_one = [&](std::size_t i, ClangPrinter& wcprint, Cache& cache,
+						 Scratch& scratch) {
+		auto start = measure ? perf::thread_instructions() : 0;
+		print_decl(i, wcprint, cache, scratch);
+		if (measure)
+			printed[i].instructions = perf::thread_instructions() - start;
+	};
+
+	arenas.resize(std::max(jobs, 1u));
+	if (jobs <= 1) {
+		Scratch scratch{{arenas[0]}, {}, {}};
+		for (std::size_t i = 0; i < decls.size(); ++i)
+			print_one(i, cprint, print.cache(), scratch);
+	} else {
+		std::atomic<std::size_t> next{0};
+		std::vector<Cache> caches(jobs, print.cache().fork());
+		auto work = [&](Cache& cache, llvm::BumpPtrAllocator& arena) {
+			auto wcprint = mk_cprint();
+			Scratch scratch{{arena}, {}, {}};
+			for (auto i = next++; i < decls.size(); i = next++)
+				print_one(i, wcprint, cache, scratch);
+		};
+		std::vector<logging::Thread> threads;
+		for (unsigned j = 0; j < jobs; ++j)
+			threads.emplace_back([&work, &cache = caches[j],
+								  &arena = arenas[j]] { work(cache, arena); });
+		logging::join(threads);
+		for (auto& cache : caches)
+			print.cache().join(cache);
+	}
+	if (fragments)
+		LOG(VERBOSER) << "fragment cache: reused " << reused.load() << " of "
+					  << decls.size() << " declarations\n";
+	return printed;
+}
+
+/*
+Replay `printed` (see `printEach`) as the elements of a list. With
+`index`, the byte range of each entry is recorded there, with the
+instructions it took to print.
+*/
+static void
+replayDecls(const Decls& decls, const std::vector<Printed>& printed,
+			CoqPrinter& print, ModuleIndex* index = nullptr) {
+	for (std::size_t i = 0; i < decls.size(); ++i) {
+		auto& [bytes, cons, instructions, refs] = printed[i];
+		auto begin = print.output().tell();
+		print.output().replay(bytes);
+		if (index && cons)
+			index->decl(decls[i], begin, print.output().tell(), refs,
+						instructions);
+		if (cons)
+			print.cons();
+	}
+}
+
+/*
+Print `decls` as the elements of a list.
+
+With `jobs > 1`, fragments, streamed declarations or an index, every
+declaration is printed into its own buffer (see `printEach`) and the
+buffers are replayed in order, so the output does not depend on `jobs`.
+*/
+template<typename MK_CPRINT>
+static void
+printDecls(const Decls& decls, CoqPrinter& print, ClangPrinter& cprint,
+		   unsigned jobs, MK_CPRINT mk_cprint /* ClangPrinter() */,
+		   const FragmentCache* fragments = nullptr,
+		   llvm::ArrayRef<FragmentCache::Key> keys = {},
+		   const DeclStream* streamed = nullptr,
+		   ModuleIndex* index = nullptr) {
+	if ((jobs <= 1 || decls.size() <= 1) && !fragments && !streamed &&
+		!index) {
+		for (auto decl : decls)
+			printDecl(decl, print, cprint);
+		return;
+	}
+	std::vector<llvm::BumpPtrAllocator> arenas;
+	replayDecls(decls,
+				printEach(decls, print, cprint, jobs, mk_cprint, fragments,
+						  keys, streamed, index != nullptr, arenas),
+				print, index);
+}
+
 namespace name_test {
 static void
-bug(ClangPrinter& cprint, loc::loc loc, const std::string what) {
-	cprint.error_prefix(logging::fatal(), loc) << "BUG: " << what << "\n";
+bug(ClangPrinter& cprint, loc::loc loc, StringRef what) {
+	cprint.error_prefix(logging::FATAL, loc) << "BUG: " << what << "\n";
 	cprint.debug_dump(loc);
 	logging::die();
 }
@@ -71,9 +422,12 @@ test(const clang::Decl* decl, CoqPrinter& print, ClangPrinter& cprint) {
 		return;
 	else if (decl) {
 		print.output() << fmt::line;
-		std::string cmt;
-		llvm::raw_string_ostream os{cmt};
-		os << loc::trace(loc::of(decl), cprint.getContext());
+		SmallString<128> cmt;
+		llvm::raw_svector_ostream os{cmt};
+		{
+			auto lock = cprint.lock_context();
+			os << loc::trace(loc::of(decl), cprint.getContext());
+		}
 		print.cmt(cmt) << fmt::nbsp;
 		cprint.printName(print, *decl);
 		print.output() << " ::" << fmt::line;
@@ -82,11 +436,145 @@ test(const clang::Decl* decl, CoqPrinter& print, ClangPrinter& cprint) {
 }
 }
 
+/*
+Write a Make-style rule making `targets` depend on every file entered
+while compiling the translation unit (the source file and the headers it
+includes, directly or not), to `path` or to `buffer`.
+*/
+static void
+write_depfile(const std::optional<std::string>& path,
+			  const std::vector<StringRef>& targets,
+			  const SourceManager& sources, std::string* buffer) {
+	std::vector<StringRef> deps;
+	for (auto it = sources.fileinfo_begin(); it != sources.fileinfo_end();
+		 ++it) {
+#if 18 <= CLANG_VERSION_MAJOR
+		deps.push_back(it->first.getName());
+#else
+		deps.push_back(it->first->getName());
+#endif
+	}
+	llvm::sort(deps);
+	deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+
+	with_open_file(path, [&](Formatter& fmt) {
+		auto& os = fmt.nobreak();
+		auto file = [&](StringRef name) {
+			for (auto c : name) {
+				if (c == ' ' || c == '#')
+					os << '\\';
+				else if (c == '$')
+					os << '$';
+				os << c;
+			}
+		};
+		llvm::interleave(targets, os, file, " ");
+		os << ':';
+		for (auto dep : deps) {
+			os << " \\\n  ";
+			file(dep);
+		}
+		os << '\n';
+	}, buffer);
+}
+
+/// The Coq file (without `.v`) holding the Clang module `name`
+static std::string
+import_file(StringRef name) {
+	std::string file;
+	for (auto c : name)
+		file += llvm::isAlnum(c) ? c : '_';
+	return file + "_cppm";
+}
+
+static inline bool
+starts_with(StringRef s, StringRef what) {
+#if 19 <= CLANG_VERSION_MAJOR
+	return s.starts_with(what);
+#else
+	return s.startswith(what);
+#endif
+}
+
+/*
+Write the declarations of the imported Clang module `name` to `path`,
+unless `path` already holds them: its first line records the signature
+of the module's AST file and the `options` it was printed with. Modules
+without a signature are always rewritten.
+*/
+template<typename MK_CPRINT>
+static void
+write_import(StringRef path, StringRef name, const ::Module::Import& import,
+			 StringRef options, const Decls& decls, Cache& cache,
+			 bool structured_keys, bool big_endian, unsigned jobs,
+			 MK_CPRINT mk_cprint) {
+	std::string header;
+	{
+		llvm::raw_string_ostream os{header};
+		os << "(* cpp2v import " << name << " ";
+		if (import.module->Signature)
+			os << llvm::toHex(import.module->Signature);
+		else
+			os << "-";
+		os << " " << options << " *)\n";
+	}
+	if (import.module->Signature)
+		if (auto buffer = llvm::MemoryBuffer::getFile(path);
+			buffer && starts_with((*buffer)->getBuffer(), header)) {
+			LOG(VERBOSER) << path << ": up to date\n";
+			return;
+		}
+
+	// `writeToOutput` renames a temporary file into place, so concurrent
+	// translation units importing the same module see whole files.
+	if (auto err = llvm::writeToOutput(path, [&](llvm::raw_ostream& os) {
+			os << header;
+			Formatter fmt{os};
+			CoqPrinter print(fmt, /*templates*/ false, structured_keys, cache);
+			auto cprint = mk_cprint();
+			print.output() << "Require Import bedrock.lang.cpp.parser."
+						   << fmt::line << fmt::line
+						   << "#[local] Open Scope pstring_scope."
+						   << fmt::line << fmt::line
+						   << "Definition module : translation_unit := "
+						   << fmt::indent << fmt::line
+						   << "translation_unit.check " << fmt::nbsp;
+			print.begin_list();
+			printDecls(decls, print, cprint, jobs, mk_cprint);
+			print.end_list();
+			print.output() << fmt::nbsp << (big_endian ? "Big" : "Little")
+						   << "." << fmt::outdent << fmt::line;
+			fmt.flush();
+			return llvm::Error::success();
+		}))
+		logging::stream() << path << ": " << toString(std::move(err)) << "\n";
+}
+
+void
+ToCoqConsumer::Initialize(clang::ASTContext& Context) {
+	start_instructions_ = perf::instructions();
+	start_micros_ = perf::micros();
+	parsing_.emplace("parse");
+	if (streaming_)
+		stream_ = std::make_unique<DeclStream>(
+			[this, ctxt = &Context](std::mutex& lock) {
+				return ClangPrinter(ctxt, lock, trace_, comment_, typedefs_);
+			},
+			context_lock_, structured_keys_);
+}
+
 void
 ToCoqConsumer::HandleTranslationUnit(clang::ASTContext& Context) {
+	parsing_.reset();
+	if (stream_) {
+		stream_->finish();
+		LOG(VERBOSER) << "stream: printed " << stream_->printed()
+					  << " declarations while parsing\n";
+	}
 	if (Context.getDiagnostics().getClient()->getNumErrors() == 0) {
 		toCoqModule(&Context, Context.getTranslationUnitDecl(), sharing_);
 	}
+	stream_.reset();
 }
 
 void
@@ -101,13 +589,107 @@ ToCoqConsumer::toCoqModule(clang::ASTContext* ctxt,
 	filters.push_back(&fromComment);
 	Combine<Filter::What::NOTHING, Filter::max> filter(filters);
 #endif
-	SpecCollector specs;
+	SpecCollector specs{specs_file_.has_value()};
 	Default filter(Filter::What::DEFINITION);
 
-	::Module mod(trace_);
+	::Module mod(trace_, import_dir_.has_value());
 
 	bool templates = templates_file_.has_value() || name_test_file_.has_value();
-	build_module(decl, mod, filter, specs, compiler_, elaborate_, templates);
+	{
+		perf::Phase phase{"build"};
+		build_module(decl, mod, filter, specs, compiler_, elaborate_,
+					 templates);
+	}
+
+	// Fail with Clang diagnostics before Coq would
+	if (check_types_) {
+		perf::Phase phase{"check types"};
+		if (!type_check::check(mod.definitions(), *ctxt))
+			return;
+	}
+
+	/*
+	An `ASTContext` read from an AST file or Clang modules deserializes
+	declarations, definitions and lookup tables on demand, from nearly
+	any query. We do not guard all of those, so we print such contexts
+	on one thread.
+	*/
+	unsigned jobs = jobs_;
+	if (1 < jobs && ctxt->getExternalSource()) {
+		LOG(VERBOSE) << "printing on one thread: the AST is read lazily\n";
+		jobs = 1;
+	}
+
+	auto new_cprint = [&]() {
+		return ClangPrinter(ctxt, context_lock_, trace_, comment_, typedefs_);
+	};
+
+	/*
+	A structured name prints the same way in every output that agrees on
+	`templates` and does not print sharing definitions, so those outputs
+	share `plain[templates]`. The module file gets a cache of its own when
+	it prints sharing definitions.
+
+	Sorting fills in the names of `plain`; it reports nothing when the
+	outputs print the names again, with sharing definitions or structure.
+	*/
+	Cache plain[2], shared{stable_sharing_};
+	Cache& module_cache = sharing ? shared : plain[false];
+
+	Decls decls, template_decls;
+	if (output_file_ || binary_file_) {
+		perf::Phase phase{"sort"};
+		auto cprint = new_cprint();
+		bool quiet = sharing || binary_file_;
+		decls = concat(name_order::sort(mod.declarations(), mod.definitions(),
+										cprint, plain[false],
+										/*templates*/ false, quiet),
+					   mod.asserts());
+	}
+	// What printed forms reused across runs depend on, besides the source
+	std::string options;
+	{
+		llvm::raw_string_ostream os{options};
+		os << cpp2v::VERSION << ' ' << ctxt->getTargetInfo().getTriple().str()
+		   << ' ' << structured_keys_ << comment_ << typedefs_ << elaborate_;
+	}
+
+	/*
+	Fragments must not mention the sharing definitions of another run, so
+	the module file only reuses them when it prints none or only stable
+	ones.
+	*/
+	std::optional<FragmentCache> fragments;
+	std::vector<FragmentCache::Key> fragment_keys;
+	if (fragment_dir_ && !decls.empty()) {
+		fragments.emplace(*fragment_dir_,
+						  options + (stable_sharing_ ? "1" : "0"));
+		auto cprint = new_cprint();
+		fragment_keys = fragments->keys(decls, cprint, plain[false]);
+	}
+	auto reuse = [&](bool sharing) -> const FragmentCache* {
+		return fragments && (!sharing || stable_sharing_) ? &*fragments
+														  : nullptr;
+	};
+
+	// The stream printed declarations without sharing definitions
+	if (stream_ && output_file_ && !sharing) {
+		auto cprint = new_cprint();
+		stream_->validate(decls, cprint);
+	}
+	auto streamed = [&](bool sharing) -> const DeclStream* {
+		return sharing ? nullptr : stream_.get();
+	};
+
+	if (templates_file_) {
+		auto cprint = new_cprint();
+		template_decls =
+			concat(name_order::sort(mod.template_declarations(),
+									mod.template_definitions(), cprint,
+									plain[true], /*templates*/ true));
+	}
+
+	Outputs outputs{buffers_, /*concurrent*/ 1 < jobs};
 
 	auto parser = [&](CoqPrinter& print) -> auto& {
 		StringRef coqmod(print.templates() ? "bedrock.lang.cpp.mparser" :
@@ -120,86 +702,264 @@ ToCoqConsumer::toCoqModule(clang::ASTContext* ctxt,
 		return print.output() << "#[local] Open Scope pstring_scope." << fmt::line;
 	};
 
-	with_open_file(
-		output_file_, [&](Formatter& fmt) {
+	/*
+	The Coq names of the files holding the imported Clang modules, which
+	the module file includes instead of their declarations.
+	*/
+	std::vector<std::string> imports;
+	if (output_file_ && !mod.imports().empty()) {
+		if (auto err = llvm::sys::fs::create_directories(*import_dir_))
+			logging::stream() << *import_dir_ << ": " << err.message() << "\n";
+		for (auto& [name, import] : mod.imports()) {
+			auto file = import_file(name);
+			SmallString<128> path{*import_dir_};
+			llvm::sys::path::append(path, file + ".v");
+			auto cprint = new_cprint();
 			Cache cache;
+			write_import(path, name, import, options,
+						 name_order::sort(import.declarations,
+										  import.definitions, cprint, cache),
+						 cache, structured_keys_,
+						 ctxt->getTargetInfo().isBigEndian(), jobs,
+						 new_cprint);
+			imports.push_back(import_prefix_.empty()
+								  ? file
+								  : import_prefix_ + "." + file);
+		}
+	}
+
+	/*
+	The index of the module file, also for its costs. It keys a
+	declaration by its structured name printed without sharing names, so
+	that the key means the same thing in every file.
+	*/
+	std::optional<ModuleIndex> index;
+	std::optional<ClangPrinter> key_cprint;
+	if (output_file_ && (index_file_ || (perf_file_ && perf::enabled()))) {
+		key_cprint.emplace(new_cprint());
+		index.emplace([&](const Decl* decl) {
+			std::string key;
+			if (auto nd = dyn_cast<NamedDecl>(decl)) {
+				llvm::raw_string_ostream os{key};
+				Formatter kfmt{os};
+				Cache kcache;
+				CoqPrinter kprint(kfmt, /*templates*/ false, structured_keys_,
+								  kcache);
+				key_cprint->withDecl(nd).printName(kprint, *nd);
+			}
+			return key;
+		});
+	}
+
+	/*
+	The binary file is encoded from the structure of the translation unit
+	as it is printed (see `binary::Reader`), which the printed forms of
+	`printEach` do not keep, so it prints each declaration directly and
+	without sharing definitions. When the module file prints them that
+	way too (through `plain[false]`, and before the binary file), it
+	passes the structure on to the binary file, which does not print the
+	translation unit again.
+	*/
+	binary::Encoder encoder;
+	binary::Reader reader{encoder, logging::FATAL};
+	const bool tee = binary_file_ && output_file_ && !sharing && jobs <= 1 &&
+					 !fragments && !stream_ && !index;
+
+	/*
+	`sharing` says whether the file prints sharing definitions, which
+	limits the printed forms it can reuse. The binary file reuses none.
+	*/
+	auto translation_unit = [&](CoqPrinter& print, ClangPrinter& cprint,
+								bool sharing, ModuleIndex* index = nullptr,
+								bool binary = false) -> auto& {
+		print.output() << "translation_unit.check " << fmt::nbsp;
+		print.begin_list();
+		for (auto& import : imports) {
+			print.output() << "translation_unit._include " << import
+						   << ".module";
+			print.cons();
+		}
+		if (binary)
+			printDecls(decls, print, cprint, /*jobs*/ 1, new_cprint);
+		else
+			printDecls(decls, print, cprint, jobs, new_cprint, reuse(sharing),
+					   fragment_keys, streamed(sharing), index);
+		print.end_list();
+		print.output() << fmt::nbsp;
+		if (ctxt->getTargetInfo().isBigEndian()) {
+			return print.output() << "Big";
+		} else {
+			always_assert(ctxt->getTargetInfo().isLittleEndian());
+			return print.output() << "Little";
+		}
+	};
+
+	outputs.add(
+		output_file_, module_cache, [&](Formatter& fmt, Cache& cache) {
+			Report report(*output_file_, cache, decls.size());
 			CoqPrinter print(fmt, /*templates*/ false, structured_keys_, cache);
-			ClangPrinter cprint(compiler_, ctxt, trace_, comment_, typedefs_);
+			ClangPrinter cprint(ctxt, context_lock_, trace_, comment_,
+								typedefs_);
 
 			parser(print);
+			for (auto& import : imports)
+				print.output() << "Require " << import << "." << fmt::line;
 			bytestring(print) << fmt::line;
+			if (index)
+				index->header(print.output().tell());
 
 			if (sharing) {
-				auto preprint = [&](const Decl* decl) {
-					auto cp = cprint.withDecl(decl);
-					PRINTER<clang::Type> type_fn = [&](auto prefix, auto num,
-													   auto* type) {
-						print.output() << "#[local] Definition " << prefix
-									   << num << " : type := ";
-						cp.printType(print, type, loc::of(type));
-						print.output() << "." << fmt::line;
+				/*
+				The sharing definitions are printed into `defs` first: the
+				names of colliding stable names are only settled once all
+				of them are known (see `Cache::resolve_collisions`).
+				*/
+				struct Shared {
+					std::string name;
+					std::uint64_t begin, end;
+					Cache::Refs refs;
+				};
+				std::string defs;
+				std::vector<Shared> shared;
+				do {
+					defs.clear();
+					shared.clear();
+					llvm::raw_string_ostream dos{defs};
+					Formatter dfmt{dos};
+
+					/*
+					Print the definition of a sharing name for `p` (unless
+					the cache already has one for its contents), and return
+					it.
+					*/
+					auto define = [&](char prefix, StringRef sort, auto* p,
+									  auto print_body) -> Cache::name_t {
+						std::string body;
+						Cache::Refs refs;
+						{
+							llvm::raw_string_ostream os{body};
+							Formatter bfmt{os};
+							CoqPrinter bprint(bfmt, /*templates*/ false,
+											  structured_keys_, cache);
+							Cache::Recorder recorder{cache, refs};
+							print_body(bprint);
+						}
+						auto [num, fresh] = cache.fresh(p, body);
+						if (fresh) {
+							auto begin = dfmt.tell();
+							dfmt << "#[local] Definition " << prefix << num
+								 << " : " << sort << " := ";
+							dfmt.replay(body);
+							dfmt << "." << fmt::line;
+							if (index)
+								shared.push_back({prefix + std::to_string(num),
+												  begin, dfmt.tell(),
+												  std::move(refs)});
+						}
+						return num;
 					};
-					PRINTER<clang::NamedDecl> name_fn =
-						[&](auto prefix, auto num, auto* decl) {
-							print.output() << "#[local] Definition " << prefix
-										   << num << " : name := ";
-							cp.printName(print, decl, loc::of(decl));
-							print.output() << "." << fmt::line;
+					auto preprint = [&](const Decl* decl) {
+						auto cp = cprint.withDecl(decl);
+						PRINTER<clang::Type> type_fn = [&](auto prefix,
+														   auto* type) {
+							return define(prefix, "type", type,
+										  [&](auto& bprint) {
+											  cp.printType(bprint, type,
+														   loc::of(type));
+										  });
 						};
-					prePrintDecl(decl, cache, type_fn, name_fn);
-				};
+						PRINTER<clang::NamedDecl> name_fn = [&](auto prefix,
+																auto* decl) {
+							return define(prefix, "name", decl,
+										  [&](auto& bprint) {
+											  cp.printName(bprint, decl,
+														   loc::of(decl));
+										  });
+						};
+						prePrintDecl(decl, cache, type_fn, name_fn);
+					};
 
-				for (auto decl : mod.declarations()) {
-					preprint(decl);
-				}
-				for (auto decl : mod.definitions()) {
-					preprint(decl);
-				}
+					// In the order of `decls`, which does not depend on
+					// where declarations appear in the source
+					for (auto decl : decls)
+						preprint(decl);
+				} while (cache.resolve_collisions());
+
+				auto base = print.output().tell();
+				print.output().replay(defs);
+				if (index)
+					for (auto& def : shared)
+						index->shared(std::move(def.name), base + def.begin,
+									  base + def.end, def.refs);
 				print.output() << fmt::line;
 			}
 
 			print.output() << "Definition module : translation_unit := "
-						   << fmt::indent << fmt::line
-						   << "translation_unit.check " << fmt::nbsp;
-
-			print.begin_list();
-			for (auto decl : mod.declarations()) {
-				printDecl(decl, print, cprint);
-			}
-			for (auto decl : mod.definitions()) {
-				printDecl(decl, print, cprint);
-			}
-			for (auto decl : mod.asserts()) {
-				printDecl(decl, print, cprint);
-			}
-			print.end_list();
-			print.output() << fmt::nbsp;
-			if (ctxt->getTargetInfo().isBigEndian()) {
-				print.output() << "Big";
-			} else {
-				always_assert(ctxt->getTargetInfo().isLittleEndian());
-				print.output() << "Little";
-			}
+						   << fmt::indent << fmt::line;
+			if (tee)
+				print.output().set_structure(&reader);
+			translation_unit(print, cprint, sharing,
+							 index ? &*index : nullptr);
+			print.output().set_structure(nullptr);
 
 			// TODO I still need to generate the initializer
 
 			print.output() << "." << fmt::outdent << fmt::line;
+			if (index && index_file_)
+				index->write(*index_file_, *output_file_,
+							 ctxt->getTargetInfo().isBigEndian());
 
 			if (check_types_) {
 				print.output()
 					<< fmt::line << "Require bedrock.lang.cpp.syntax.typed."
-					<< fmt::line
-					<< "Succeed Example well_typed : "
-					   "typed.decltype.check_tu module = trace.Success tt"
-					   " := ltac:(vm_compute; reflexivity)."
 					<< fmt::line;
+				auto example = [&](auto check) {
+					print.output() << "Succeed Example well_typed : "
+									  "typed.decltype.";
+					check();
+					print.output() << " = trace.Success tt"
+									  " := ltac:(vm_compute; reflexivity)."
+								   << fmt::line;
+				};
+				if (check_decls_ && structured_keys_) {
+					for (auto decl : decls)
+						if (auto nd = checked_symbol(decl))
+							example([&] {
+								print.output() << "check_symbol module ";
+								cprint.withDecl(nd).printName(print, *nd);
+							});
+				} else
+					example([&] { print.output() << "check_tu module"; });
 			}
 		});
 
-	with_open_file(notations_file_, [&](Formatter& spec_fmt) {
-		Cache c;
-		CoqPrinter print(spec_fmt, /*templates*/ false, structured_keys_, c);
-		ClangPrinter cprint(compiler_, ctxt, trace_, comment_, typedefs_);
+	/*
+	The binary file needs no sharing definitions: encoding it shares
+	identical subterms anyway.
+	*/
+	outputs.add(binary_file_, plain[false], [&](Formatter& fmt, Cache& c) {
+		Report report(*binary_file_, c, decls.size());
+		if (!tee) {
+			Formatter term_fmt{llvm::nulls()};
+			term_fmt.set_structure(&reader);
+			CoqPrinter print(term_fmt, /*templates*/ false, structured_keys_,
+							 c);
+			ClangPrinter cprint(ctxt, context_lock_, trace_, comment_,
+								typedefs_);
+			translation_unit(print, cprint, /*sharing*/ false, nullptr,
+							 /*binary*/ true);
+		}
+		auto root = reader.finish();
+		if (!root)
+			return logging::fail();
+		encoder.emit(fmt.flush(), *root);
+	});
+
+	outputs.add(notations_file_, plain[false], [&](Formatter& fmt, Cache& c) {
+		Report report(*notations_file_, c,
+					  mod.declarations().size() + mod.definitions().size());
+		CoqPrinter print(fmt, /*templates*/ false, structured_keys_, c);
+		ClangPrinter cprint(ctxt, context_lock_, trace_, comment_, typedefs_);
 		// PrintSpec printer(ctxt);
 
 		NoInclude source(ctxt->getSourceManager());
@@ -207,43 +967,51 @@ ToCoqConsumer::toCoqModule(clang::ASTContext* ctxt,
 		parser(print);
 
 		// generate all of the record fields
-		write_globals(mod, print, cprint);
+		write_globals(mod, print, cprint, names_filter_);
+	});
+
+	outputs.add(specs_file_, plain[false], [&](Formatter& fmt, Cache& c) {
+		Report report(*specs_file_, c, specs.size());
+		CoqPrinter print(fmt, /*templates*/ false, structured_keys_, c);
+		ClangPrinter cprint(ctxt, context_lock_, trace_, comment_, typedefs_);
+		write_spec(specs, print, cprint, *ctxt);
 	});
 
-	with_open_file(templates_file_, [&](Formatter& fmt) {
-		Cache c;
+	outputs.add(templates_file_, plain[true], [&](Formatter& fmt, Cache& c) {
+		Report report(*templates_file_, c, template_decls.size());
 		CoqPrinter print(fmt, /*templates*/ true, structured_keys_, c);
-		ClangPrinter cprint(compiler_, ctxt, trace_, comment_, typedefs_);
+		ClangPrinter cprint(ctxt, context_lock_, trace_, comment_, typedefs_);
 
 		parser(print);
 		bytestring(print) << fmt::line;
 
-		print.output()
-			<< "Definition templates : Mtranslation_unit :=" << fmt::indent
-			<< fmt::line
-			<< "Eval reduce_translation_unit in Mtranslation_unit.decls"
-			<< fmt::nbsp;
+		/*
+		The entries are sorted by name, so `Mtranslation_unit.decls` builds
+		each table in linear time (with `raw_of_sorted`), and the definition
+		need not be reduced when it is loaded.
+		*/
+		print.output() << "Definition templates : Mtranslation_unit :="
+					   << fmt::indent << fmt::line << "Mtranslation_unit.decls"
+					   << fmt::nbsp;
 
 		print.begin_list();
-		for (auto decl : mod.template_declarations()) {
-			// if (sharing)
-			// 	prePrintDecl(decl, c, print, cprint);
-			printDecl(decl, print, cprint);
-		}
-		for (auto decl : mod.template_definitions()) {
-			printDecl(decl, print, cprint);
-		}
+		// if (sharing)
+		// 	prePrintDecl(decl, c, print, cprint);
+		printDecls(template_decls, print, cprint, jobs, new_cprint);
 		print.end_list();
 
 		print.output() << "." << fmt::outdent << fmt::line;
 	});
 
-	with_open_file(name_test_file_, [&](Formatter& fmt) {
-		Cache c;
+	outputs.add(name_test_file_, plain[true], [&](Formatter& fmt, Cache& c) {
+		Report report(*name_test_file_, c,
+					  mod.declarations().size() + mod.definitions().size() +
+						  mod.template_declarations().size() +
+						  mod.template_definitions().size());
 		CoqPrinter print(fmt, /*templates*/ true, /*structured_keys*/ true, c);
-		ClangPrinter cprint(compiler_, ctxt, trace_, comment_);
+		ClangPrinter cprint(ctxt, context_lock_, trace_, comment_);
 
-		auto testnames = [&](const std::string id,
+		auto testnames = [&](StringRef id,
 							 std::function<void()> k) -> auto& {
 			print.output() << fmt::line << "Definition " << id
 						   << " : list Mname :=" << fmt::indent << fmt::line;
@@ -273,4 +1041,41 @@ ToCoqConsumer::toCoqModule(clang::ASTContext* ctxt,
 			}
 		});
 	});
+
+	if (1 < jobs) {
+		prepare(*ctxt, decls);
+		prepare(*ctxt, template_decls);
+		specs.parse(*ctxt);
+	}
+	{
+		perf::Phase phase{"print"};
+		outputs.run();
+		for (auto path : {&output_file_, &notations_file_, &templates_file_,
+						  &name_test_file_, &specs_file_, &binary_file_})
+			if (*path && !buffers_) {
+				std::uint64_t size{0};
+				if (!llvm::sys::fs::file_size(**path, size))
+					phase.meta(**path, size);
+			}
+	}
+
+	if (perf_file_ && perf::enabled() && index) {
+		std::uint64_t size{0};
+		llvm::sys::fs::file_size(*output_file_, size);
+		index->write_costs(*perf_file_, *output_file_,
+						   {perf::instructions() - start_instructions_,
+							perf::micros() - start_micros_, perf::peak_rss(),
+							size});
+	}
+
+	if (dep_file_) {
+		std::vector<StringRef> targets;
+		for (auto path : {&output_file_, &notations_file_, &templates_file_,
+						  &name_test_file_, &specs_file_, &index_file_,
+						  &perf_file_, &binary_file_})
+			if (*path)
+				targets.push_back(**path);
+		write_depfile(dep_file_, targets, ctxt->getSourceManager(),
+					  buffers_ ? &(*buffers_)[*dep_file_] : nullptr);
+	}
 }
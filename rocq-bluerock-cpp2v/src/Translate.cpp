@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "Translate.hpp"
+#include "ToCoq.hpp"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace cpp2v {
+namespace {
+/*
+A consumer printing the files `options` asks for into `buffers`, by
+made-up paths (see `collect`). `compiler` may be null if `elaborate` is
+false.
+*/
+std::unique_ptr<ToCoqConsumer>
+consumer(clang::CompilerInstance* compiler, bool elaborate,
+		 const Options& options, ToCoqConsumer::Buffers& buffers) {
+	auto path = [](bool wanted, const char* name) -> ToCoqConsumer::path {
+		if (wanted)
+			return name;
+		return std::nullopt;
+	};
+	return std::make_unique<ToCoqConsumer>(
+		compiler, path(options.module, "module"),
+		path(options.names, "names"), path(options.templates, "templates"),
+		path(options.name_test, "name_test"), /*specs_file*/ std::nullopt,
+		/*index_file*/ std::nullopt, /*perf_file*/ std::nullopt,
+		path(options.binary, "binary"),
+		path(options.dependencies, "dependencies"),
+		/*fragment_dir*/ std::nullopt,
+		/*import_dir*/ std::nullopt, /*import_prefix*/ "",
+		/*names_filter*/ {},
+		options.structured_keys, Trace::NONE, options.comment,
+		options.sharing, options.stable_sharing, options.check_types,
+		/*check_decls*/ false, /*stream*/ false, elaborate,
+		options.typedefs, options.jobs, &buffers);
+}
+
+/// Move the printed files to `result`
+void
+collect(ToCoqConsumer::Buffers& buffers, Result& result) {
+	// Nothing is printed after Clang errors
+	result.ok = result.ok && !buffers.empty();
+	result.module = std::move(buffers["module"]);
+	result.names = std::move(buffers["names"]);
+	result.templates = std::move(buffers["templates"]);
+	result.name_test = std::move(buffers["name_test"]);
+	result.binary = std::move(buffers["binary"]);
+	result.dependencies = std::move(buffers["dependencies"]);
+}
+
+class TranslateAction : public clang::ASTFrontendAction {
+	const Options& options_;
+	ToCoqConsumer::Buffers& buffers_;
+
+public:
+	TranslateAction(const Options& options, ToCoqConsumer::Buffers& buffers)
+		: options_{options}, buffers_{buffers} {}
+
+	std::unique_ptr<clang::ASTConsumer>
+	CreateASTConsumer(clang::CompilerInstance& compiler,
+					  llvm::StringRef) override {
+		return consumer(&compiler, /*elaborate*/ true, options_, buffers_);
+	}
+};
+
+class TranslateActionFactory : public clang::tooling::FrontendActionFactory {
+	const Options& options_;
+	ToCoqConsumer::Buffers& buffers_;
+
+public:
+	TranslateActionFactory(const Options& options,
+						   ToCoqConsumer::Buffers& buffers)
+		: options_{options}, buffers_{buffers} {}
+
+	std::unique_ptr<clang::FrontendAction> create() override {
+		return std::make_unique<TranslateAction>(options_, buffers_);
+	}
+};
+}
+
+Result
+translate(clang::ASTContext& ctxt, const Options& options) {
+	ToCoqConsumer::Buffers buffers;
+	auto tocoq = consumer(/*compiler*/ nullptr, /*elaborate*/ false, options,
+						  buffers);
+
+	Result result;
+	{
+		llvm::raw_string_ostream log{result.log};
+		logging::Scope scope{{options.log_level, &log}};
+		tocoq->HandleTranslationUnit(ctxt);
+		result.ok = !logging::failed();
+	}
+	collect(buffers, result);
+	return result;
+}
+
+Result
+translate_file(const std::string& file, const std::vector<std::string>& args,
+			   const Options& options) {
+	ToCoqConsumer::Buffers buffers;
+	Result result;
+	{
+		llvm::raw_string_ostream log{result.log};
+		logging::Scope scope{{options.log_level, &log}};
+		clang::tooling::FixedCompilationDatabase compilations{".", args};
+		// With a file system of its own, as the tool changes its working
+		// directory
+		clang::tooling::ClangTool tool(
+			compilations, {file},
+			std::make_shared<clang::PCHContainerOperations>(),
+			llvm::vfs::createPhysicalFileSystem());
+		auto diag_options = new clang::DiagnosticOptions();
+		clang::TextDiagnosticPrinter diagnostics{log, diag_options};
+		tool.setDiagnosticConsumer(&diagnostics);
+		TranslateActionFactory factory{options, buffers};
+		result.ok = tool.run(&factory) == 0 && !logging::failed();
+	}
+	collect(buffers, result);
+	return result;
+}
+}
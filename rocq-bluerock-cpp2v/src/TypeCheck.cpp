@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2024 BlueRock Security, Inc.
+ * This software is distributed under the terms of the BedRock Open-Source License.
+ * See the LICENSE-BedRock file in the repository root for details.
+ */
+#include "TypeCheck.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/StmtVisitor.h"
+#include "clang/Basic/Diagnostic.h"
+
+using namespace clang;
+
+namespace type_check {
+namespace {
+
+/*
+Each check mirrors a case of `decltype.internal.of_expr_body` or
+`decltype.internal.of_cast`; the messages follow theirs.
+*/
+class Checker : public ConstStmtVisitor<Checker, void> {
+	using Visitor = ConstStmtVisitor<Checker, void>;
+
+	ASTContext& ctxt_;
+	DiagnosticsEngine& diags_;
+	const unsigned id_;
+	bool ok_{true};
+
+	void error(const Expr* expr, StringRef what) {
+		diags_.Report(expr->getExprLoc(), id_) << what << expr->getType();
+		ok_ = false;
+	}
+
+	static bool integral(QualType t) {
+		return t->isIntegralOrUnscopedEnumerationType();
+	}
+	static bool floating(QualType t) {
+		return t->isRealFloatingType();
+	}
+
+	/*
+	`supports_inc_dec`: the (unqualified) types `cpp2v` prints as `Tnum`,
+	`Tchar_`, `Tfloat_` or `Tptr`. This excludes `bool`, enumerations
+	(which C, unlike C++, can increment), atomics and `_BitInt`.
+	*/
+	static bool supports_inc_dec(QualType t) {
+		if (t.isConstQualified() || t.isVolatileQualified())
+			return false;
+		t = t.getCanonicalType();
+		if (t->isPointerType())
+			return true;
+		auto bt = t->getAs<BuiltinType>();
+		return bt && bt->getKind() != BuiltinType::Bool &&
+			   (bt->isInteger() || bt->isFloatingPoint());
+	}
+
+	void cast(const CastExpr* expr) {
+		auto sub = expr->getSubExpr();
+		auto to = expr->getType();
+		auto from = sub->getType();
+		switch (expr->getCastKind()) {
+		case CK_LValueToRValue:
+			if (!sub->isGLValue())
+				return error(expr, "l2r cast of a prvalue");
+			if (!ctxt_.hasSameUnqualifiedType(to, from))
+				return error(expr, "l2r cast changes the type");
+			return;
+		case CK_ArrayToPointerDecay: {
+			if (ctxt_.getLangOpts().CPlusPlus && !sub->isGLValue())
+				return error(expr, "array2ptr cast of a prvalue");
+			auto at = ctxt_.getAsArrayType(from);
+			auto pt = to->getAs<PointerType>();
+			if (!at || !pt ||
+				!ctxt_.hasSameType(pt->getPointeeType(), at->getElementType()))
+				return error(expr, "array2ptr cast to the wrong type");
+			return;
+		}
+		case CK_FunctionToPointerDecay: {
+			auto pt = to->getAs<PointerType>();
+			if (!from->isFunctionType() || !pt ||
+				!ctxt_.hasSameType(pt->getPointeeType(), from))
+				return error(expr, "fun2ptr cast to the wrong type");
+			return;
+		}
+		case CK_PointerToBoolean:
+		case CK_IntegralToBoolean:
+		case CK_FloatingToBoolean:
+		case CK_MemberPointerToBoolean:
+			if (!to->isBooleanType())
+				return error(expr, "bool cast to a non-bool type");
+			return;
+		case CK_NullToPointer:
+			if (!from->isNullPtrType() && !from->isIntegerType())
+				return error(expr, "source of null2ptr cast must be nullptr "
+								   "or integral type");
+			if (!to->isAnyPointerType() && !to->isBlockPointerType() &&
+				!to->isNullPtrType())
+				return error(expr,
+							 "destination of null2ptr cast must be a pointer");
+			return;
+		case CK_FloatingToIntegral:
+			if (!floating(from) || !integral(to))
+				return error(expr, "float2int cast between the wrong types");
+			return;
+		case CK_IntegralToFloating:
+			if (!integral(from) || !floating(to))
+				return error(expr, "int2float cast between the wrong types");
+			return;
+		case CK_FloatingCast:
+			if (!floating(from) || !floating(to))
+				return error(expr, "floating point required");
+			return;
+		case CK_ToVoid:
+			if (!to->isVoidType())
+				return error(expr, "void cast to a non-void type");
+			return;
+		case CK_DerivedToBase:
+		case CK_UncheckedDerivedToBase:
+		case CK_BaseToDerived: {
+			if (to->isPointerType() != from->isPointerType())
+				return error(expr, "class cast between a pointer and an object");
+			if (to->isPointerType())
+				return;
+			auto bvc = sub->getValueKind();
+			auto rvc = expr->getValueKind();
+			if (!sub->isGLValue() || !expr->isGLValue() ||
+				!(bvc == rvc || (bvc == VK_LValue && rvc == VK_XValue)))
+				return error(expr, "class cast changes the value category");
+			return;
+		}
+		default:
+			return;
+		}
+	}
+
+public:
+	Checker(ASTContext& ctxt)
+		: ctxt_{ctxt}, diags_{ctxt.getDiagnostics()},
+		  id_{diags_.getCustomDiagID(DiagnosticsEngine::Error,
+									 "type check: %0 (at type %1)")} {}
+
+	bool ok() const {
+		return ok_;
+	}
+
+	void Visit(const Stmt* stmt) {
+		if (!stmt)
+			return;
+		if (auto expr = dyn_cast<Expr>(stmt))
+			if (expr->isInstantiationDependent())
+				return;
+		Visitor::Visit(stmt);
+		for (auto child : stmt->children())
+			Visit(child);
+	}
+
+	void VisitStmt(const Stmt*) {}
+
+	void VisitCastExpr(const CastExpr* expr) {
+		cast(expr);
+	}
+
+	void VisitIntegerLiteral(const IntegerLiteral* expr) {
+		/*
+		`Eint` admits the integer types `cpp2v` prints as `Tnum` (and the
+		character types). `cpp2v` reports `_BitInt` types as unsupported
+		when it prints them.
+		*/
+		auto t = expr->getType();
+		if (t->isBitIntType())
+			return;
+		auto bt = t->getAs<BuiltinType>();
+		switch (bt ? bt->getKind() : BuiltinType::Void) {
+		case BuiltinType::Char_S:
+		case BuiltinType::Char_U:
+		case BuiltinType::SChar:
+		case BuiltinType::UChar:
+		case BuiltinType::Short:
+		case BuiltinType::UShort:
+		case BuiltinType::Int:
+		case BuiltinType::UInt:
+		case BuiltinType::Long:
+		case BuiltinType::ULong:
+		case BuiltinType::LongLong:
+		case BuiltinType::ULongLong:
+		case BuiltinType::Int128:
+		case BuiltinType::UInt128:
+			return;
+		default:
+			return error(expr, "integer literal of a non-standard type");
+		}
+	}
+
+	void VisitUnaryOperator(const UnaryOperator* expr) {
+		auto sub = expr->getSubExpr();
+		auto t = sub->getType();
+		switch (expr->getOpcode()) {
+		case UO_Deref: {
+			auto pt = t->getAs<PointerType>();
+			if (!pt)
+				return error(expr, "dereference of a non-pointer");
+			if (!ctxt_.hasSameType(pt->getPointeeType(), expr->getType()))
+				return error(expr, "dereference at the wrong type");
+			return;
+		}
+		case UO_PreInc:
+		case UO_PreDec:
+		case UO_PostInc:
+		case UO_PostDec:
+			if (!sub->isLValue())
+				return error(expr, "increment or decrement of a non-lvalue");
+			if (!supports_inc_dec(t))
+				return error(expr,
+							 "increment or decrement of a non-arithmetic type");
+			return;
+		default:
+			return;
+		}
+	}
+
+	void VisitBinaryOperator(const BinaryOperator* expr) {
+		auto lhs = expr->getLHS();
+		auto rhs = expr->getRHS();
+		auto lt = lhs->getType();
+		if (expr->getOpcode() == BO_Assign) {
+			if (!lhs->isLValue() || !rhs->isPRValue())
+				return error(expr, "assignment of the wrong value categories");
+			if (lt.isConstQualified())
+				return error(expr, "assignment to a const");
+			if (!lt->isAtomicType() &&
+				!ctxt_.hasSameUnqualifiedType(lt, rhs->getType()))
+				return error(expr, "assignment at different types");
+		} else if (expr->isCompoundAssignmentOp()) {
+			if (!lhs->isLValue())
+				return error(expr, "assignment to a non-lvalue");
+			if (lt.isVolatileQualified())
+				return error(expr, "compound assignment to a volatile");
+		}
+	}
+};
+}
+
+bool
+check(const ::Module::DeclList& definitions, ASTContext& ctxt) {
+	Checker checker{ctxt};
+	for (auto decl : definitions) {
+		// dependent code is only checked after instantiation
+		if (decl->isInvalidDecl() || decl->isTemplated())
+			continue;
+		if (auto fd = dyn_cast<FunctionDecl>(decl)) {
+			if (auto cd = dyn_cast<CXXConstructorDecl>(fd))
+				for (auto init : cd->inits())
+					checker.Visit(init->getInit());
+			checker.Visit(fd->getBody());
+		} else if (auto vd = dyn_cast<VarDecl>(decl))
+			checker.Visit(vd->getInit());
+	}
+	return checker.ok();
+}
+}
@@ -12,7 +12,10 @@
 #include "clang/AST/ASTConsumer.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Sema/Sema.h"
+#include <algorithm>
 #include <optional>
+#include <thread>
 
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
@@ -20,10 +23,19 @@
 #include "clang/Frontend/FrontendActions.h"
 // Declares llvm::cl::extrahelp.
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/ADT/SmallString.h"
 
 #include "Logging.hpp"
+#include "ModuleIndex.hpp"
+#include "Perf.hpp"
+#include "Schedule.hpp"
+#include "Stats.hpp"
 #include "ToCoq.hpp"
 #include "Trace.hpp"
+#include "Translate.hpp"
 #include "Version.hpp"
 
 using namespace clang;
@@ -38,13 +50,24 @@ static cl::OptionCategory Cpp2V("cpp2v options");
 // command-line options related to the compilation database and input files.
 // It's nice to have this help message in all tools.
 static cl::extrahelp CommonHelp(
-	"\nACTUAL USAGE: cpp2v [cpp2v options] <source> -- [clang options]\n");
+	"\nACTUAL USAGE: cpp2v [cpp2v options] <source> -- [clang options]\n"
+	"\n<source> can also be an AST file from `clang -emit-ast` (or a PCH).\n");
 
 static cl::opt<std::string> NamesFile("names",
 									  cl::desc("print notation for C++ names"),
 									  cl::value_desc("filename"), cl::Optional,
 									  cl::cat(Cpp2V));
 
+static cl::opt<bool> NamesMainFile(
+	"names-main-file",
+	cl::desc("only print notations for names declared in the main file"),
+	cl::Optional, cl::cat(Cpp2V));
+
+static cl::list<std::string> NamesNamespace(
+	"names-namespace",
+	cl::desc("only print notations for names in this namespace (repeatable)"),
+	cl::value_desc("namespace"), cl::cat(Cpp2V));
+
 static cl::opt<std::string> VFileOutput("module",
 										cl::desc("print translation unit"),
 										cl::value_desc("filename"),
@@ -85,11 +108,51 @@ static cl::opt<std::string> NameTest("name-test",
 									 cl::value_desc("filename"), cl::Optional,
 									 cl::cat(Cpp2V));
 
+static cl::opt<std::string>
+	SpecsFile("specs",
+			  cl::desc("print specification skeletons for the documented "
+					   "functions of the main file"),
+			  cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	IndexFile("index",
+			  cl::desc("write the byte ranges of the entries of the -o file "
+					   "(or, with -extract, read them)"),
+			  cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::list<std::string>
+	Extract("extract",
+			cl::desc("print a module file holding just this declaration "
+					 "(a qualified name or name key) from the -index file"),
+			cl::value_desc("name"), cl::ZeroOrMore, cl::cat(Cpp2V));
+
+static cl::opt<std::string> FragmentCacheDir(
+	"fragment-cache",
+	cl::desc("reuse the printed forms of unchanged declarations from (and "
+			 "save them to) this directory"),
+	cl::value_desc("directory"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string> ImportDir(
+	"import-dir",
+	cl::desc("print declarations of imported Clang modules to one file per "
+			 "module in this directory, and include those files"),
+	cl::value_desc("directory"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	ImportPrefix("import-prefix",
+				 cl::desc("Coq logical path of the -import-dir directory"),
+				 cl::value_desc("path"), cl::Optional, cl::cat(Cpp2V));
+
 static cl::opt<bool> CheckTypes("check-types",
 								cl::desc("check types of translation units"),
 								cl::Optional, cl::ValueOptional,
 								cl::cat(Cpp2V));
 
+static cl::opt<bool> CheckDecls(
+	"check-decls",
+	cl::desc("with -check-types, check each definition in its own example"),
+	cl::Optional, cl::cat(Cpp2V));
+
 static cl::bits<Trace::Bit> TraceBits(
 	"trace", cl::desc("print debug trace on fd 2 (can be repeated)"),
 	cl::ZeroOrMore, cl::CommaSeparated,
@@ -111,13 +174,138 @@ static cl::bits<Trace::Bit> TraceBits(
 static cl::opt<bool> NoSharing("no-sharing", cl::desc("disable sharing"),
 							   cl::Optional, cl::ValueOptional, cl::cat(Cpp2V));
 
+static cl::opt<bool> StableSharing(
+	"stable-sharing",
+	cl::desc("name shared terms after their contents rather than counting"),
+	cl::Optional, cl::cat(Cpp2V));
+
 static cl::opt<bool>
 	NoAliases("no-aliases",
 			  cl::desc("do not emit typedef and using declarations"),
 			  cl::Optional, cl::ValueOptional, cl::cat(Cpp2V));
 
+static cl::opt<bool>
+	Stream("stream",
+		   cl::desc("print declarations on another thread while parsing"),
+		   cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<unsigned>
+	Jobs("jobs", cl::desc("print top-level declarations on N threads"),
+		 cl::value_desc("N"), cl::init(1), cl::cat(Cpp2V));
+
+static cl::opt<std::string> BatchDir(
+	"batch-dir",
+	cl::desc("translate each source file on its own, printing the "
+			 "translation unit of foo.cpp to foo_cpp.v in this directory"),
+	cl::value_desc("directory"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<unsigned> BatchJobs(
+	"batch-jobs", cl::desc("with -batch-dir, translate N files at a time"),
+	cl::value_desc("N"), cl::init(std::thread::hardware_concurrency()),
+	cl::cat(Cpp2V));
+
+static cl::opt<std::string> BatchHistory(
+	"batch-history",
+	cl::desc("with -batch-dir, start the files that took longest in earlier "
+			 "runs first, as recorded in (and then added to) this file"),
+	cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	BinaryFile("binary",
+			   cl::desc("print translation unit in binary form (for "
+						"Cpp2v Load)"),
+			   cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	NodeStats("node-stats",
+			  cl::desc("write how many nodes of each Clang class the printers "
+					   "printed, and the bytes and time they took, as JSON"),
+			  cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	PerfFile("perf",
+			 cl::desc("write the cost of the translation unit and of each "
+					  "entry of the -o file, for rocq-tools reports"),
+			 cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	PerfLog("perf-log",
+			cl::desc("write the cost of each phase of the run, for "
+					 "rocq-tools reports"),
+			cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<bool>
+	DepFile("MD", cl::desc("write a Make-style dependency file (see -MF)"),
+			cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<std::string>
+	DepFileName("MF",
+				cl::desc("dependency file (default: the -o file, with "
+						 "extension .d)"),
+				cl::value_desc("filename"), cl::Optional, cl::cat(Cpp2V));
+
+static cl::opt<bool> ViaTranslate(
+	"via-translate",
+	cl::desc("print the -o and -names files through cpp2v::translate, "
+			 "without elaborating (to test the library interface)"),
+	cl::Optional, cl::Hidden, cl::cat(Cpp2V));
+
+/*
+Prints the `-o` and `-names` files the way a client of the `tocoq`
+library would (see `cpp2v::translate`).
+*/
+class TranslateConsumer : public clang::ASTConsumer {
+	const std::string module_file_;
+
+	static void write(StringRef path, StringRef contents) {
+		std::error_code err;
+		llvm::raw_fd_ostream os{path, err};
+		if (err) {
+			llvm::errs() << path << ": " << err.message() << "\n";
+			logging::fail();
+			return;
+		}
+		os << contents;
+	}
+
+public:
+	explicit TranslateConsumer(std::string module_file)
+		: module_file_{std::move(module_file)} {}
+
+	void HandleTranslationUnit(clang::ASTContext &ctxt) override {
+		if (ctxt.getDiagnostics().getClient()->getNumErrors() != 0)
+			return;
+		cpp2v::Options options;
+		options.names = !NamesFile.empty();
+		options.structured_keys = !MangledKeys;
+		options.comment = Comment;
+		options.sharing = !NoSharing;
+		options.stable_sharing = StableSharing;
+		options.check_types = CheckTypes;
+		options.typedefs = !NoAliases;
+		options.jobs = Jobs;
+		options.log_level = logging::level();
+		auto result = cpp2v::translate(ctxt, options);
+		llvm::errs() << result.log;
+		if (!result.ok) {
+			logging::fail();
+			return;
+		}
+		write(module_file_, result.module);
+		if (options.names)
+			write(NamesFile, result.names);
+	}
+};
+
 class ToCoqAction : public clang::ASTFrontendAction {
+	// The -o file, or the file -batch-dir prints to
+	const std::optional<std::string> module_file_;
+
 public:
+	ToCoqAction() : module_file_{to_opt(VFileOutput)} {}
+	explicit ToCoqAction(std::string module_file)
+		: module_file_{std::move(module_file)} {}
+
 	virtual std::unique_ptr<clang::ASTConsumer>
 	CreateASTConsumer(clang::CompilerInstance &Compiler,
 					  llvm::StringRef InFile) override {
@@ -131,16 +319,28 @@ public:
 		llvm::errs() << i << "\n";
 	}
 #endif
+		if (ViaTranslate)
+			return std::make_unique<TranslateConsumer>(*module_file_);
 		auto result =
-			new ToCoqConsumer(&Compiler, to_opt(VFileOutput), to_opt(NamesFile),
-							  to_opt(Templates), to_opt(NameTest), !MangledKeys,
+			new ToCoqConsumer(&Compiler, module_file_, to_opt(NamesFile),
+							  to_opt(Templates), to_opt(NameTest),
+							  to_opt(SpecsFile), to_opt(IndexFile),
+							  to_opt(PerfFile), to_opt(BinaryFile),
+							  dep_file(),
+							  to_opt(FragmentCacheDir), to_opt(ImportDir),
+							  ImportPrefix, names_filter(), !MangledKeys,
 							  Trace::fromBits(TraceBits.getBits()), Comment,
-							  !NoSharing, CheckTypes, !NoElaborate, !NoAliases);
+							  !NoSharing, StableSharing, CheckTypes, CheckDecls,
+							  Stream, !NoElaborate, !NoAliases, Jobs);
 		return std::unique_ptr<clang::ASTConsumer>(result);
 	}
 
+	GlobalsFilter names_filter() {
+		return {NamesMainFile, {NamesNamespace.begin(), NamesNamespace.end()}};
+	}
+
 	template<typename T>
-	std::optional<T> to_opt(const cl::opt<T> &val) {
+	static std::optional<T> to_opt(const cl::opt<T> &val) {
 		if (val.empty()) {
 			return std::optional<T>();
 		} else {
@@ -148,14 +348,135 @@ public:
 		}
 	}
 
+	std::optional<std::string> dep_file() {
+		if (!DepFile)
+			return std::nullopt;
+		if (!DepFileName.empty())
+			return DepFileName.getValue();
+		SmallString<128> path{*module_file_};
+		llvm::sys::path::replace_extension(path, "d");
+		return std::string(path.str());
+	}
+
 	virtual bool BeginSourceFileAction(CompilerInstance &CI) override {
 		return this->clang::ASTFrontendAction::BeginSourceFileAction(CI);
 	}
+
+	/*
+	Clang loads a serialized AST (from `clang -emit-ast`, or a PCH) into
+	an `ASTUnit` rather than parse it, so there is no parser to drive the
+	consumer. We drive it ourselves, with a `Sema` over the loaded AST so
+	that elaboration can still define implicit members and instantiate
+	templates.
+	*/
+	virtual void ExecuteAction() override {
+		perf::Phase phase{"cpp2v"};
+		phase.meta("file", getCurrentFile());
+		if (getCurrentFileKind().getFormat() != InputKind::Precompiled)
+			return this->clang::ASTFrontendAction::ExecuteAction();
+
+		auto &CI = getCompilerInstance();
+		if (!CI.hasSema())
+			CI.createSema(getTranslationUnitKind(), nullptr);
+		auto &sema = CI.getSema();
+		auto &consumer = sema.getASTConsumer();
+		auto &ctxt = CI.getASTContext();
+		if (!ctxt.getASTMutationListener())
+			ctxt.setASTMutationListener(consumer.GetASTMutationListener());
+
+		consumer.Initialize(ctxt);
+		sema.Initialize();
+		if (auto external = ctxt.getExternalSource())
+			external->StartTranslationUnit(&consumer);
+
+		// As if the translation unit was a single top-level declaration
+		consumer.HandleTopLevelDecl(DeclGroupRef(ctxt.getTranslationUnitDecl()));
+		sema.PerformPendingInstantiations();
+		consumer.HandleTranslationUnit(ctxt);
+	}
+};
+
+/// Makes the action of one -batch-dir job
+class BatchActionFactory : public FrontendActionFactory {
+	const std::string module_file_;
+
+public:
+	explicit BatchActionFactory(std::string module_file)
+		: module_file_{std::move(module_file)} {}
+
+	std::unique_ptr<FrontendAction> create() override {
+		return std::make_unique<ToCoqAction>(module_file_);
+	}
 };
 
+/*
+Translate each of `sources` with a `ClangTool` of its own, on
+`-batch-jobs` threads, longest first (see `schedule::run`).
+*/
+static int
+batch(const CompilationDatabase &compilations,
+	  ArrayRef<std::string> sources) {
+	// Where each file is printed
+	StringMap<std::string> outputs;
+	StringMap<StringRef> sources_by_output;
+	for (auto &source : sources) {
+		auto name = sys::path::filename(source).str();
+		std::replace(name.begin(), name.end(), '.', '_');
+		SmallString<128> path{BatchDir.getValue()};
+		sys::path::append(path, name + ".v");
+		auto [it, fresh] = sources_by_output.try_emplace(path, source);
+		if (!fresh) {
+			llvm::errs() << "cpp2v: " << it->second << " and " << source
+						 << " would both be printed to " << path << "\n";
+			return 1;
+		}
+		outputs[source] = path.str().str();
+	}
+	if (auto err = sys::fs::create_directories(BatchDir)) {
+		llvm::errs() << BatchDir << ": " << err.message() << "\n";
+		return 1;
+	}
+
+	schedule::History history;
+	if (!BatchHistory.empty() && !history.read(BatchHistory))
+		return 1;
+	auto job = [&](StringRef source, std::uint64_t &bytes) {
+		// With a file system of its own, as the real one is shared and
+		// the tool changes its working directory
+		ClangTool tool(compilations, {source.str()},
+					   std::make_shared<PCHContainerOperations>(),
+					   vfs::createPhysicalFileSystem());
+		auto &output = outputs.find(source)->second;
+		BatchActionFactory factory{output};
+		// Failures of this job only
+		logging::Scope scope{logging::settings()};
+		if (tool.run(&factory) || logging::failed())
+			return false;
+		sys::fs::file_status status;
+		if (!sys::fs::status(output, status))
+			bytes = status.getSize();
+		return true;
+	};
+	auto runs = schedule::run(sources, history, BatchJobs, job);
+
+	int result = 0;
+	for (auto &run : runs)
+		if (run.ok)
+			history.record(run.job, {run.end - run.start, run.bytes});
+		else
+			result = 1;
+	if (!BatchHistory.empty() && !history.write(BatchHistory))
+		result = 1;
+	if (!Quiet)
+		schedule::summarize(llvm::errs(), runs);
+	return result;
+}
+
 int
 main(int argc, const char **argv) {
-	auto MaybeOptionsParser = CommonOptionsParser::create(argc, argv, Cpp2V);
+	// Without source files for -extract
+	auto MaybeOptionsParser =
+		CommonOptionsParser::create(argc, argv, Cpp2V, cl::ZeroOrMore);
 	if (not MaybeOptionsParser) {
 		llvm::errs() << MaybeOptionsParser.takeError();
 		return 1;
@@ -177,8 +498,96 @@ main(int argc, const char **argv) {
 		logging::set_level(logging::NONE);
 	}
 
-	ClangTool Tool(OptionsParser.getCompilations(),
-				   OptionsParser.getSourcePathList());
+	if (DepFile && DepFileName.empty() && VFileOutput.empty() &&
+		BatchDir.empty()) {
+		llvm::errs() << "cpp2v: -MD requires -MF or -o\n";
+		return 1;
+	}
+	if (!ImportDir.empty() && !BinaryFile.empty()) {
+		llvm::errs() << "cpp2v: -import-dir does not support -binary\n";
+		return 1;
+	}
+
+	if (!Extract.empty()) {
+		if (IndexFile.empty()) {
+			llvm::errs() << "cpp2v: -extract requires -index\n";
+			return 1;
+		}
+		std::vector<std::string> names{Extract.begin(), Extract.end()};
+		if (VFileOutput.empty())
+			return extract(IndexFile, names, llvm::outs()) ? 0 : 1;
+		std::error_code err;
+		llvm::raw_fd_ostream os{VFileOutput, err};
+		if (err) {
+			llvm::errs() << VFileOutput << ": " << err.message() << "\n";
+			return 1;
+		}
+		return extract(IndexFile, names, os) ? 0 : 1;
+	}
+	if (OptionsParser.getSourcePathList().empty()) {
+		llvm::errs() << "cpp2v: no input files\n";
+		return 1;
+	}
+	if (!BatchDir.empty())
+		for (auto *opt : {&VFileOutput, &NamesFile, &Templates, &NameTest,
+						  &SpecsFile, &IndexFile, &PerfFile, &PerfLog,
+						  &BinaryFile, &DepFileName})
+			if (!opt->empty()) {
+				llvm::errs() << "cpp2v: -batch-dir does not support -"
+							 << opt->ArgStr << "\n";
+				return 1;
+			}
+	if (!IndexFile.empty() && VFileOutput.empty()) {
+		llvm::errs() << "cpp2v: -index requires -o\n";
+		return 1;
+	}
+	if (ViaTranslate && VFileOutput.empty()) {
+		llvm::errs() << "cpp2v: -via-translate requires -o\n";
+		return 1;
+	}
+	if (!PerfFile.empty() && VFileOutput.empty()) {
+		llvm::errs() << "cpp2v: -perf requires -o\n";
+		return 1;
+	}
+	if (!PerfFile.empty() || !PerfLog.empty()) {
+		std::string why;
+		if (!perf::enable(why))
+			llvm::errs() << "cpp2v: cannot count instructions (" << why
+						 << "); ignoring -perf and -perf-log\n";
+	}
+
+	if (!NodeStats.empty())
+		stats::enable();
 
-	return Tool.run(newFrontendActionFactory<ToCoqAction>().get());
+	int result;
+	if (!BatchDir.empty()) {
+		result = batch(OptionsParser.getCompilations(),
+					   OptionsParser.getSourcePathList());
+	} else {
+		ClangTool Tool(OptionsParser.getCompilations(),
+					   OptionsParser.getSourcePathList());
+		result = Tool.run(newFrontendActionFactory<ToCoqAction>().get());
+		if (logging::failed())
+			result = 1;
+	}
+
+	if (!NodeStats.empty()) {
+		std::error_code err;
+		llvm::raw_fd_ostream os{NodeStats, err};
+		if (err) {
+			llvm::errs() << NodeStats << ": " << err.message() << "\n";
+			return 1;
+		}
+		stats::write(os);
+	}
+	if (!PerfLog.empty() && perf::enabled()) {
+		std::error_code err;
+		llvm::raw_fd_ostream os{PerfLog, err};
+		if (err) {
+			llvm::errs() << PerfLog << ": " << err.message() << "\n";
+			return 1;
+		}
+		perf::write_log(os);
+	}
+	return result;
 }
@@ -43,6 +43,8 @@ type files = {
   log : string;
   stderr : string;
   stdout : string;
+  cpp2v_perf : string;
+  cpp2v_log : string;
 }
 
 let (cmd, files) =
@@ -63,7 +65,9 @@ let (cmd, files) =
         let log = glob ^ ".log.json" in
         let stdout = glob ^ ".stdout" in
         let stderr = glob ^ ".stderr" in
-        {glob; perf; summary; log; stdout; stderr}
+        let cpp2v_perf = base ^ ".cpp2v.json" in
+        let cpp2v_log = base ^ ".cpp2v.log.json" in
+        {glob; perf; summary; log; stdout; stderr; cpp2v_perf; cpp2v_log}
       in
       let env =
         "COQ_PROFILE_COMPONENTS=command" ::
@@ -116,6 +120,30 @@ let embed_log glob log_file =
   Globfs.append ~glob ~file:log_file;
   Sys.remove log_file
 
+(* The data of "cpp2v -perf" and "cpp2v -perf-log", if the file was generated
+   by cpp2v with them. These are build targets, so they are not removed. *)
+let embed_cpp2v glob perf_file log_file =
+  let exists file = Sys.file_exists file && not (Sys.is_directory file) in
+  if exists perf_file then begin
+    let perf =
+      try Data.read_json perf_file with Data.Read_error(s) ->
+        panic "Error: bad cpp2v profiling data, %s." s
+    in
+    let key = Globfs.Key.of_string "cpp2v.json" in
+    Globfs.append_gen ~glob ~key ~file:perf_file;
+    let data =
+      let open Data in
+      let opt = Option.value ~default:0 in
+      Printf.sprintf "%i,%i,%i,%i\n"
+        perf.ic perf.tm (opt perf.rss) (opt perf.sz)
+    in
+    let key = Globfs.Key.of_string "cpp2v.csvline" in
+    Globfs.append_data ~glob ~key ~data
+  end;
+  if exists log_file then
+    let key = Globfs.Key.of_string "cpp2v.log.json" in
+    Globfs.append_gen ~glob ~key ~file:log_file
+
 let non_empty_file file =
   let ic = In_channel.open_text file in
   let non_empty = In_channel.input_char ic <> None in
@@ -127,12 +155,15 @@ let embed_stdout_and_stderr glob stdout_file stderr_file =
   if non_empty_file stderr_file then Globfs.append ~glob ~file:stderr_file;
   Sys.remove stderr_file
 
-let hack_glob {glob; perf; summary; log; stdout; stderr} =
+let hack_glob files =
+  let {glob; perf; summary; log; stdout; stderr; _} = files in
   (* Extract and embed the performance data. *)
   embed_perf_and_summary glob perf summary;
   (* Embed the log if it was generated. *)
   if Sys.file_exists log && not (Sys.is_directory log) then
     embed_log glob log;
+  (* Embed the cpp2v data if the file was generated with it. *)
+  embed_cpp2v glob files.cpp2v_perf files.cpp2v_log;
   (* Embed stdout and stderr. *)
   embed_stdout_and_stderr glob stdout stderr
 
@@ -44,6 +44,8 @@ let data : data_category list =
   let srcnotcompiled = ref [] in
   let notcompiled = ref [] in
   let diff = ref [] in
+  let cpp2vdifferror = ref [] in
+  let cpp2vdiff = ref [] in
   let added = ref [] in
   let removed = ref [] in
   let _ =
@@ -63,8 +65,10 @@ let data : data_category list =
         | [f; "notcompiled"   ] -> notcompiled    := f :: !notcompiled
         | [f; "added"         ] -> added          := f :: !added
         | [f; "removed"       ] -> removed        := f :: !removed
+        | [f; "cpp2vdifferror"] -> cpp2vdifferror := f :: !cpp2vdifferror
         (* Diff page available. *)
         | [f; "diff"; d] -> diff := (f, d) :: !diff
+        | [f; "cpp2vdiff"; d] -> cpp2vdiff := (f, d) :: !cpp2vdiff
         | [] -> ()
         | _ -> Printf.printf "Warning: cannot parse line %S.\n%!" line
       done with End_of_file -> In_channel.close_noerr ic 
@@ -81,9 +85,15 @@ let data : data_category list =
   let removed = List.sort String.compare !removed in
   let differror = List.sort String.compare !differror in
   let diff = List.sort (fun (s1,_) (s2,_) -> String.compare s1 s2) !diff in
+  let cpp2vdifferror = List.sort String.compare !cpp2vdifferror in
+  let cpp2vdiff =
+    List.sort (fun (s1,_) (s2,_) -> String.compare s1 s2) !cpp2vdiff
+  in
   List.filter meaningful [
     Items("Errors while producing the HTML diff", differror);
     Links("Files with detailed diff", diff);
+    Items("Errors while producing the HTML diff of cpp2v", cpp2vdifferror);
+    Links("Files with detailed cpp2v diff", cpp2vdiff);
     Items("Files added", added);
     Items("Files removed", removed);
     Items("Data only in the reference", nomoredata);
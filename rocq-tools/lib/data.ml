@@ -38,13 +38,15 @@ type t = {
   tm : int;
   mj : int;
   mn : int;
+  rss : int option;
+  sz : int option;
   cs : cmd array
 }
 
-let make ~ic ~tm ~mj ~mn cmds =
-  {ic; tm; mj; mn; cs=cmds}
+let make ?rss ?sz ~ic ~tm ~mj ~mn cmds =
+  {ic; tm; mj; mn; rss; sz; cs=cmds}
 
-let to_json {ic; tm; mj; mn; cs} =
+let to_json {ic; tm; mj; mn; rss; sz; cs} =
   let cmd {cmd_line=l; cmd_sbyte=s; cmd_ebyte=e; cmd_text=p; cmd_ic=i} =
     `Assoc([
       ("l", `Int(l));
@@ -55,11 +57,13 @@ let to_json {ic; tm; mj; mn; cs} =
     ])
   in
   let cs = Array.fold_right (fun c acc -> cmd c :: acc) cs [] in
+  let opt f v = match v with Some(i) -> [(f, `Int(i))] | None -> [] in
   `Assoc([
     ("i", `Int(ic));
     ("t", `Int(tm));
     ("mj", `Int(mj));
     ("mn", `Int(mn));
+  ] @ opt "rss" rss @ opt "sz" sz @ [
     ("cs", `List(cs));
   ])
 
@@ -68,13 +72,19 @@ let of_json o =
   let get_int fs f =
     match List.assoc_opt f fs with Some(`Int(i)) -> i | _ -> raise E
   in
+  let get_int_opt fs f =
+    match List.assoc_opt f fs with
+    | Some(`Int(i)) -> Some(i)
+    | None          -> None
+    | _             -> raise E
+  in
   let get_str fs f =
     match List.assoc_opt f fs with Some(`String(s)) -> s | _ -> raise E
   in
   let get_list fs f =
     match List.assoc_opt f fs with Some(`List(l)) -> l | _ -> raise E
   in
-  let process ~ic ~tm ~mj ~mn cs =
+  let process ?rss ?sz ~ic ~tm ~mj ~mn cs =
     let process_cmd e =
       let fs = match e with `Assoc(fs) -> fs | _ -> raise E in
       let line = get_int fs "l" in
@@ -84,15 +94,17 @@ let of_json o =
       let ic = get_int fs "i" in
       make_cmd ~line ~sbyte ~ebyte ~text ~ic ()
     in
-    make ~ic ~tm ~mj ~mn (Array.of_list (List.map process_cmd cs))
+    make ?rss ?sz ~ic ~tm ~mj ~mn (Array.of_list (List.map process_cmd cs))
   in
   let process_cmd fs =
     let ic = get_int fs "i" in
     let tm = get_int fs "t" in
     let mj = get_int fs "mj" in
     let mn = get_int fs "mn" in
+    let rss = get_int_opt fs "rss" in
+    let sz = get_int_opt fs "sz" in
     let cs = get_list fs "cs" in
-    process ~ic ~tm ~mj ~mn cs
+    process ?rss ?sz ~ic ~tm ~mj ~mn cs
   in
   match o with
   | `Assoc(fs) -> (try Some(process_cmd fs) with E -> None)
@@ -124,10 +136,11 @@ let add_noise_int : Float.t -> int -> int = fun p i ->
 let add_noise_cmd : Float.t -> cmd -> cmd = fun p cmd ->
   {cmd with cmd_ic = add_noise_int p cmd.cmd_ic}
 
-let add_noise : Float.t -> t -> t = fun p {ic; tm; mj; mn; cs} ->
+let add_noise : Float.t -> t -> t = fun p {ic; tm; mj; mn; rss; sz; cs} ->
   let ic = add_noise_int p ic in
   let tm = add_noise_int p tm in
   let mj = add_noise_int p mj in
   let mn = add_noise_int p mn in
+  let rss = Option.map (add_noise_int p) rss in
   let cs = Array.map (add_noise_cmd p) cs in
-  {ic; tm; mj; mn; cs}
+  {ic; tm; mj; mn; rss; sz; cs}
@@ -43,19 +43,26 @@ type t = {
   (** Number of words allocated on the major heap for processing the file. *)
   mn : int;
   (** Number of words allocated on the minor heap for processing the file. *)
+  rss : int option;
+  (** Peak resident set size (in bytes) of a generator of the file that is not
+      an OCaml program, such as [cpp2v], whose [mj] and [mn] are then [0]. *)
+  sz : int option;
+  (** Size (in bytes) of the file, if [rss] is given. *)
   cs : cmd array
   (** Data for all the commands in the file (in order). *)
 }
 
 (** [make ~ic cmds] constructs a data record. *)
-val make : ic:int -> tm:int -> mj:int -> mn:int -> cmd array -> t
+val make :
+  ?rss:int -> ?sz:int -> ic:int -> tm:int -> mj:int -> mn:int -> cmd array -> t
 
 (** [to_json data] converts the given [data] into JSON. The produced object is
     formed of two fields:
     - ["i"] - an integer giving the CPU instruction count for the full "coqc"
       process (except the OCaml runtime initialization / finalization),
     - ["a"] - an array of objects giving data about each individual, toplevel  
-      Coq command that was processed.
+      Coq command that was processed,
+    - ["rss"] and ["sz"] (optional integers) - the [rss] and [sz] fields.
     The objects stored in the latter field contain the following fields:
     - ["l"] (integer) - the number of the line on which the command starts,
     - ["s"] (integer) - the index of the first command's byte in the file,
@@ -24,6 +24,7 @@ SRC="$PWD/$1"
 DST="$PWD/$2"
 
 SUMMARY_CSV="$DST/perf_summary.csv"
+CPP2V_CSV="$DST/cpp2v_summary.csv"
 
 cd "$SRC"
 
@@ -48,10 +49,24 @@ handle_glob(){
     mkdir -p "$DST/$(dirname $LOG)/"
     mv "$LOG" "$DST/$BASE.log.json"
   fi
+  # Gather the cpp2v data if the file was generated by cpp2v.
+  CPP2V_PERF="$GLOB.cpp2v.json"
+  if [[ -f "$CPP2V_PERF" ]]; then
+    mkdir -p "$DST/$(dirname $CPP2V_PERF)/"
+    mv "$CPP2V_PERF" "$DST/$BASE.cpp2v.json"
+    CSVLINE="$GLOB.cpp2v.csvline"
+    echo "$BASE.v,$(cat $CSVLINE)" >> "$CPP2V_CSV"
+  fi
+  CPP2V_LOG="$GLOB.cpp2v.log.json"
+  if [[ -f "$CPP2V_LOG" ]]; then
+    mkdir -p "$DST/$(dirname $CPP2V_LOG)/"
+    mv "$CPP2V_LOG" "$DST/$BASE.cpp2v.log.json"
+  fi
 }
 export -f handle_glob
 export DST
 export SUMMARY_CSV
+export CPP2V_CSV
 
 if [[ -d "$DST" ]]; then
   echo "Directory $DST already exists."
@@ -60,6 +75,7 @@ fi
 
 mkdir "$DST"
 touch "$SUMMARY_CSV"
+touch "$CPP2V_CSV"
 
 find -type f -name '*.glob' \
   | xargs -I {} bash -c 'handle_glob "$@"' _ {}
@@ -70,6 +86,12 @@ sort "$SUMMARY_CSV" >> "$SUMMARY_CSV.sorted"
 mv "$SUMMARY_CSV.sorted" "$SUMMARY_CSV"
 sed -i 's/^\.\/\(.*\)/\1/g' "$SUMMARY_CSV"
 
+echo "File,instructions,time (μs),Peak RSS (bytes),Output bytes" \
+  > "$CPP2V_CSV.sorted"
+sort "$CPP2V_CSV" >> "$CPP2V_CSV.sorted"
+mv "$CPP2V_CSV.sorted" "$CPP2V_CSV"
+sed -i 's/^\.\/\(.*\)/\1/g' "$CPP2V_CSV"
+
 if [[ -f "$DST/no_data.txt" ]]; then
   sed -i 's/^\.\/\(.*\)/\1/g' "$DST/no_data.txt"
 fi
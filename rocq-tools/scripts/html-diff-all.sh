@@ -97,7 +97,32 @@ handle_file(){
     echo "$FILE,added" >> "$INDEX_FILE"
   fi
 }
+handle_cpp2v(){
+  FILE="$1"
+  BASE="${FILE%.v}"
+
+  REF_DATA="$REF_DIR/$BASE.cpp2v.json"
+  SRC_DATA="$SRC_DIR/$BASE.cpp2v.json"
+
+  if [[ -f "$REF_DATA" && -f "$SRC_DATA" ]]; then
+    # The file was generated by cpp2v with data on both sides.
+    if ! cmp -s "$REF_DATA" "$SRC_DATA" || \
+       ! cmp -s "$REF_DIR/$FILE" "$SRC_DIR/$FILE"; then
+      mkdir -p "$OUT_DIR/$(dirname "$FILE")/"
+      coqc-perf.html-diff \
+        "$REF_DIR/$FILE" "$REF_DATA" \
+        "$SRC_DIR/$FILE" "$SRC_DATA" > "$OUT_DIR/$BASE.cpp2v.html"
+      if [[ $? -eq 0 ]]; then
+        echo "$FILE,cpp2vdiff,$BASE.cpp2v.html" >> "$INDEX_FILE"
+      else
+        rm -f "$OUT_DIR/$BASE.cpp2v.html"
+        echo "$FILE,cpp2vdifferror" >> "$INDEX_FILE"
+      fi
+    fi
+  fi
+}
 export -f handle_file
+export -f handle_cpp2v
 export -f check_removed
 export REF_DIR
 export SRC_DIR
@@ -112,6 +137,7 @@ fi
 mkdir "$OUT_DIR"
 
 cat "$SRC_DIR/sources.txt" | xargs -I {} bash -c 'handle_file "$@"' _ {}
+cat "$SRC_DIR/sources.txt" | xargs -I {} bash -c 'handle_cpp2v "$@"' _ {}
 cat "$REF_DIR/sources.txt" | xargs -I {} bash -c 'check_removed "$@"' _ {}
 
 coqc-perf.html-index "$INDEX_FILE" "$OUT_DIR/index.html"